@@ -0,0 +1,61 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Theros
+{
+namespace bench
+{
+
+/**
+ * @brief   Small in-house microbenchmark harness, cases register themselves like Catch test cases
+ *
+ *          BENCH_CASE("codec/base64 encode 1KiB") {
+ *              for (std::size_t i = 0; i < state.iterations; ++i)
+ *                  keep(Base64Codec::encode(input));
+ *              state.bytes = input.size();
+ *          }
+ *
+ *          -- iterations are doubled until one run takes at least --min-time, the run is then
+ *             repeated, median and min of time per iteration are reported
+ *          -- results are written as JSON, one object per case, to track regressions across commits
+ */
+struct State {
+    std::size_t iterations;     // to run, set by harness
+    std::size_t bytes = 0;      // processed per iteration, set by case, for throughput
+};
+
+using BenchFunc = std::function<void(State &)>;
+
+std::vector<std::pair<std::string, BenchFunc>> &registry();
+
+struct Registrar {
+    Registrar(const char *name, BenchFunc f) { registry().emplace_back(name, std::move(f)); }
+};
+
+/** Keeps compiler from optimizing away computation of value */
+template <typename T>
+inline void keep(T &&value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+} // namespace bench
+} // namespace Theros
+
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+#define BENCH_CASE_(name, f) \
+    static void f(::Theros::bench::State &state); \
+    static ::Theros::bench::Registrar BENCH_CONCAT(f, _registrar)(name, f); \
+    static void f(::Theros::bench::State &state)
+#define BENCH_CASE(name) BENCH_CASE_(name, BENCH_CONCAT(bench_case_, __LINE__))
+
+#endif // __BENCH_H__
@@ -0,0 +1,88 @@
+#ifndef __BENCH_SERVER_H__
+#define __BENCH_SERVER_H__
+
+#include "theros.h"
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Theros
+{
+namespace bench
+{
+
+/**
+ * @brief   HttpServer on loopback, run on a thread of its own for as long as the object lives,
+ *          for cases timing whole requests
+ */
+class BenchServer
+{
+public:
+    BenchServer(int port, std::function<void(HttpServer &)> setup)
+        : port_(port), app_(std::make_pair("127.0.0.1", port))
+    {
+        setup(app_);
+
+        // first handler run by event loop, i.e. once run() has bound and is listening
+        std::promise<void> listening;
+        auto ready = listening.get_future();
+        app_.io_service_.post([this, &listening]() {
+            started_ = true;
+            listening.set_value();
+        });
+        thread_ = std::thread([this, &listening]() {
+            try {
+                app_.run();
+            } catch (...) {
+                if (started_) throw;
+                listening.set_exception(std::current_exception());
+            }
+        });
+        try {
+            ready.get();
+        } catch (...) {
+            thread_.join();
+            throw;
+        }
+    }
+    ~BenchServer()
+    {
+        app_.io_service_.stop();
+        thread_.join();
+    }
+
+    HttpServer &app() { return app_; }
+
+    /** Issues one request on a new connection, returns bytes received */
+    std::size_t get(const std::string &path)
+    {
+        asio::ip::tcp::endpoint endpoint(asio::ip::address::from_string("127.0.0.1"), port_);
+        std::string request = "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+        buffer_.resize(1 << 16);
+
+        asio::ip::tcp::socket socket(io_service_);
+        socket.connect(endpoint);
+        asio::write(socket, asio::buffer(request));
+        asio::error_code ec;
+        std::size_t received = 0;
+        while (!ec) received += socket.read_some(asio::buffer(buffer_), ec);
+        return received;
+    }
+
+private:
+    int port_;
+    HttpServer app_;
+    std::thread thread_;
+    bool started_ = false;              // event loop is running, set on its thread
+    asio::io_service io_service_;       // of client sockets
+    std::vector<char> buffer_;
+};
+
+} // namespace bench
+} // namespace Theros
+#endif // __BENCH_SERVER_H__
@@ -0,0 +1,134 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Theros
+{
+namespace bench
+{
+
+/**
+ * @brief   Hardware counters of calling thread, user space only, through Linux perf_event_open
+ *
+ *          PerfCounters counters;
+ *          if (counters.available()) {
+ *              counters.start();
+ *              ...
+ *              auto counts = counters.stop();
+ *          }
+ *
+ *          -- counters the CPU or hypervisor does not expose are left out, available() says if any is there,
+ *             error() why none is, e.g. perf_event_paranoid or a virtual machine without a PMU
+ *          -- a counter the kernel multiplexes is scaled up to the time it was enabled
+ */
+class PerfCounters
+{
+public:
+    enum Counter { cycles, instructions, cache_misses, branch_misses, counter_count };
+
+    struct Counts {
+        std::array<double, counter_count> values{};
+        std::array<bool, counter_count> valid{};
+    };
+
+    static const char *name(Counter counter)
+    {
+        static const char *names[] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+        return names[counter];
+    }
+
+    PerfCounters()
+    {
+        fds_.fill(-1);
+#ifdef __linux__
+        static const std::uint64_t configs[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int i = 0; i < counter_count; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fds_[i] < 0 && error_.empty()) error_ = std::strerror(errno);
+        }
+#else
+        error_ = "perf_event_open is Linux only";
+#endif
+    }
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        for (auto fd : fds_)
+            if (fd >= 0) close(fd);
+#endif
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    bool available() const
+    {
+        for (auto fd : fds_)
+            if (fd >= 0) return true;
+        return false;
+    }
+
+    /** Why the first counter missing could not be opened */
+    const std::string &error() const { return error_; }
+
+    /** Resets and enables counters */
+    void start()
+    {
+#ifdef __linux__
+        for (auto fd : fds_) {
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    /** Disables counters, counts since start() */
+    Counts stop()
+    {
+        Counts counts;
+#ifdef __linux__
+        for (int i = 0; i < counter_count; ++i)
+            if (fds_[i] >= 0) ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+        for (int i = 0; i < counter_count; ++i) {
+            std::uint64_t data[3];      // value, time enabled, time running
+            if (fds_[i] < 0 || read(fds_[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+            counts.values[i] = static_cast<double>(data[0]) * data[1] / data[2];
+            counts.valid[i] = true;
+        }
+#endif
+        return counts;
+    }
+
+private:
+    std::array<int, counter_count> fds_;
+    std::string error_;
+};
+
+} // namespace bench
+} // namespace Theros
+
+#endif // __PERF_COUNTERS_H__
@@ -0,0 +1,76 @@
+/**
+ * Base64Codec, SHA256Codec and urldecode over inputs of typical sizes
+ */
+#include "Bench.h"
+
+#include <string>
+
+#include "Codec.h"
+#include "Url.h"
+
+using namespace std;
+using namespace Theros;
+using namespace Theros::bench;
+
+namespace
+{
+string random_bytes(size_t size)
+{
+    string bytes(size, '\0');
+    uint32_t x = 2463534242u;
+    for (auto &c : bytes) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        c = static_cast<char>(x);
+    }
+    return bytes;
+}
+
+void base64_encode(State &state, size_t size)
+{
+    auto input = random_bytes(size);
+    for (size_t i = 0; i < state.iterations; ++i)
+        keep(Base64Codec::encode(input));
+    state.bytes = size;
+}
+
+void base64_decode(State &state, size_t size)
+{
+    auto encoded = Base64Codec::encode(random_bytes(size));
+    for (size_t i = 0; i < state.iterations; ++i)
+        keep(Base64Codec::decode(encoded));
+    state.bytes = encoded.size();
+}
+
+void sha256(State &state, size_t size)
+{
+    auto input = random_bytes(size);
+    for (size_t i = 0; i < state.iterations; ++i) {
+        SHA256Codec codec;
+        keep(codec.digest(input));
+    }
+    state.bytes = size;
+}
+}
+
+
+BENCH_CASE("codec/base64 encode 64B") { base64_encode(state, 64); }
+BENCH_CASE("codec/base64 encode 16KiB") { base64_encode(state, 16 << 10); }
+BENCH_CASE("codec/base64 decode 64B") { base64_decode(state, 64); }
+BENCH_CASE("codec/base64 decode 16KiB") { base64_decode(state, 16 << 10); }
+
+BENCH_CASE("codec/sha256 64B") { sha256(state, 64); }
+BENCH_CASE("codec/sha256 16KiB") { sha256(state, 16 << 10); }
+
+BENCH_CASE("codec/urldecode plain") {
+    const string url = "/articles/2018/05/event-loops-in-practice/index.html";
+    for (size_t i = 0; i < state.iterations; ++i)
+        keep(urldecode(url));
+    state.bytes = url.size();
+}
+
+BENCH_CASE("codec/urldecode percent-encoded") {
+    const string url = "q=caf%C3%A9%20au%20lait&filters=price%3C10%2Cdistance%3C2km&tags=%E6%9D%B1%E4%BA%AC";
+    for (size_t i = 0; i < state.iterations; ++i)
+        keep(urldecode(url));
+    state.bytes = url.size();
+}
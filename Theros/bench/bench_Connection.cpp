@@ -0,0 +1,74 @@
+/**
+ * Connection end to end over MemorySocket: parse, route, handler, serialize and write of
+ * one request per connection, as the server does, without a kernel socket in between
+ */
+#include "Bench.h"
+
+#include <array>
+#include <memory>
+#include <string>
+
+#include "Connection.h"
+#include "MemorySocket.h"
+#include "Router.h"
+
+using namespace std;
+using namespace Theros;
+using namespace Theros::bench;
+
+namespace
+{
+Router &router()
+{
+    static Router router = [] {
+        Router r;
+        r.get("/users/<id>", [](Context &ctx) { ctx.res.SetBody<DefaultBody>("user " + ctx.param["id"]); });
+        r.post("/users", [](Context &ctx) { ctx.res.status_code = StatusCode::Created; });
+        return r;
+    }();
+    return router;
+}
+
+void read_all(MemorySocket &socket, array<char, 512> &buffer, size_t &read)
+{
+    socket.async_read_some(asio::buffer(buffer), [&socket, &buffer, &read](asio::error_code ec, size_t n) {
+        read += n;
+        if (!ec) read_all(socket, buffer, read);
+    });
+}
+
+void serve(State &state, const string &request)
+{
+    asio::io_service io_service;
+    array<char, 512> buffer;
+    size_t read = 0;
+
+    for (size_t i = 0; i < state.iterations; ++i) {
+        {
+            auto conn = make_shared<Connection<MemorySocket>>(io_service, router());
+            MemorySocket client(io_service);
+            client.connect(conn->socket_);
+            conn->start();
+            asio::async_write(client, asio::buffer(request), [](asio::error_code, size_t) {});
+            read_all(client, buffer, read);
+            conn.reset();
+            io_service.run();
+        }
+        io_service.reset();
+    }
+    keep(read);
+    state.bytes = request.size() + read / state.iterations;
+}
+}
+
+
+BENCH_CASE("connection/GET small route, in-memory")
+{
+    serve(state, "GET /users/42 HTTP/1.1\r\nHost: localhost\r\nUser-Agent: curl/7.54.0\r\nAccept: */*\r\n\r\n");
+}
+
+BENCH_CASE("connection/POST with body, in-memory")
+{
+    serve(state, "POST /users HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\n"
+                 "Content-Length: 26\r\n\r\n{\"name\":\"theros\",\"age\":42}");
+}
@@ -0,0 +1,57 @@
+/**
+ * Overhead of per route metrics: cost of Metrics::record alone, on one and several threads,
+ * and time of a request to a small route with recording off and on
+ */
+#include "Bench.h"
+#include "BenchServer.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace Theros;
+using namespace Theros::bench;
+
+namespace
+{
+void record(State &state, size_t threads)
+{
+    static asio::io_service io;
+    auto &metrics = asio::use_service<Metrics>(io);
+
+    auto records = state.iterations / threads + 1;
+    vector<thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&metrics, records]() {
+            for (size_t i = 0; i < records; ++i)
+                metrics.record(RequestMethod::GET, "/users/<id>", 200, chrono::microseconds(i % 5000), 100, 1000);
+        });
+    }
+    for (auto &worker : workers) worker.join();
+}
+
+BenchServer &server()
+{
+    static BenchServer server(18081, [](HttpServer &app) {
+        app.router_.get("/users/<id>", [](Context &ctx) { ctx.res.SetBody<DefaultBody>("user"); });
+    });
+    return server;
+}
+
+void request(State &state, bool metrics_on)
+{
+    auto &s = server();
+    s.app().metrics().enable(metrics_on);
+    for (size_t i = 0; i < state.iterations; ++i)
+        keep(s.get("/users/1"));
+}
+}
+
+
+BENCH_CASE("metrics/record, 1 thread") { record(state, 1); }
+BENCH_CASE("metrics/record, 4 threads") { record(state, 4); }
+
+BENCH_CASE("server/GET small route, metrics off") { request(state, false); }
+BENCH_CASE("server/GET small route, metrics on") { request(state, true); }
@@ -0,0 +1,60 @@
+/**
+ * QueryParser and Cors handlers run on a Context, as a route would run them
+ */
+#include "Bench.h"
+
+#include <string>
+
+#include "Cors.h"
+#include "QueryParser.h"
+
+using namespace std;
+using namespace Theros;
+using namespace Theros::bench;
+
+BENCH_CASE("middleware/QueryParser, 8 pairs")
+{
+    Request req;
+    Response res;
+    req.uri.query = "q=event+loops&lang=en&page=2&per_page=50&sort=date&order=desc&ref=home&utm_source=newsletter";
+    QueryParser query_parser;
+
+    for (size_t i = 0; i < state.iterations; ++i) {
+        req.uri_query.clear();
+        Context ctx(req, res);
+        query_parser(ctx);
+        keep(req.uri_query);
+    }
+    state.bytes = req.uri.query.size();
+}
+
+BENCH_CASE("middleware/Cors, simple request")
+{
+    Request req;
+    req.method = RequestMethod::GET;
+    req.SetHeader({"Origin", "https://app.example.com"});
+    Cors cors({"https://www.example.com", "https://app.example.com"}, {RequestMethod::GET, RequestMethod::POST});
+
+    for (size_t i = 0; i < state.iterations; ++i) {
+        Response res;
+        Context ctx(req, res);
+        cors(ctx);
+        keep(res);
+    }
+}
+
+BENCH_CASE("middleware/Cors, preflight")
+{
+    Request req;
+    req.method = RequestMethod::OPTIONS;
+    req.SetHeader({"Origin", "https://app.example.com"});
+    req.SetHeader({"Access-Control-Request-Method", "POST"});
+    Cors cors({"https://www.example.com", "https://app.example.com"}, {RequestMethod::GET, RequestMethod::POST});
+
+    for (size_t i = 0; i < state.iterations; ++i) {
+        Response res;
+        Context ctx(req, res);
+        cors(ctx);
+        keep(res);
+    }
+}
@@ -0,0 +1,83 @@
+/**
+ * Router::resolve on tables of 10, 1k and 50k routes, half static and half with a parameter,
+ * looked up in an order that defeats caches of a single path
+ */
+#include "Bench.h"
+
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Router.h"
+
+using namespace std;
+using namespace Theros;
+using namespace Theros::bench;
+
+namespace
+{
+struct RouteTable {
+    Router router;
+    vector<string> paths;       // requested, each resolves to a route
+};
+
+// built once per size, 50k routes take a while
+RouteTable &table(size_t routes)
+{
+    static vector<pair<size_t, unique_ptr<RouteTable>>> tables;
+    for (auto &t : tables)
+        if (t.first == routes) return *t.second;
+
+    auto t = make_unique<RouteTable>();
+    for (size_t i = 0; i < routes; ++i) {
+        auto n = to_string(i);
+        if (i % 2)
+            t->router.get("/api/v" + to_string(i % 3) + "/resource" + n + "/<id>", [](Context &) {});
+        else
+            t->router.get("/static/section" + to_string(i % 17) + "/page" + n + ".html", [](Context &) {});
+    }
+
+    mt19937 random(42);
+    for (size_t i = 0; i < 1024; ++i) {
+        auto r = random() % routes;
+        auto n = to_string(r);
+        if (r % 2)
+            t->paths.push_back("/api/v" + to_string(r % 3) + "/resource" + n + "/" + to_string(random() % 100000));
+        else
+            t->paths.push_back("/static/section" + to_string(r % 17) + "/page" + n + ".html");
+    }
+
+    tables.emplace_back(routes, move(t));
+    return *tables.back().second;
+}
+
+void resolve(State &state, size_t routes)
+{
+    auto &t = table(routes);
+    auto &router = t.router;
+    vector<pair<string, string>> kv;
+    for (size_t i = 0; i < state.iterations; ++i) {
+        kv.clear();
+        auto route = router.resolve(RequestMethod::GET, t.paths[i % t.paths.size()], kv);
+        keep(route);
+    }
+}
+
+void miss(State &state, size_t routes)
+{
+    auto &router = table(routes).router;
+    const string path = "/api/v1/unknown/resource/42";
+    for (size_t i = 0; i < state.iterations; ++i) {
+        auto route = router.resolve(RequestMethod::GET, path);
+        keep(route);
+    }
+}
+}
+
+
+BENCH_CASE("router/resolve, 10 routes") { resolve(state, 10); }
+BENCH_CASE("router/resolve, 1k routes") { resolve(state, 1000); }
+BENCH_CASE("router/resolve, 50k routes") { resolve(state, 50000); }
+BENCH_CASE("router/resolve miss, 50k routes") { miss(state, 50000); }
@@ -0,0 +1,65 @@
+/**
+ * Time of serving one 1MiB file with StaticFiles (FileBody, sendfile)
+ * against serving the same bytes from a std::string body
+ */
+#include "Bench.h"
+#include "BenchServer.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace std;
+using namespace Theros;
+using namespace Theros::bench;
+
+namespace
+{
+constexpr size_t file_bytes = 1 << 20;
+const string dir = "/tmp";
+const string name = "theros_bench_static.bin";
+
+struct StaticFilesServer {
+    string content;
+    BenchServer server;
+
+    StaticFilesServer()
+        : content(make_content()),
+          server(18080, [this](HttpServer &app) {
+              app.router_.use("/static", StaticFiles(dir));
+              app.router_.get("/string", [this](Context &ctx) {
+                  ctx.res.body = content;
+                  ctx.res.ContentLength(ctx.res.body.size());
+              });
+          })
+    {}
+    ~StaticFilesServer() { remove((dir + "/" + name).c_str()); }
+
+    static string make_content()
+    {
+        string content(file_bytes, '\0');
+        for (size_t i = 0; i < file_bytes; ++i) content[i] = static_cast<char>('a' + i % 26);
+        ofstream(dir + "/" + name, ios::binary) << content;
+        return content;
+    }
+};
+
+BenchServer &server()
+{
+    static StaticFilesServer s;
+    return s.server;
+}
+
+void serve(State &state, const string &path)
+{
+    auto &s = server();
+    size_t received = 0;
+    for (size_t i = 0; i < state.iterations; ++i)
+        received += s.get(path);
+    state.bytes = received / state.iterations;
+}
+}
+
+
+BENCH_CASE("server/GET 1MiB, std::string body") { serve(state, "/string"); }
+BENCH_CASE("server/GET 1MiB, StaticFiles") { serve(state, "/static/" + name); }
@@ -0,0 +1,186 @@
+/**
+ * Runs benchmark cases of bench/, writes results as JSON
+ *
+ *      ./bin/bench [--filter=<substring>] [--min-time=<seconds>] [--repetitions=<n>] [--out=<file>] [--perf]
+ *
+ * JSON goes to stdout unless --out is given, progress goes to stderr
+ *
+ * With --perf, cycles, instructions, cache misses and branch misses of the bench thread are counted
+ * over the timed runs, and reported per iteration along with IPC
+ */
+#include "Bench.h"
+#include "Defines.h"
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace Theros;
+using namespace Theros::bench;
+
+namespace Theros
+{
+namespace bench
+{
+vector<pair<string, BenchFunc>> &registry()
+{
+    static vector<pair<string, BenchFunc>> cases;
+    return cases;
+}
+} // namespace bench
+} // namespace Theros
+
+/** Seconds taken by one run of f over iterations */
+static double time_run(const BenchFunc &f, State &state)
+{
+    auto start = chrono::steady_clock::now();
+    f(state);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/** Per iteration, over all runs, and IPC if both cycles and instructions were counted */
+static JsonType per_op(const PerfCounters::Counts &counts, double iterations)
+{
+    JsonType result = JsonType::object();
+    for (int i = 0; i < PerfCounters::counter_count; ++i)
+        if (counts.valid[i])
+            result[string(PerfCounters::name(PerfCounters::Counter(i))) + "_per_op"] = counts.values[i] / iterations;
+    if (counts.valid[PerfCounters::cycles] && counts.valid[PerfCounters::instructions] && counts.values[PerfCounters::cycles] > 0)
+        result["ipc"] = counts.values[PerfCounters::instructions] / counts.values[PerfCounters::cycles];
+    return result;
+}
+
+static JsonType run_case(const string &name, const BenchFunc &f, double min_time, int repetitions, PerfCounters *counters)
+{
+    State state{1};
+    // calibrate, time of a run is dominated by cost of iterations rather than of timer
+    while (time_run(f, state) < min_time && state.iterations < (size_t(1) << 40))
+        state.iterations *= 2;
+
+    vector<double> ns_per_op;
+    PerfCounters::Counts total;
+    for (int i = 0; i < repetitions; ++i) {
+        if (counters) counters->start();
+        ns_per_op.push_back(time_run(f, state) * 1e9 / state.iterations);
+        if (!counters) continue;
+        auto counts = counters->stop();
+        for (int c = 0; c < PerfCounters::counter_count; ++c) {
+            total.values[c] += counts.values[c];
+            total.valid[c] = counts.valid[c];
+        }
+    }
+    sort(ns_per_op.begin(), ns_per_op.end());
+    double median = ns_per_op[ns_per_op.size() / 2];
+
+    JsonType result = {
+        {"name", name},
+        {"iterations", state.iterations},
+        {"repetitions", repetitions},
+        {"ns_per_op", median},
+        {"min_ns_per_op", ns_per_op.front()},
+        {"max_ns_per_op", ns_per_op.back()},
+    };
+    if (state.bytes)
+        result["bytes_per_second"] = state.bytes / (median / 1e9);
+    if (counters)
+        result["counters"] = per_op(total, double(state.iterations) * repetitions);
+
+    fprintf(stderr, "%-48s %12.1f ns/op", name.c_str(), median);
+    if (state.bytes) fprintf(stderr, " %10.1f MB/s", state.bytes / (median / 1e9) / (1 << 20));
+    if (counters) {
+        auto &c = result["counters"];
+        if (c.count("ipc")) fprintf(stderr, "  IPC %5.2f", c["ipc"].get<double>());
+        if (c.count("cache_misses_per_op")) fprintf(stderr, "  cache-miss/op %8.2f", c["cache_misses_per_op"].get<double>());
+        if (c.count("branch_misses_per_op")) fprintf(stderr, "  branch-miss/op %8.2f", c["branch_misses_per_op"].get<double>());
+    }
+    fprintf(stderr, "\n");
+    return result;
+}
+
+static JsonType context(bool perf)
+{
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    JsonType build = {
+#ifdef __VERSION__
+        {"compiler", __VERSION__},
+#endif
+#ifdef NDEBUG
+        {"assertions", false},
+#else
+        {"assertions", true},
+#endif
+#ifdef _TRACE_
+        {"trace", true},
+#else
+        {"trace", false},
+#endif
+#ifdef _ALLOC_PROFILE_
+        {"alloc_profile", true},
+#else
+        {"alloc_profile", false},
+#endif
+    };
+    return {{"date", date}, {"build", build}, {"perf_counters", perf}};
+}
+
+int main(int argc, char *argv[])
+{
+    string filter, out;
+    double min_time = 0.2;
+    int repetitions = 5;
+    bool perf = false;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        auto value = arg.substr(arg.find('=') + 1);
+        if (arg.rfind("--filter=", 0) == 0) filter = value;
+        else if (arg.rfind("--min-time=", 0) == 0) min_time = atof(value.c_str());
+        else if (arg.rfind("--repetitions=", 0) == 0) repetitions = max(1, atoi(value.c_str()));
+        else if (arg.rfind("--out=", 0) == 0) out = value;
+        else if (arg == "--perf") perf = true;
+        else {
+            fprintf(stderr, "usage: %s [--filter=<substring>] [--min-time=<seconds>] [--repetitions=<n>] [--out=<file>] [--perf]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    unique_ptr<PerfCounters> counters;
+    if (perf) {
+        counters = make_unique<PerfCounters>();
+        if (!counters->available()) {
+            fprintf(stderr, "hardware counters unavailable, %s, running without\n", counters->error().c_str());
+            counters.reset();
+        }
+    }
+
+    auto cases = registry();
+    sort(cases.begin(), cases.end(), [](auto &a, auto &b) { return a.first < b.first; });
+
+    JsonType benchmarks = JsonType::array();
+    for (auto &c : cases) {
+        if (c.first.find(filter) == string::npos) continue;
+        benchmarks.push_back(run_case(c.first, c.second, min_time, repetitions, counters.get()));
+    }
+
+    JsonType results = {{"context", context(counters != nullptr)}, {"benchmarks", benchmarks}};
+    if (out.empty()) {
+        cout << results.dump(2) << eol;
+    } else {
+        ofstream file(out);
+        file << results.dump(2) << eol;
+    }
+    return 0;
+}
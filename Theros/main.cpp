@@ -17,10 +17,9 @@ using namespace Theros;
 using nlohmann::json;
 
 template <typename ServerType = HttpServer>
-void make_server(int port)
+void make_server(ServerConfig config)
 {
-    ServerAddr addr = make_pair("127.0.0.1", port);
-    auto app = ServerType(addr);
+    ServerType app(config);
     auto &r = app.router_;
 
     r.use("/", [](Context & ctx) {
@@ -46,21 +45,28 @@ void make_server(int port)
             {"query", ctx.query},
             {"param", ctx.param},
         };
-        cout << setw(4) << urlparse << eol;
+        ctx.res.SetHeader({"Content-Type", "application/json"});
+        ctx.res.SetBody<DefaultBody>(urlparse.dump(4));
     });
 
+    // requests are logged off the event loop, handlers should not write to cout
+    app.access_log().open("-");
+
     string msg = "app starts running on " + app.host() + ":" + to_string(app.port()) + eol;
     cout << msg;
 
     app.run();
 }
 
+// ./bin/server [Theros/config.json], see ServerConfig, run from top of repository
 int main(int argc, char *argv[]) {
     try {
-    thread server_task(make_server<>, 8888);
+    auto config = argc > 1 ? ServerConfig::load(argv[1]) : ServerConfig();
+    thread server_task(make_server<>, config);
     server_task.join();
-    } catch (const exception e) {
+    } catch (const exception &e) {
     cerr << e.what() << eol;
+    return 1;
     }
 
     return 0;
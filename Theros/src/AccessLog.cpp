@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+#include "AccessLog.h"
+
+namespace Theros
+{
+
+asio::io_service::id AccessLog::id;
+constexpr std::size_t AccessRecord::path_bytes;
+constexpr std::size_t AccessRecord::peer_bytes;
+constexpr std::size_t AccessLog::default_ring_records;
+constexpr std::chrono::milliseconds AccessLog::flush_interval;
+
+namespace
+{
+std::size_t copy_cut(char *to, std::size_t at, std::size_t capacity, const std::string &from)
+{
+  auto n = std::min(from.size(), capacity - at);
+  std::memcpy(to + at, from.data(), n);
+  return at + n;
+}
+
+// quotes and backslashes escaped, other bytes outside printable ASCII as \xhh, or \u00hh for JSON
+void append_escaped(std::string &out, const char *data, std::size_t size, bool json)
+{
+  static const char hex[] = "0123456789abcdef";
+  for (std::size_t i = 0; i < size; ++i) {
+    auto c = static_cast<unsigned char>(data[i]);
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += static_cast<char>(c);
+    } else if (c < 0x20 || c >= 0x7f) {
+      out += json ? "\\u00" : "\\x";
+      out += hex[c >> 4];
+      out += hex[c & 0xf];
+    } else {
+      out += static_cast<char>(c);
+    }
+  }
+}
+
+// formats second of time once, records of a batch mostly share it
+const char *format_time(std::int64_t ns, bool iso)
+{
+  thread_local std::int64_t cached_second[2] = {-1, -1};
+  thread_local char cached[2][32];
+
+  auto second = ns / 1000000000;
+  auto &text = cached[iso];
+  if (cached_second[iso] != second) {
+    std::time_t t = static_cast<std::time_t>(second);
+    std::tm tm;
+    gmtime_r(&t, &tm);
+    std::strftime(text, sizeof(text), iso ? "%Y-%m-%dT%H:%M:%S" : "%d/%b/%Y:%H:%M:%S +0000", &tm);
+    cached_second[iso] = second;
+  }
+  return text;
+}
+
+const char *method_name(RequestMethod method)
+{
+  auto m = static_cast<std::size_t>(method);
+  return m < method_count ? request_methods[m] : "-";
+}
+}
+
+
+void AccessRecord::set_path(const std::string &abs_path, const std::string &query)
+{
+  auto n = copy_cut(path, 0, path_bytes, abs_path);
+  if (!query.empty() && n < path_bytes) {
+    path[n++] = '?';
+    n = copy_cut(path, n, path_bytes, query);
+  }
+  path_length = static_cast<std::uint8_t>(n);
+}
+
+
+void AccessRecord::set_peer(const std::string &address)
+{
+  peer_length = static_cast<std::uint8_t>(copy_cut(peer, 0, peer_bytes, address));
+}
+
+
+AccessLog::AccessLog(asio::io_service &io_service)
+    : asio::io_service::service(io_service)
+{
+}
+
+
+bool AccessLog::open(const std::string &path, AccessLogFormat format)
+{
+  return open(path, [format](std::string &out, const AccessRecord &record) { AccessLog::format(out, record, format); });
+}
+
+
+bool AccessLog::open(const std::string &path, Formatter formatter)
+{
+  close();
+  std::lock_guard<std::mutex> lock(mutex_);
+  out_ = path == "-" ? stdout : std::fopen(path.c_str(), "a");
+  if (!out_) return false;
+
+  formatter_ = std::move(formatter);
+  stopping_ = false;
+  writer_ = std::thread([this]() { run(); });
+  enabled_.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+
+void AccessLog::close()
+{
+  std::thread writer;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!writer_.joinable()) return;
+    enabled_.store(false, std::memory_order_relaxed);
+    stopping_ = true;
+    writer = std::move(writer_);
+  }
+  wake_.notify_one();
+  writer.join();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (out_ != stdout) std::fclose(out_);
+  out_ = nullptr;
+}
+
+
+void AccessLog::set_ring_records(std::size_t records)
+{
+  std::size_t capacity = 1;
+  while (capacity < records) capacity <<= 1;
+  ring_records_.store(capacity, std::memory_order_relaxed);
+}
+
+
+bool AccessLog::log(const AccessRecord &record)
+{
+  auto &ring = rings_.local(ring_records_.load(std::memory_order_relaxed));
+  auto head = ring.head.load(std::memory_order_relaxed);
+  if (head - ring.tail.load(std::memory_order_acquire) == ring.records.size()) {
+    ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  ring.records[head & (ring.records.size() - 1)] = record;
+  ring.head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+
+std::uint64_t AccessLog::dropped() const
+{
+  std::uint64_t dropped = 0;
+  rings_.for_each([&dropped](Ring &ring) { dropped += ring.dropped.load(std::memory_order_relaxed); });
+  return dropped;
+}
+
+
+void AccessLog::run()
+{
+  std::string batch;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // drains once more after being stopped, records logged before close() are written
+    bool stop = stopping_;
+    lock.unlock();
+
+    batch.clear();
+    auto drained = drain(batch);
+    if (!batch.empty()) {
+      std::fwrite(batch.data(), 1, batch.size(), out_);
+      std::fflush(out_);
+      written_.fetch_add(drained, std::memory_order_relaxed);
+    }
+
+    lock.lock();
+    if (stop) break;
+    wake_.wait_for(lock, flush_interval, [this]() { return stopping_; });
+  }
+}
+
+
+std::size_t AccessLog::drain(std::string &batch)
+{
+  std::size_t drained = 0;
+  rings_.for_each([this, &batch, &drained](Ring &ring) {
+    auto tail = ring.tail.load(std::memory_order_relaxed);
+    auto head = ring.head.load(std::memory_order_acquire);
+    for (auto i = tail; i != head; ++i)
+      formatter_(batch, ring.records[i & (ring.records.size() - 1)]);
+    ring.tail.store(head, std::memory_order_release);
+    drained += head - tail;
+  });
+  return drained;
+}
+
+
+void AccessLog::format(std::string &out, const AccessRecord &record, AccessLogFormat format)
+{
+  char number[160];
+  if (format == AccessLogFormat::json) {
+    out += "{\"time\":\"";
+    out += format_time(record.time, true);
+    snprintf(number, sizeof(number), ".%03dZ\",\"peer\":\"", static_cast<int>(record.time / 1000000 % 1000));
+    out += number;
+    append_escaped(out, record.peer, record.peer_length, true);
+    out += "\",\"method\":\"";
+    out += method_name(record.method);
+    out += "\",\"path\":\"";
+    append_escaped(out, record.path, record.path_length, true);
+    snprintf(number, sizeof(number), "\",\"status\":%d,\"bytes_in\":%llu,\"bytes_out\":%llu,\"latency\":%.9f}\n",
+             record.status, (unsigned long long)record.bytes_in, (unsigned long long)record.bytes_out,
+             record.latency / 1e9);
+    out += number;
+    return;
+  }
+
+  if (record.peer_length)
+    append_escaped(out, record.peer, record.peer_length, false);
+  else
+    out += '-';
+  out += " - - [";
+  out += format_time(record.time, false);
+  out += "] \"";
+  out += method_name(record.method);
+  out += ' ';
+  append_escaped(out, record.path, record.path_length, false);
+  out += ' ';
+  out += version_as_string(record.version);
+  snprintf(number, sizeof(number), "\" %d %llu", record.status, (unsigned long long)record.bytes_out);
+  out += number;
+  if (format == AccessLogFormat::common_latency) {
+    snprintf(number, sizeof(number), " %.6f", record.latency / 1e9);
+    out += number;
+  }
+  out += '\n';
+}
+
+} // namespace Theros
@@ -0,0 +1,132 @@
+#ifndef __ACCESS_LOG_H__
+#define __ACCESS_LOG_H__
+
+#include "asio.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Constants.h"
+#include "Message.h"
+#include "ThreadShards.h"
+
+namespace Theros
+{
+
+/**
+ * @brief   A request as access logged, fixed size and trivially copyable, longer path and peer are cut
+ */
+struct AccessRecord {
+  static constexpr std::size_t path_bytes = 176;
+  static constexpr std::size_t peer_bytes = 46;    // INET6_ADDRSTRLEN
+
+  std::int64_t time;            // response written, nanoseconds since epoch
+  std::int64_t latency;         // nanoseconds, from headers parsed to response written
+  std::uint64_t bytes_in;
+  std::uint64_t bytes_out;
+  std::uint16_t status;
+  RequestMethod method;
+  HttpVersion version;
+  std::uint8_t path_length;
+  std::uint8_t peer_length;
+  char path[path_bytes];        // abs_path?query, not terminated
+  char peer[peer_bytes];        // address of client, not terminated
+
+  void set_path(const std::string &abs_path, const std::string &query);
+  void set_peer(const std::string &address);
+};
+
+static_assert(std::is_trivially_copyable<AccessRecord>::value, "AccessRecord is copied into rings as is");
+
+enum class AccessLogFormat {
+  common,           // 127.0.0.1 - - [18/Oct/2026:15:25:02 +0000] "GET /users/1 HTTP/1.1" 200 93
+  common_latency,   // common followed by latency in seconds
+  json,             // {"time":"2026-10-18T15:25:02.123Z","peer":"127.0.0.1","method":"GET",...} per line
+};
+
+
+/**
+ * @brief   Access log written off the event loop, an io_service service, one per io_service
+ *
+ *          server.access_log().open("access.log");                   // or "-" for stdout
+ *          server.access_log().open("-", AccessLogFormat::json);
+ *
+ *          -- Connection pushes a record of each routed request, once its response is written,
+ *             into a single producer single consumer ring of its thread, with no lock and no allocation
+ *          -- a background thread drains rings every flush_interval, formats records and writes
+ *             them in one batch
+ *          -- a full ring drops records rather than block the event loop, dropped() counts them
+ */
+class AccessLog : public asio::io_service::service
+{
+public:
+  using Formatter = std::function<void(std::string &out, const AccessRecord &record)>;
+  static constexpr std::size_t default_ring_records = 1 << 12;
+  static constexpr auto flush_interval = std::chrono::milliseconds(100);
+
+  static asio::io_service::id id;
+
+  explicit AccessLog(asio::io_service &io_service);
+  ~AccessLog() { close(); }
+
+  /** Starts logging, appending to path or to stdout for "-", false if it cannot be opened */
+  bool open(const std::string &path, AccessLogFormat format = AccessLogFormat::common);
+  bool open(const std::string &path, Formatter formatter);
+  /** Stops logging, writing out records logged so far */
+  void close();
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  /** Capacity of rings of threads logging for the first time from now, a power of two */
+  void set_ring_records(std::size_t records);
+
+  /** Queues record on ring of calling thread, false if dropped */
+  bool log(const AccessRecord &record);
+
+  /** Records written out, and dropped on a full ring, since construction */
+  std::uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+  std::uint64_t dropped() const;
+
+  /** Appends record in format to out, with a newline */
+  static void format(std::string &out, const AccessRecord &record, AccessLogFormat format);
+
+  void shutdown_service() { close(); }
+
+private:
+  struct Ring {
+    explicit Ring(std::size_t capacity) : records(capacity) {}
+    std::vector<AccessRecord> records;
+    alignas(64) std::atomic<std::uint64_t> head{0};     // next to write, by producer
+    alignas(64) std::atomic<std::uint64_t> tail{0};     // next to read, by consumer
+    alignas(64) std::atomic<std::uint64_t> dropped{0};
+  };
+
+  std::atomic<bool> enabled_{false};
+  std::atomic<std::size_t> ring_records_{default_ring_records};
+  std::atomic<std::uint64_t> written_{0};
+
+  ThreadShards<Ring> rings_;
+
+  std::mutex mutex_;            // guards members below, and open and close
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  std::thread writer_;
+  std::FILE *out_ = nullptr;
+  Formatter formatter_;
+
+  void run();
+  // formats records of all rings into batch, returns number drained
+  std::size_t drain(std::string &batch);
+};
+
+} // namespace Theros
+#endif // __ACCESS_LOG_H__
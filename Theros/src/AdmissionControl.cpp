@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cmath>
+
+#include "AdmissionControl.h"
+
+namespace Theros
+{
+
+asio::io_service::id AdmissionControl::id;
+
+
+AdmissionControl::AdmissionControl(asio::io_service &io_service)
+    : asio::io_service::service(io_service), io_service_(io_service),
+      limit_(static_cast<double>(options_.initial_limit))
+{
+}
+
+
+void AdmissionControl::configure(const Options &options)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  options_ = options;
+  limit_ = static_cast<double>(options_.initial_limit);
+  long_latency_ = 0;
+}
+
+
+auto AdmissionControl::open_connection(const std::string &ip) -> Slot
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Slot slot;
+  slot.control_ = this;
+  slot.ip_ = ip;
+  ++connections_;
+  auto count = ++connections_per_ip_[ip];
+  if (options_.max_connections_per_ip && count > options_.max_connections_per_ip) {
+    slot.over_limit_ = true;
+    ++rejected_connections_;
+  }
+  return slot;
+}
+
+
+void AdmissionControl::close_connection(const std::string &ip)
+{
+  std::function<void()> on_accepting;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --connections_;
+    auto it = connections_per_ip_.find(ip);
+    if (it != connections_per_ip_.end() && --it->second == 0)
+      connections_per_ip_.erase(it);
+    if (on_accepting_ && (!options_.max_connections || connections_ < options_.max_connections))
+      on_accepting.swap(on_accepting_);
+  }
+  if (on_accepting)
+    io_service_.post(std::move(on_accepting));
+}
+
+
+bool AdmissionControl::accepting() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !options_.max_connections || connections_ < options_.max_connections;
+}
+
+
+void AdmissionControl::when_accepting(std::function<void()> f)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (options_.max_connections && connections_ >= options_.max_connections) {
+      on_accepting_ = std::move(f);
+      ++accept_pauses_;
+      return;
+    }
+  }
+  io_service_.post(std::move(f));
+}
+
+
+auto AdmissionControl::try_acquire() -> Permit
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (options_.limit != ConcurrencyLimit::none && in_flight_ >= static_cast<std::size_t>(limit_)) {
+    ++rejected_requests_;
+    return {};
+  }
+  ++in_flight_;
+  Permit permit;
+  permit.control_ = this;
+  permit.acquired_at_ = Clock::now();
+  return permit;
+}
+
+
+void AdmissionControl::release(Clock::duration latency, bool sampled)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (sampled) update_limit(latency);
+  --in_flight_;
+}
+
+
+void AdmissionControl::update_limit(Clock::duration latency)
+{
+  double limit = limit_;
+
+  switch (options_.limit) {
+    case ConcurrencyLimit::none:
+    case ConcurrencyLimit::fixed:
+      return;
+
+    case ConcurrencyLimit::aimd: {
+      if (latency > options_.aimd_latency_threshold)
+        limit = limit * options_.aimd_backoff;
+      else if (in_flight_ * 2 >= limit)
+        limit = limit + 1;
+      break;
+    }
+
+    case ConcurrencyLimit::gradient: {
+      double sample = std::chrono::duration<double>(latency).count();
+      if (sample <= 0) return;
+      if (long_latency_ == 0) long_latency_ = sample;
+      double factor = 2.0 / (options_.gradient_window + 1);
+      long_latency_ = long_latency_ * (1 - factor) + sample * factor;
+      // long term average lags far behind after a sustained spike, let it catch up
+      if (long_latency_ / sample > 2) long_latency_ *= 0.95;
+
+      // mostly idle, samples say nothing about how far limit could go
+      if (in_flight_ * 2 < limit) return;
+
+      double gradient = std::max(0.5, std::min(1.0, long_latency_ / sample));
+      double target = limit * gradient + std::sqrt(limit);
+      limit = limit * (1 - options_.gradient_smoothing) + target * options_.gradient_smoothing;
+      break;
+    }
+  }
+
+  limit_ = std::max<double>(options_.min_limit, std::min<double>(options_.max_limit, limit));
+}
+
+
+std::chrono::seconds AdmissionControl::retry_after() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return options_.retry_after;
+}
+
+
+auto AdmissionControl::stats() const -> Stats
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::size_t limit = options_.limit == ConcurrencyLimit::none ? 0 : static_cast<std::size_t>(limit_);
+  return {limit, in_flight_, connections_, rejected_requests_, rejected_connections_, accept_pauses_};
+}
+
+
+auto AdmissionControl::Slot::operator=(Slot &&other) noexcept -> Slot &
+{
+  if (this != &other) {
+    release();
+    control_ = other.control_;
+    ip_ = std::move(other.ip_);
+    over_limit_ = other.over_limit_;
+    other.control_ = nullptr;
+  }
+  return *this;
+}
+
+
+void AdmissionControl::Slot::release()
+{
+  if (!control_) return;
+  control_->close_connection(ip_);
+  control_ = nullptr;
+}
+
+
+auto AdmissionControl::Permit::operator=(Permit &&other) noexcept -> Permit &
+{
+  if (this != &other) {
+    // dropped without a sample, e.g. connection failed before responding
+    if (control_) control_->release(Clock::duration::zero(), false);
+    control_ = other.control_;
+    acquired_at_ = other.acquired_at_;
+    other.control_ = nullptr;
+  }
+  return *this;
+}
+
+
+AdmissionControl::Permit::~Permit()
+{
+  if (control_) control_->release(Clock::duration::zero(), false);
+}
+
+
+void AdmissionControl::Permit::release()
+{
+  if (control_) release(Clock::now() - acquired_at_);
+}
+
+
+void AdmissionControl::Permit::release(Clock::duration latency)
+{
+  if (!control_) return;
+  control_->release(latency, true);
+  control_ = nullptr;
+}
+
+} // namespace Theros
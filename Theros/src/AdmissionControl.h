@@ -0,0 +1,152 @@
+#ifndef __ADMISSIONCONTROL_H__
+#define __ADMISSIONCONTROL_H__
+
+#include "asio.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Theros
+{
+
+/** How limit on in-flight requests is set */
+enum class ConcurrencyLimit
+{
+  none,       // unlimited
+  fixed,      // initial_limit
+  aimd,       // additive increase, multiplicative decrease on samples over aimd_latency_threshold
+  gradient    // scaled by long term over current latency, grows by sqrt(limit) headroom
+};
+
+struct AdmissionOptions {
+    std::size_t max_connections = 0;            // accept pauses at this many live connections, 0 is unlimited
+    std::size_t max_connections_per_ip = 0;     // requests on further connections of an address get 503, 0 is unlimited
+
+    ConcurrencyLimit limit = ConcurrencyLimit::none;   // on requests between routing and response
+    std::size_t initial_limit = 64;
+    std::size_t min_limit = 4;
+    std::size_t max_limit = 1024;
+
+    std::chrono::steady_clock::duration aimd_latency_threshold = std::chrono::milliseconds(100);
+    double aimd_backoff = 0.9;                  // limit is multiplied by it on a slow sample
+    double gradient_smoothing = 0.2;            // weight of new limit against current one
+    std::size_t gradient_window = 600;          // samples in long term latency average
+
+    std::chrono::seconds retry_after{1};        // Retry-After of rejected requests
+};
+
+/**
+ * @brief   Caps live connections and in-flight requests, an io_service service, one per io_service
+ *
+ *          auto &admission = asio::use_service<AdmissionControl>(io_service);
+ *          admission.configure(options);
+ *
+ *          -- Server stops accepting once max_connections are open, resumes as one closes,
+ *             pending connections wait in listen backlog
+ *          -- Connection answers with 503 and Retry-After, before running handlers,
+ *             if its address is over max_connections_per_ip or limit on in-flight requests is hit
+ *          -- latency of each admitted request, from routing to its response being written,
+ *             adapts limit for ConcurrencyLimit::aimd and ConcurrencyLimit::gradient
+ */
+class AdmissionControl : public asio::io_service::service
+{
+public:
+  using Options = AdmissionOptions;
+  using Clock = std::chrono::steady_clock;
+
+  struct Stats {
+    std::size_t   limit;                  // current limit on in-flight requests, 0 is unlimited
+    std::size_t   in_flight;
+    std::size_t   connections;
+    std::uint64_t rejected_requests;      // over limit
+    std::uint64_t rejected_connections;   // over max_connections_per_ip
+    std::uint64_t accept_pauses;          // times max_connections was hit
+  };
+
+  /** Live connection, counted until destroyed */
+  class Slot
+  {
+  public:
+    Slot() = default;
+    Slot(Slot &&other) noexcept { *this = std::move(other); }
+    Slot &operator=(Slot &&other) noexcept;
+    ~Slot() { release(); }
+
+    /** Address of connection is over max_connections_per_ip */
+    bool over_limit() const { return over_limit_; }
+    void release();
+  private:
+    friend class AdmissionControl;
+    AdmissionControl *control_ = nullptr;
+    std::string ip_;
+    bool over_limit_ = false;
+  };
+
+  /** Admitted request, counted as in flight until released */
+  class Permit
+  {
+  public:
+    Permit() = default;
+    Permit(Permit &&other) noexcept { *this = std::move(other); }
+    Permit &operator=(Permit &&other) noexcept;
+    ~Permit();
+
+    explicit operator bool() const { return control_ != nullptr; }
+    /** Done, time since acquired is a latency sample */
+    void release();
+    /** Done, with latency measured by caller */
+    void release(Clock::duration latency);
+  private:
+    friend class AdmissionControl;
+    AdmissionControl *control_ = nullptr;
+    Clock::time_point acquired_at_;
+  };
+
+  static asio::io_service::id id;
+
+  explicit AdmissionControl(asio::io_service &io_service);
+
+  /** Replaces options, limit restarts from initial_limit */
+  void configure(const Options &options);
+
+  /** Registers connection from ip, see Slot::over_limit */
+  Slot open_connection(const std::string &ip);
+  /** Below max_connections */
+  bool accepting() const;
+  /** Posts f once accepting() again, replaces earlier f */
+  void when_accepting(std::function<void()> f);
+
+  /** Admits a request, empty permit if limit is hit */
+  Permit try_acquire();
+
+  std::chrono::seconds retry_after() const;
+  Stats stats() const;
+
+  void shutdown_service() {}
+
+private:
+  asio::io_service &io_service_;
+  Options options_;
+  mutable std::mutex mutex_;
+
+  std::size_t connections_ = 0;
+  std::unordered_map<std::string, std::size_t> connections_per_ip_;
+  std::function<void()> on_accepting_;
+
+  double limit_ = 0;
+  std::size_t in_flight_ = 0;
+  double long_latency_ = 0;           // gradient, moving average of samples in seconds
+
+  std::uint64_t rejected_requests_ = 0, rejected_connections_ = 0, accept_pauses_ = 0;
+
+  void close_connection(const std::string &ip);
+  void release(Clock::duration latency, bool sampled);
+  void update_limit(Clock::duration latency);
+};
+
+} // namespace Theros
+#endif // __ADMISSIONCONTROL_H__
@@ -0,0 +1,181 @@
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "AllocProfiler.h"
+#include "Router.h"
+
+namespace Theros
+{
+
+namespace
+{
+// constant initialized, safe to touch from operator new at any time
+thread_local AllocCounters thread_counters;
+thread_local AllocCounters *phase_counters = nullptr;
+}
+
+
+std::string alloc_phase_as_string(AllocPhase phase)
+{
+  switch (phase) {
+    case AllocPhase::parse: return "parse";
+    case AllocPhase::route: return "route";
+    case AllocPhase::handlers: return "handlers";
+    case AllocPhase::serialize: return "serialize";
+    case AllocPhase::write: return "write";
+  }
+  return "";
+}
+
+
+AllocProfiler &AllocProfiler::instance()
+{
+  static AllocProfiler profiler;
+  return profiler;
+}
+
+
+void AllocProfiler::count(std::size_t bytes)
+{
+  ++thread_counters.allocations;
+  thread_counters.bytes += bytes;
+  if (phase_counters) {
+    ++phase_counters->allocations;
+    phase_counters->bytes += bytes;
+  }
+}
+
+
+AllocCounters AllocProfiler::thread_totals()
+{
+  return thread_counters;
+}
+
+
+AllocCounters *AllocProfiler::attribute_to(AllocCounters *counters)
+{
+  auto previous = phase_counters;
+  phase_counters = counters;
+  return previous;
+}
+
+
+void AllocProfiler::record(RequestMethod method, const std::string &route, const PhaseAllocs &phases)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &allocs = routes_[std::make_pair(route, method)];
+  allocs.method = method;
+  allocs.route = route;
+  ++allocs.requests;
+  for (std::size_t i = 0; i < alloc_phase_count; ++i) {
+    allocs.phases[i].allocations += phases[i].allocations;
+    allocs.phases[i].bytes += phases[i].bytes;
+  }
+}
+
+
+auto AllocProfiler::snapshot() const -> std::vector<RouteAllocs>
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<RouteAllocs> result;
+  for (auto &entry : routes_)
+    result.push_back(entry.second);
+  return result;
+}
+
+
+void AllocProfiler::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  routes_.clear();
+}
+
+
+std::string AllocProfiler::report() const
+{
+  std::string out;
+  char line[128];
+
+  for (auto &allocs : snapshot()) {
+    out += request_method_as_string(allocs.method) + " " + allocs.route +
+           " (" + std::to_string(allocs.requests) + " requests)\n";
+    snprintf(line, sizeof(line), "    %-10s %12s %14s\n", "phase", "allocs/req", "bytes/req");
+    out += line;
+    for (std::size_t i = 0; i < alloc_phase_count; ++i) {
+      double n = static_cast<double>(allocs.requests);
+      snprintf(line, sizeof(line), "    %-10s %12.2f %14.1f\n",
+               alloc_phase_as_string(static_cast<AllocPhase>(i)).c_str(),
+               allocs.phases[i].allocations / n, allocs.phases[i].bytes / n);
+      out += line;
+    }
+  }
+  return out;
+}
+
+
+std::function<void(Context &)> AllocProfiler::endpoint()
+{
+  return [this](Context &ctx) {
+    ctx.res.SetHeader({"Content-Type", "text/plain"});
+    ctx.res.SetBody<DefaultBody>(report());
+  };
+}
+
+} // namespace Theros
+
+
+#ifdef _ALLOC_PROFILE_
+
+// counting replacements of global allocation functions, sized and nothrow forms forward to these
+void *operator new(std::size_t size)
+{
+  Theros::AllocProfiler::count(size);
+  if (void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+  return ::operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+  Theros::AllocProfiler::count(size);
+  return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+  return ::operator new(size, tag);
+}
+
+void *operator new(std::size_t size, std::align_val_t align)
+{
+  Theros::AllocProfiler::count(size);
+  auto alignment = static_cast<std::size_t>(align);
+  // aligned_alloc wants size to be a multiple of alignment
+  if (void *p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment + (size ? 0 : alignment)))
+    return p;
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size, std::align_val_t align)
+{
+  return ::operator new(size, align);
+}
+
+// other forms forward to this one, as new[] does to new, so free only ever sees operator new's pointers
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { ::operator delete(p); }
+void operator delete(void *p, std::size_t) noexcept { ::operator delete(p); }
+void operator delete[](void *p, std::size_t) noexcept { ::operator delete(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { ::operator delete(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { ::operator delete(p); }
+void operator delete(void *p, std::align_val_t) noexcept { ::operator delete(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { ::operator delete(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { ::operator delete(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { ::operator delete(p); }
+
+#endif // _ALLOC_PROFILE_
@@ -0,0 +1,94 @@
+#ifndef __ALLOC_PROFILER_H__
+#define __ALLOC_PROFILER_H__
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Constants.h"
+#include "Defines.h"
+
+namespace Theros
+{
+
+struct Context;
+
+enum class AllocPhase { parse, route, handlers, serialize, write };
+constexpr std::size_t alloc_phase_count = 5;
+
+std::string alloc_phase_as_string(AllocPhase phase);
+
+struct AllocCounters {
+  std::uint64_t allocations = 0;
+  std::uint64_t bytes = 0;
+};
+using PhaseAllocs = std::array<AllocCounters, alloc_phase_count>;
+
+
+/**
+ * @brief   Heap allocations per request phase, summed per route, only if compiled with _ALLOC_PROFILE_,
+ *          which replaces global operator new and delete with counting ones
+ *
+ *          router.get("/allocs", AllocProfiler::instance().endpoint());
+ *
+ *          -- operator new counts into counters of calling thread, and into those of phase
+ *             set by innermost ALLOC_PHASE of Defines.h, if any, no lock nor atomic
+ *          -- Connection records per phase counts of each request, keyed by pattern of its route
+ */
+class AllocProfiler
+{
+public:
+  struct RouteAllocs {
+    RequestMethod method;
+    std::string route;
+    std::uint64_t requests = 0;
+    PhaseAllocs phases;       // summed over requests
+  };
+
+  static AllocProfiler &instance();
+
+  /** Called by operator new */
+  static void count(std::size_t bytes);
+  /** Allocations made so far by calling thread */
+  static AllocCounters thread_totals();
+  /** Allocations of calling thread also go to counters from now on, returns previous ones */
+  static AllocCounters *attribute_to(AllocCounters *counters);
+
+  void record(RequestMethod method, const std::string &route, const PhaseAllocs &phases);
+
+  /** Ordered by route then method */
+  std::vector<RouteAllocs> snapshot() const;
+  void clear();
+
+  /** Plain text, allocations and bytes per request of each phase, by route */
+  std::string report() const;
+  /** Handler serving report() */
+  std::function<void(Context &)> endpoint();
+
+private:
+  mutable std::mutex mutex_;
+  std::map<std::pair<std::string, RequestMethod>, RouteAllocs> routes_;
+
+  AllocProfiler() = default;
+};
+
+
+/** Attributes allocations of calling thread to counters over its lifetime, see ALLOC_PHASE */
+class AllocScope
+{
+public:
+  explicit AllocScope(AllocCounters &counters) : previous_(AllocProfiler::attribute_to(&counters)) {}
+  ~AllocScope() { AllocProfiler::attribute_to(previous_); }
+  AllocScope(const AllocScope &) = delete;
+  AllocScope &operator=(const AllocScope &) = delete;
+private:
+  AllocCounters *previous_;
+};
+
+} // namespace Theros
+#endif // __ALLOC_PROFILER_H__
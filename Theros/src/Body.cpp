@@ -0,0 +1,76 @@
+#include <fcntl.h>      // open
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // close
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#elif defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+
+#include "Body.h"
+
+namespace Theros
+{
+
+FileHandle::~FileHandle()
+{
+  if (fd_ >= 0) ::close(fd_);
+}
+
+
+auto FileBody::open(const std::string& path, std::error_code& ec) -> value_type
+{
+  value_type body;
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    ec = std::error_code(errno, std::generic_category());
+    return body;
+  }
+  body.file = std::make_shared<FileHandle>(fd);
+
+  struct stat st;
+  if (::fstat(fd, &st) < 0) {
+    ec = std::error_code(errno, std::generic_category());
+    body.file.reset();
+    return body;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    ec = std::make_error_code(std::errc::is_a_directory);
+    body.file.reset();
+    return body;
+  }
+
+  body.offset = 0;
+  body.length = static_cast<std::size_t>(st.st_size);
+  return body;
+}
+
+
+ssize_t send_file(int out_fd, int in_fd, off_t* offset, std::size_t count)
+{
+#if defined(__linux__)
+  return ::sendfile(out_fd, in_fd, offset, count);
+#elif defined(__APPLE__)
+  off_t len = count;
+  int ret = ::sendfile(in_fd, out_fd, *offset, &len, nullptr, 0);
+  *offset += len;
+  // partial transfers on non-blocking sockets report EAGAIN, with len bytes sent
+  if (ret < 0 && len == 0) return -1;
+  return len;
+#else
+  char buf[1 << 14];
+  ssize_t n = ::pread(in_fd, buf, std::min(count, sizeof(buf)), *offset);
+  if (n <= 0) return n;
+  n = ::write(out_fd, buf, n);
+  if (n > 0) *offset += n;
+  return n;
+#endif
+}
+
+} // namespace Theros
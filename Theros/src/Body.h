@@ -0,0 +1,115 @@
+#ifndef __BODY_H__
+#define __BODY_H__
+
+#include <sys/types.h>  // off_t, ssize_t
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <variant>
+
+namespace Theros
+{
+
+////////////////////////////////////////////////////////////////////////
+// Body types
+//
+//    A BodyType names the representation of a message body with value_type,
+//    Message<BodyType>::body is of type BodyType::value_type
+////////////////////////////////////////////////////////////////////////
+
+/** Body held in memory as a string */
+struct DefaultBody  {
+public:
+  using value_type = std::string;
+public:
+
+};
+
+
+/** Owns an open file descriptor, closed when last reference goes away */
+class FileHandle {
+public:
+  explicit FileHandle(int fd) : fd_(fd) { }
+  ~FileHandle();
+  FileHandle(const FileHandle&) = delete;
+  FileHandle& operator=(const FileHandle&) = delete;
+  int fd() const { return fd_; }
+private:
+  int fd_;
+};
+
+
+/**
+ * Body as a byte range of a file,
+ * sent with sendfile(2) where the transport allows
+ */
+struct FileBody {
+public:
+  struct value_type {
+    std::shared_ptr<FileHandle> file;
+    off_t       offset = 0;
+    std::size_t length = 0;
+  };
+public:
+  /** Opens file at path read only, range covers whole file */
+  static value_type open(const std::string& path, std::error_code& ec);
+};
+
+
+/**
+ * Body as an immutable reference counted buffer,
+ * one payload is shared between responses without copying
+ */
+struct SharedBufferBody {
+public:
+  using value_type = std::shared_ptr<const std::string>;
+public:
+  static value_type make(std::string data) { return std::make_shared<const std::string>(std::move(data)); }
+};
+
+
+/**
+ * Body produced on demand,
+ * the generator is pulled for next chunk only once previous chunk is written.
+ * Fills chunk and returns true if there is more to come, false once exhausted
+ */
+struct GeneratorBody {
+public:
+  using value_type = std::function<bool(std::string& chunk)>;
+};
+
+
+/**
+ * Whole response already serialized, headers included, written as is,
+ * e.g. replayed from a cache. status_line, if not empty, is written before payload,
+ * so it can follow version of request while payload is shared
+ */
+struct SerializedBody {
+public:
+  struct value_type {
+    std::shared_ptr<const std::string> payload;
+    std::string status_line;
+  };
+};
+
+
+/** Alternative body of a Response, monostate if Response::body is used */
+using AnyBody = std::variant<std::monostate,
+                             FileBody::value_type,
+                             SharedBufferBody::value_type,
+                             GeneratorBody::value_type,
+                             SerializedBody::value_type>;
+
+
+/**
+ * @brief   Copies count bytes from in_fd at *offset to out_fd without passing through user space,
+ *          advances *offset, same semantics as linux sendfile(2)
+ */
+ssize_t send_file(int out_fd, int in_fd, off_t* offset, std::size_t count);
+
+
+} // namespace Theros
+#endif // __BODY_H__
@@ -0,0 +1,186 @@
+#include <cctype>
+#include <iostream>
+#include <limits>
+
+#include "BodyParser.h"
+
+namespace Theros {
+
+
+BodyParser::BodyParser()
+  : state_(BodyParserState::body_start), framing_(BodyFraming::none),
+    remaining_(0), decoded_(0), unknown_coding_(false), content_length_(0) {};
+
+
+/*
+    Message length, rfc2616 section 4.4, rfc7230 section 3.3.3
+
+      -- Transfer-Encoding other than "identity" takes precedence,
+         chunked must be the last transfer-coding applied
+      -- Otherwise Content-Length gives body length in bytes
+      -- Otherwise request has no body
+
+    Caveats:
+      -- transfer-codings other than chunked are not decoded, rejected instead,
+         with unknown_coding_ set so that 501 is sent rather than 400
+      -- list is split on commas, only a single chunked coding is accepted
+*/
+auto BodyParser::frame(Request &request) -> ParseStatus
+{
+  std::string transfer_encoding = request.FindHeader("Transfer-Encoding");
+  std::transform(transfer_encoding.begin(), transfer_encoding.end(), transfer_encoding.begin(), ::tolower);
+
+  if (!transfer_encoding.empty() && transfer_encoding != "identity") {
+    std::size_t codings = 0;
+    std::size_t begin = 0;
+    while (begin <= transfer_encoding.size()) {
+      auto end = std::min(transfer_encoding.find(',', begin), transfer_encoding.size());
+      auto first = transfer_encoding.find_first_not_of(" \t", begin);
+      auto last = transfer_encoding.find_last_not_of(" \t", end - 1);
+      if (first >= end || last == std::string::npos || last < first)
+        return ParseStatus::reject;
+      if (transfer_encoding.compare(first, last + 1 - first, "chunked") != 0) {
+        unknown_coding_ = true;
+        return ParseStatus::reject;
+      }
+      ++codings;
+      begin = end + 1;
+    }
+    if (codings != 1)
+      return ParseStatus::reject;
+    framing_ = BodyFraming::chunked;
+    state_ = BodyParserState::chunk_size_start;
+    return ParseStatus::in_progress;
+  }
+
+  std::string content_length = request.FindHeader("Content-Length");
+  if (!content_length.empty()) {
+    std::size_t length = 0;
+    for (char c : content_length) {
+      if (!is_digit(c) || length > (std::numeric_limits<std::size_t>::max() - 9) / 10)
+        return ParseStatus::reject;
+      length = length * 10 + (c - '0');
+    }
+    framing_ = BodyFraming::content_length;
+    content_length_ = remaining_ = length;
+    state_ = (length == 0) ? BodyParserState::body_end : BodyParserState::body_identity;
+    return done() ? ParseStatus::accept : ParseStatus::in_progress;
+  }
+
+  framing_ = BodyFraming::none;
+  state_ = BodyParserState::body_end;
+  return ParseStatus::accept;
+}
+
+
+void BodyParser::finish_data()
+{
+  state_ = (framing_ == BodyFraming::chunked) ? BodyParserState::chunk_data_cr : BodyParserState::body_end;
+}
+
+
+auto BodyParser::consume(char c) -> ParseStatus
+{
+  using s = BodyParserState;
+  using status = ParseStatus;
+
+  switch (state_) {
+  case s::body_start:
+  case s::body_identity:
+  case s::chunk_data:
+    // frame() not called yet, or body data which is consumed in parse()
+    return status::reject;
+  case s::chunk_size_start:
+    // chunk-size = 1*HEX, an empty size line is not a last-chunk
+    if (!is_hex(c))
+      return status::reject;
+    state_ = s::chunk_size;
+    remaining_ = hex_value(c);
+    return status::in_progress;
+  case s::chunk_size:
+    if (is_hex(c)) {
+      if (remaining_ > (std::numeric_limits<std::size_t>::max() >> 4))
+        return status::reject;
+      remaining_ = (remaining_ << 4) | hex_value(c);
+      return status::in_progress;
+    }
+    if (c == ';' || is_sp(c) || is_ht(c)) {
+      state_ = s::chunk_ext;
+      return status::in_progress;
+    }
+    if (is_cr(c)) {
+      state_ = s::chunk_size_lf;
+      return status::in_progress;
+    }
+    return status::reject;
+  case s::chunk_ext:
+    // chunk extensions are ignored
+    if (is_cr(c)) {
+      state_ = s::chunk_size_lf;
+      return status::in_progress;
+    }
+    return status::in_progress;
+  case s::chunk_size_lf:
+    if (is_lf(c)) {
+      state_ = (remaining_ == 0) ? s::trailer_start : s::chunk_data;
+      return status::in_progress;
+    }
+    return status::reject;
+  case s::chunk_data_cr:
+    if (is_cr(c)) {
+      state_ = s::chunk_data_lf;
+      return status::in_progress;
+    }
+    return status::reject;
+  case s::chunk_data_lf:
+    if (is_lf(c)) {
+      state_ = s::chunk_size_start;
+      return status::in_progress;
+    }
+    return status::reject;
+  case s::trailer_start:
+    if (is_cr(c)) {
+      state_ = s::trailer_end_lf;
+      return status::in_progress;
+    }
+    // trailer headers are discarded
+    if (is_token(c)) {
+      state_ = s::trailer_field;
+      return status::in_progress;
+    }
+    return status::reject;
+  case s::trailer_field:
+    if (is_cr(c)) {
+      state_ = s::trailer_field_lf;
+      return status::in_progress;
+    }
+    return status::in_progress;
+  case s::trailer_field_lf:
+    if (is_lf(c)) {
+      state_ = s::trailer_start;
+      return status::in_progress;
+    }
+    return status::reject;
+  case s::trailer_end_lf:
+    if (is_lf(c)) {
+      state_ = s::body_end;
+      return status::accept;
+    }
+    return status::reject;
+  case s::body_end:
+    return status::accept;
+  }
+  return status::reject;
+}
+
+
+auto operator<<(std::ostream &os, BodyFraming &framing) -> std::ostream & {
+  switch (framing) {
+    case BodyFraming::none: os << "[None = "; break;
+    case BodyFraming::content_length: os << "[Content-Length = "; break;
+    case BodyFraming::chunked: os << "[Chunked = "; break;
+  }
+  return os << static_cast<int>(framing) << "]";
+}
+
+} // namespace Theros
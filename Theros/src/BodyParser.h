@@ -0,0 +1,141 @@
+#ifndef __BODYPARSER_H__
+#define __BODYPARSER_H__
+
+#include <cstddef>
+#include <iosfwd>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <algorithm>
+
+#include "Message.h"
+#include "RequestParser.h" // ParseStatus
+
+namespace Theros
+{
+
+/** How the length of a message body is determined, rfc2616 section 4.4 */
+enum class BodyFraming
+{
+    none = 1,           // no message body
+    content_length,     // body of exactly Content-Length bytes
+    chunked             // Transfer-Encoding: chunked
+};
+
+
+enum class BodyParserState {
+    body_start = 1,       // 1
+    body_identity,        // 2
+    chunk_size_start,     // 3
+    chunk_size,           // 4
+    chunk_ext,            // 5
+    chunk_size_lf,        // 6
+    chunk_data,           // 7
+    chunk_data_cr,        // 8
+    chunk_data_lf,        // 9
+    trailer_start,        // 10
+    trailer_field,        // 11
+    trailer_field_lf,     // 12
+    trailer_end_lf,       // 13
+    body_end              // 14
+};
+
+/**
+ * @brief   Incremental decoder for a request body, picks up where RequestParser
+ *          stops (i.e. right after the header terminator)
+ *
+ *          Decoded body bytes are appended to a caller supplied string, so the same
+ *          parser serves both a fully buffered body and a chunk by chunk stream
+ */
+class BodyParser
+{
+public:
+    BodyParserState state_;
+    BodyFraming framing_;
+    std::size_t remaining_;     // bytes left in current identity body or chunk
+    std::size_t decoded_;       // total decoded body bytes so far
+    bool unknown_coding_;       // frame() rejected a transfer-coding other than chunked
+public:
+    explicit BodyParser();
+    /**
+    * @brief   Determines framing from request headers
+    *          accept if request has no body,
+    *          in_progress if body is to follow,
+    *          reject if framing headers are malformed
+    */
+    auto frame(Request &request) -> ParseStatus;
+    /**
+    * @brief   Decodes a range of chars, decoded body bytes are appended to out
+    *          Returns iterator past the last consumed char,
+    *          anything after it belongs to the next message
+    */
+    template <typename In>
+    auto parse(In begin, In end, std::string &out) -> std::tuple<In, ParseStatus>;
+    /**
+    * @brief   Advance parser state given a framing char (i.e. outside of body data)
+    */
+    auto consume(char c) -> ParseStatus;
+
+    /** Length announced by Content-Length, 0 for other framings */
+    std::size_t content_length() const { return framing_ == BodyFraming::content_length ? content_length_ : 0; }
+    bool done() const { return state_ == BodyParserState::body_end; }
+private:
+    std::size_t content_length_;
+    /** Transition out of a fully consumed identity body or chunk */
+    void finish_data();
+public:
+    friend std::ostream& operator<<(std::ostream &strm, BodyFraming &framing);
+};
+
+
+/*
+    Chunked-Body   = *chunk
+                     last-chunk
+                     trailer
+                     CRLF
+
+    chunk          = chunk-size [ chunk-extension ] CRLF
+                     chunk-data CRLF
+    chunk-size     = 1*HEX
+    last-chunk     = 1*("0") [ chunk-extension ] CRLF
+
+    chunk-extension= *( ";" chunk-ext-name [ "=" chunk-ext-val ] )
+    trailer        = *(entity-header CRLF)
+*/
+
+/**
+ * @brief   Helper functions for parsers
+ */
+constexpr bool is_hex(char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+constexpr int  hex_value(char c) { return (c <= '9') ? c - '0' : (c | 0x20) - 'a' + 10; }
+
+// Template definition
+
+template <typename In>
+inline std::tuple<In, ParseStatus> BodyParser::parse(In begin, In end, std::string &out)
+{
+    ParseStatus status = done() ? ParseStatus::accept : ParseStatus::in_progress;
+    while (begin != end && status == ParseStatus::in_progress)
+    {
+        if (state_ == BodyParserState::body_identity || state_ == BodyParserState::chunk_data)
+        {
+            // copy a run of body data at once instead of char by char
+            auto n = std::min<std::size_t>(remaining_, std::distance(begin, end));
+            out.append(begin, std::next(begin, n));
+            std::advance(begin, n);
+            remaining_ -= n;
+            decoded_ += n;
+            if (remaining_ == 0)
+                finish_data();
+            status = done() ? ParseStatus::accept : ParseStatus::in_progress;
+        }
+        else
+        {
+            status = consume(*begin++);
+        }
+    }
+    return {begin, status};
+}
+
+} // namespace Theros
+#endif // __BODYPARSER_H__
@@ -0,0 +1,81 @@
+#ifndef __BODYREADER_H__
+#define __BODYREADER_H__
+
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace Theros
+{
+
+/**
+ * @brief   Pull based stream over a request body, handed to handlers on streaming routes
+ *
+ *          Connection only reads from the socket when a read is pending, so a slow
+ *          consumer throttles the client through tcp flow control instead of
+ *          having the body pile up in memory
+ *
+ *          router.post("/upload", Handler([](Context& ctx) {
+ *              auto sink = std::make_shared<std::ofstream>("upload.bin");
+ *              auto pump = std::make_shared<BodyReader::ReadHandler>();
+ *              *pump = [&ctx, sink, pump](const std::string& chunk, bool eof) {
+ *                  *sink << chunk;
+ *                  if (!eof) ctx.body.read(*pump);
+ *              };
+ *              ctx.body.read(*pump);
+ *          }).streaming());
+ */
+class BodyReader
+{
+public:
+    using ReadHandler = std::function<void(const std::string &chunk, bool eof)>;
+    using PullFunc    = std::function<void()>;
+private:
+    ReadHandler reader_;
+    PullFunc    pull_;
+    bool        eof_ = false;
+public:
+    /**
+     * @brief   Requests next decoded chunk of body,
+     *          handler is invoked exactly once, with eof set on the last chunk
+     */
+    void read(ReadHandler handler)
+    {
+        if (eof_) {
+            handler("", true);
+            return;
+        }
+        reader_ = std::move(handler);
+        if (pull_) pull_();
+    }
+
+    /** True if all of body has been delivered */
+    bool eof() const { return eof_; }
+    /** True if a read is waiting for data */
+    bool pending() const { return static_cast<bool>(reader_); }
+
+    /**
+     * @brief   Connection side, pull is called whenever consumer asks for more data
+     */
+    void on_pull(PullFunc pull) { pull_ = std::move(pull); }
+    /**
+     * @brief   Connection side, completes the pending read
+     */
+    void deliver(const std::string &chunk, bool eof)
+    {
+        eof_ = eof;
+        ReadHandler reader;
+        std::swap(reader, reader_);
+        if (reader) reader(chunk, eof);
+    }
+    /** Reset stream for next request */
+    void reset()
+    {
+        reader_ = nullptr;
+        pull_ = nullptr;
+        eof_ = false;
+    }
+};
+
+} // namespace Theros
+#endif // __BODYREADER_H__
@@ -3,7 +3,12 @@
 #include "asio/ssl.hpp"
 
 #include <vector>     // vector<pair<string, string>>    
+#include <array>
 #include <string>
+#include <algorithm>  // any_of
+#include <atomic>
+#include <variant>    // visit
+#include <cerrno>
 #include <iostream>
 
 #include "Connection.h"
@@ -16,19 +21,66 @@ using namespace std;
 namespace Theros {
 
 
+template<typename SocketType>
+void Connection<SocketType>::admit() {
+  asio::error_code ec;
+  auto endpoint = socket_.lowest_layer().remote_endpoint(ec);
+  if (!ec) peer_ = endpoint.address().to_string();
+  slot_ = admission_.open_connection(peer_);
+  recorded_ = recorder_.opened();
+}
+
+template<typename SocketType>
+void Connection<SocketType>::record_metrics() {
+  if (!routed_) return;
+  routed_ = false;
+  const auto &route = route_.empty() ? std::string(Metrics::unmatched) : route_.back().pattern();
+#ifdef _ALLOC_PROFILE_
+  AllocProfiler::instance().record(request_.method, route, allocs_);
+#endif
+  if (!metrics_.enabled() && !access_log_.enabled()) return;
+
+  auto latency = ClockType::now() - routed_at_;
+  auto status = status_code_as_int(response_.status_code);
+  if (metrics_.enabled())
+    metrics_.record(request_.method, route, status, latency, bytes_in_, bytes_out_);
+  if (access_log_.enabled()) {
+    AccessRecord record;
+    record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.latency = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+    record.bytes_in = bytes_in_;
+    record.bytes_out = bytes_out_;
+    record.status = static_cast<std::uint16_t>(status);
+    record.method = request_.method;
+    record.version = request_.version;
+    record.set_path(request_.uri.abs_path, request_.uri.query);
+    record.set_peer(peer_);
+    access_log_.log(record);
+  }
+}
+
 template<typename SocketType> 
 void Connection<SocketType>::stop(){
+  record_metrics();
+#ifdef _TRACE_
+  if (!stopped_ && trace_write_at_) TRACE_SPAN("write", context_.trace_id, trace_write_at_);
+#endif
+  if (recorded_) {
+    recorder_.closed(recorded_);
+    recorded_ = 0;
+  }
+  stopped_ = true;
   read_deadline_.cancel();
+  defer_deadline_.cancel();
 }
 
 template<typename SocketType>
-void Connection<SocketType>::terminate() {};
-
-template<>
-void Connection<TcpSocket>::terminate(){
+void Connection<SocketType>::terminate(){
   stop();
-  socket_.shutdown(asio::ip::tcp::socket::shutdown_both);
-  socket_.close();
+  asio::error_code ec;
+  socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+  socket_.close(ec);
 }
 
 template<>
@@ -42,11 +94,11 @@ void Connection<SslSocket>::terminate(){
 
 
 template<typename SocketType>
-void Connection<SocketType>::start() {}
-
-template<>
-void Connection<TcpSocket>::start() { 
-  read(); 
+void Connection<SocketType>::start() {
+  admit();
+  TRACE_INSTANT("accept", context_.trace_id);
+  TRACE_MARK(trace_at_);
+  read();
 
   read_deadline_.async_wait(
     [this, self=this->shared_from_this()]
@@ -57,10 +109,15 @@ void Connection<TcpSocket>::start() {
 
 template<>
 void Connection<SslSocket>::start(){
+  admit();
+  TRACE_INSTANT("accept", context_.trace_id);
+  TRACE_MARK(trace_at_);
 
   socket_.async_handshake(asio::ssl::stream_base::server,
     [this, self=this->shared_from_this()]
       (std::error_code ec){
+        TRACE_SPAN("tls handshake", context_.trace_id, trace_at_);
+        TRACE_MARK(trace_at_);
         if(!ec){
           read();
           read_deadline_.async_wait(
@@ -78,10 +135,21 @@ void Connection<SocketType>::send_read_timeout(){
   write();
 }
 
+template<typename SocketType>
+void Connection<SocketType>::send_stream_timeout(){
+  context_.stream.reset();
+  terminate();
+  keep_alive_.reset();
+}
+
 template<typename SocketType>
 void Connection<SocketType>::check_read_deadline(){
+  if(stopped_) return;
   if(read_deadline_.expires_at() <= ClockType::now()){
-    send_read_timeout();
+    if (keep_alive_)
+      send_stream_timeout();
+    else
+      send_read_timeout();
   } else {
     read_deadline_.async_wait(
       [this, self=this->shared_from_this()]
@@ -95,7 +163,7 @@ void Connection<SocketType>::check_read_deadline(){
 template<typename SocketType>
 void Connection<SocketType>::read() {
 
-  read_deadline_.expires_from_now(read_timeout);
+  read_deadline_.expires_from_now(options_.read_timeout);
 
   asio::async_read(
     socket_, 
@@ -106,16 +174,25 @@ void Connection<SocketType>::read() {
 
       assert(this == self.get());
       if (!ec) {
+        if (bytes_in_ == 0) {
+          TRACE_SPAN("first byte", context_.trace_id, trace_at_);
+          TRACE_MARK(trace_at_);
+        }
+        bytes_in_ += bytes_read;
+        if (recorded_) recorder_.received(recorded_, buffer_.data(), bytes_read);
         decltype(buffer_.begin()) begin;
-        ParseStatus parse_status;
+        ParseStatus parse_status = ParseStatus::in_progress;
 
-        std::tie(begin, parse_status) =
-            request_parser_.parse(request_, buffer_.begin(), buffer_.begin() + bytes_read);
+        {
+          ALLOC_PHASE(allocs_, parse);
+          std::tie(begin, parse_status) =
+              request_parser_.parse(request_, buffer_.begin(), buffer_.begin() + bytes_read);
+        }
 
         /**
         * Current buffer is fully read, branch on ParseStatus
         *    -- in_progress,
-        *        so continue do async read
+        *        so continue do async read, or send 400 past max_header_bytes
         *    -- accept,
         *        request header parsing finished
         *    -- reject,
@@ -123,23 +200,17 @@ void Connection<SocketType>::read() {
         */
         switch (parse_status) {
             case ParseStatus::in_progress: {
-              read();
+              if (bytes_in_ > options_.max_header_bytes) {
+                response_.status_code = StatusCode::Bad_Request;
+                write();
+              } else {
+                read();
+              }
               break;
             }
             case ParseStatus::accept: {
-              response_.status_code = StatusCode::OK;
-              response_.version = request_.version;
-
-              // Resolves route and populate request.uri_param 
-              std::vector<std::pair<std::string, std::string>> kv;
-              auto handlers = router_.resolve(request_, kv);
-              request_.uri_param.insert(kv.begin(), kv.end());
-
-              for (auto &handler : handlers) {
-               handler(context_);
-              }
-
-              write();
+              TRACE_SPAN("parse headers", context_.trace_id, trace_at_);
+              on_header(begin, buffer_.begin() + bytes_read);
               break;
             }
 
@@ -153,25 +224,695 @@ void Connection<SocketType>::read() {
     });
 }
 
+
+template<typename SocketType>
+void Connection<SocketType>::on_header(BufferIterator begin, BufferIterator end) {
+
+  response_.status_code = StatusCode::OK;
+  response_.version = request_.version;
+
+  // Resolves route and populate request.uri_param 
+  TRACE_MARK(trace_at_);
+  {
+    ALLOC_PHASE(allocs_, route);
+    std::vector<std::pair<std::string, std::string>> kv;
+    route_ = router_.resolve(request_, kv);
+    request_.uri_param.insert(kv.begin(), kv.end());
+  }
+  TRACE_SPAN("route", context_.trace_id, trace_at_);
+  routed_ = true;
+  routed_at_ = ClockType::now();
+
+  // too many connections from this client, or too many requests in flight, shed before any work is done
+  if (slot_.over_limit() || !(permit_ = admission_.try_acquire())) {
+    response_.status_code = StatusCode::Service_Unavailable;
+    response_.SetHeader({"Retry-After", std::to_string(admission_.retry_after().count())});
+    write();
+    return;
+  }
+
+  streaming_ = std::any_of(route_.begin(), route_.end(),
+    [](const Handler& handler) { return handler.streaming(); });
+  blocking_ = !streaming_ && std::any_of(route_.begin(), route_.end(),
+    [](const Handler& handler) { return handler.blocking(); });
+
+  context_.stream.attach(
+    [this](std::string &&chunk, ResponseStream::WriteHandler on_written) {
+      stream_write(std::move(chunk), std::move(on_written));
+    },
+    [this]() { stream_end(); });
+  context_.attach_defer(
+    [this](ClockType::duration timeout, Context::HookFunc on_timeout) {
+      return defer(timeout, std::move(on_timeout));
+    });
+
+  /**
+  * Branch on body framing
+  *    -- reject,
+  *        malformed Content-Length or Transfer-Encoding, send 400,
+  *        or 501 for a transfer-coding that is not decoded
+  *    -- buffered body larger than max_body_bytes, send 413
+  *    -- streaming,
+  *        executes handlers now, body is read as handlers pull on it
+  *    -- otherwise
+  *        read body into request_.body, then executes handlers
+  */
+  switch (body_parser_.frame(request_)) {
+    case ParseStatus::reject: {
+      response_.status_code = body_parser_.unknown_coding_ ? StatusCode::Not_Implemented : StatusCode::Bad_Request;
+      write();
+      return;
+    }
+    case ParseStatus::accept: {
+      context_.body.deliver("", true);
+      break;
+    }
+    case ParseStatus::in_progress: {
+      if (!streaming_ && body_parser_.content_length() > options_.max_body_bytes) {
+        response_.status_code = StatusCode::Request_Entity_Too_Large;
+        write();
+        return;
+      }
+      break;
+    }
+  }
+
+  if (streaming_) {
+    context_.body.on_pull([this]() { pull_body(); });
+    // stage body bytes already in buffer, delivered on first pull
+    if (!body_parser_.done())
+      parse_body(begin, end);
+    handle_request();
+    // body fully consumed while handlers ran, or handlers did not ask for (rest of) it
+    if (!context_.body.pending())
+      respond();
+    return;
+  }
+
+  if (body_parser_.done()) {
+    handle_request();
+    respond();
+  } else {
+    parse_body(begin, end);
+  }
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::read_body() {
+
+  read_deadline_.expires_from_now(options_.read_timeout);
+
+  socket_.async_read_some(
+    asio::buffer(buffer_),
+    [ this, self = this->shared_from_this() ]
+      (std::error_code ec, std::size_t bytes_read) {
+      if (!ec) {
+        bytes_in_ += bytes_read;
+        if (recorded_) recorder_.received(recorded_, buffer_.data(), bytes_read);
+        parse_body(buffer_.begin(), buffer_.begin() + bytes_read);
+      } else {
+        terminate();
+      }
+    });
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::parse_body(BufferIterator begin, BufferIterator end) {
+
+  ParseStatus parse_status = ParseStatus::in_progress;
+  std::string& out = streaming_ ? body_chunk_ : request_.body;
+  {
+    ALLOC_PHASE(allocs_, parse);
+    std::tie(begin, parse_status) = body_parser_.parse(begin, end, out);
+  }
+
+  if (parse_status == ParseStatus::reject) {
+    response_.status_code = StatusCode::Bad_Request;
+    write();
+    return;
+  }
+
+  if (streaming_) {
+    // staged bytes are handed over on next pull
+    if (context_.body.pending() && (!body_chunk_.empty() || body_parser_.done()))
+      pull_body();
+    else if (context_.body.pending())
+      read_body();
+    return;
+  }
+
+  // chunked bodies have no length up front, enforce limit as they are decoded
+  if (request_.body.size() > options_.max_body_bytes) {
+    response_.status_code = StatusCode::Request_Entity_Too_Large;
+    write();
+    return;
+  }
+
+  if (parse_status == ParseStatus::accept) {
+    handle_request();
+    respond();
+  } else {
+    read_body();
+  }
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::pull_body() {
+
+  if (body_chunk_.empty() && !body_parser_.done()) {
+    read_body();
+    return;
+  }
+
+  std::string chunk;
+  chunk.swap(body_chunk_);
+  bool eof = body_parser_.done();
+  context_.body.deliver(chunk, eof);
+
+  // last chunk consumed outside of handlers, respond
+  if (eof && !handling_) respond();
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::handle_request() {
+  // handlers of all matching mount points and route form one chain, so next() and end() reach across them
+  chain_.clear();
+  for (auto &handler : route_)
+    chain_.insert(chain_.end(), handler.functions().begin(), handler.functions().end());
+
+  if (blocking_) {
+    offload();
+    return;
+  }
+
+  handling_ = true;
+  {
+    auto watch = monitor_.watch(request_);
+    ALLOC_PHASE(allocs_, handlers);
+    context_.run(chain_);
+  }
+  handling_ = false;
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::offload() {
+
+  // request is read, nothing touches connection on io_service until handlers are done
+  read_deadline_.expires_at(ClockType::time_point::max());
+  handling_ = true;
+  offloaded_ = true;
+
+  auto self = this->shared_from_this();
+  bool queued = work_pool_.submit([this, self]() {
+    {
+      ALLOC_PHASE(allocs_, handlers);
+      context_.run(chain_);
+    }
+    io_service_.post([this, self]() {
+      handling_ = false;
+      offloaded_ = false;
+      if (resume_pending_) {
+        resume_pending_ = false;
+        resume(std::move(resumed_));
+        return;
+      }
+      respond();
+    });
+  });
+
+  if (!queued) {
+    handling_ = false;
+    offloaded_ = false;
+    response_.status_code = StatusCode::Service_Unavailable;
+    response_.SetHeader({"Retry-After", "1"});
+    write();
+  }
+}
+
+template<typename SocketType>
+void Connection<SocketType>::send_file_body() {
+  ALLOC_PHASE(allocs_, write);
+
+  auto &file = std::get<FileBody::value_type>(response_.content);
+  if (file.length == 0) {
+    terminate();
+    return;
+  }
+
+  // file is read off the io_service thread, a cold file does not stall other connections
+  file_buffer_.resize(std::min(file.length, options_.file_block_bytes));
+  file_reader_.async_read(
+    file.file, file.offset, file_buffer_.data(), file_buffer_.size(),
+    [ this, self = this->shared_from_this() ](
+        std::error_code ec, std::size_t n) {
+      if (ec || n == 0) {
+        terminate();
+        return;
+      }
+
+      auto &file = std::get<FileBody::value_type>(response_.content);
+      file.offset += n;
+      file.length -= std::min(file.length, n);
+
+      asio::async_write(
+        socket_,
+        asio::buffer(file_buffer_.data(), n),
+        [ this, self ](std::error_code ec, std::size_t bytes_written) {
+          bytes_out_ += bytes_written;
+          if (!ec) {
+            send_file_body();
+          } else {
+            terminate();
+          }
+        });
+    });
+}
+
+template<>
+void Connection<TcpSocket>::send_file_body() {
+  ALLOC_PHASE(allocs_, write);
+
+  auto &file = std::get<FileBody::value_type>(response_.content);
+  socket_.native_non_blocking(true);
+
+  while (file.length > 0) {
+    ssize_t n = send_file(socket_.native_handle(), file.file->fd(), &file.offset, file.length);
+    if (n > 0) {
+      bytes_out_ += n;
+      file.length -= n;
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // socket buffer is full, resume once it is writable again
+      socket_.async_write_some(
+        asio::null_buffers(),
+        [ this, self = this->shared_from_this() ](
+            std::error_code ec, std::size_t) {
+          if (!ec) {
+            send_file_body();
+          } else {
+            terminate();
+          }
+        });
+      return;
+    }
+    // file shrunk underneath us, or socket error
+    break;
+  }
+  terminate();
+}
+
+
 template<typename SocketType>
 void Connection<SocketType>::write() {
 
+  // response is already on its way, cannot start another one
+  if (headers_sent_) {
+    terminate();
+    return;
+  }
+  read_deadline_.expires_at(ClockType::time_point::max());
+  permit_.release();
+  TRACE_MARK(trace_write_at_);
+  ALLOC_PHASE(allocs_, serialize);
+  // serialized response is final, nothing left to hook into
+  if (!std::holds_alternative<SerializedBody::value_type>(response_.content))
+    run_headers_hooks();
+
+  std::visit([this](auto &content) { write_body(content); }, response_.content);
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::run_headers_hooks() {
+
+  // innermost first, i.e. hooks of handlers closer to route run before those of outer middlewares
+  std::vector<Context::HookFunc> hooks;
+  hooks.swap(context_.headers_hooks);
+  for (auto hook = hooks.rbegin(); hook != hooks.rend(); ++hook)
+    (*hook)(context_);
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::write_body(std::monostate) {
+
+  headers_sent_ = true;
+  payload_ = response_.ToPayload();
 
   asio::async_write(
     socket_, 
-    asio::buffer(response_.ToPayload()),
+    asio::buffer(payload_),
     asio::transfer_all(),
     [ this, self = this->shared_from_this() ](
         std::error_code ec, std::size_t bytes_written) {
+      ALLOC_PHASE(allocs_, write);
+      bytes_out_ += bytes_written;
+
+      if (!ec) {
+        terminate();
+      }
+    });
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::write_body(SharedBufferBody::value_type &buffer) {
+
+  headers_sent_ = true;
+  payload_ = response_.StatusLine() + response_.HeaderLine();
+
+  std::vector<asio::const_buffer> buffers{ asio::buffer(payload_) };
+  if (buffer) buffers.push_back(asio::buffer(*buffer));
+
+  asio::async_write(
+    socket_,
+    buffers,
+    [ this, self = this->shared_from_this(), buffer ](
+        std::error_code ec, std::size_t bytes_written) {
+      ALLOC_PHASE(allocs_, write);
+      bytes_out_ += bytes_written;
+      terminate();
+    });
+}
+
 
+template<typename SocketType>
+void Connection<SocketType>::write_body(FileBody::value_type &file) {
+
+  headers_sent_ = true;
+  payload_ = response_.StatusLine() + response_.HeaderLine();
+
+  asio::async_write(
+    socket_,
+    asio::buffer(payload_),
+    [ this, self = this->shared_from_this() ](
+        std::error_code ec, std::size_t bytes_written) {
+      ALLOC_PHASE(allocs_, write);
+      bytes_out_ += bytes_written;
       if (!ec) {
+        send_file_body();
+      } else {
         terminate();
       }
     });
 }
 
 
+template<typename SocketType>
+void Connection<SocketType>::write_body(GeneratorBody::value_type &generator) {
+
+  // reuse chunked framing and write queue of streamed responses
+  read_deadline_.expires_from_now(options_.stream_timeout);
+  keep_alive_ = this->shared_from_this();
+  send_stream_header();
+  pull_generator();
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::write_body(SerializedBody::value_type &serialized) {
+
+  headers_sent_ = true;
+  if (!serialized.payload) {
+    terminate();
+    return;
+  }
+
+  std::array<asio::const_buffer, 2> buffers = {asio::buffer(serialized.status_line), asio::buffer(*serialized.payload)};
+  asio::async_write(
+    socket_,
+    buffers,
+    [ this, self = this->shared_from_this(), payload = serialized.payload ](
+        std::error_code ec, std::size_t bytes_written) {
+      ALLOC_PHASE(allocs_, write);
+      bytes_out_ += bytes_written;
+      terminate();
+    });
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::pull_generator() {
+
+  auto &generator = std::get<GeneratorBody::value_type>(response_.content);
+
+  std::string chunk;
+  bool more = generator(chunk);
+
+  if (!more) {
+    if (!chunk.empty())
+      stream_write(std::move(chunk), nullptr);
+    stream_end();
+    return;
+  }
+
+  stream_write(std::move(chunk), [this](std::error_code ec) {
+    if (!ec) pull_generator();
+  });
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::respond() {
+
+  // sent once resumed, or once offloaded handlers are done
+  if (deferred_ || offloaded_) return;
+
+  if (!context_.stream.started()) {
+    write();
+    return;
+  }
+
+  // request is read, handlers may keep writing to stream after they return, until it idles too long
+  read_deadline_.expires_from_now(options_.stream_timeout);
+  keep_alive_ = this->shared_from_this();
+  send_stream_header();
+  flush_stream();
+}
+
+
+template<typename SocketType>
+Context::ResumeFunc Connection<SocketType>::defer(ClockType::duration timeout, Context::HookFunc on_timeout) {
+
+  deferred_ = true;
+  // lifted already, and owned by io_service thread, if handlers run on work_pool_
+  if (!offloaded_)
+    read_deadline_.expires_at(ClockType::time_point::max());
+
+  // whichever of resume and timeout comes first sends response
+  auto once = std::make_shared<std::atomic<bool>>(false);
+  auto self = this->shared_from_this();
+
+  if (timeout != ClockType::duration::max()) {
+    defer_deadline_.expires_from_now(timeout);
+    defer_deadline_.async_wait(
+      [this, self, once, on_timeout = std::move(on_timeout)](std::error_code ec) {
+        if (ec || once->exchange(true)) return;
+        resume(std::move(on_timeout));
+      });
+  }
+
+  return [this, self, once](Context::HookFunc f) {
+    if (once->exchange(true)) return;
+    io_service_.post([this, self, f = std::move(f)]() {
+      defer_deadline_.cancel();
+      resume(std::move(f));
+    });
+  };
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::resume(Context::HookFunc f) {
+
+  // handlers still running on work_pool_, picked up once they are done
+  if (offloaded_) {
+    resumed_ = std::move(f);
+    resume_pending_ = true;
+    return;
+  }
+
+  deferred_ = false;
+  // f may run handlers, which may park response again
+  if (f) {
+    handling_ = true;
+    auto watch = monitor_.watch(request_);
+    ALLOC_PHASE(allocs_, handlers);
+    f(context_);
+    handling_ = false;
+  }
+  if (!deferred_ && !stopped_)
+    respond();
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::send_stream_header() {
+
+  if (headers_sent_) return;
+  headers_sent_ = true;
+  permit_.release();
+  TRACE_MARK(trace_write_at_);
+  ALLOC_PHASE(allocs_, serialize);
+  run_headers_hooks();
+
+  chunked_ = (response_.version == HttpVersion::one_one);
+  response_.RemoveHeader("Content-Length");
+  if (chunked_)
+    response_.SetHeader({"Transfer-Encoding", "chunked"});
+  else
+    response_.SetHeader({"Connection", "close"});
+
+  write_queue_.push_back({response_.StatusLine() + response_.HeaderLine(), "", false, 0, nullptr});
+
+  // body set by handlers before streaming goes out as first chunk
+  if (!response_.body.empty()) {
+    std::string body;
+    body.swap(response_.body);
+    body = context_.stream.filtered(std::move(body), false);
+    if (!body.empty()) {
+      auto head = chunked_ ? chunk_size_line(body.size()) : "";
+      write_queue_.push_back({std::move(head), std::move(body), chunked_, 0, nullptr});
+    }
+  }
+
+  // written, or ended, while handlers were running
+  std::vector<PendingWrite> held;
+  held.swap(held_);
+  for (auto &w : held)
+    queue_chunk(std::move(w.data), std::move(w.on_written));
+  if (held_end_)
+    queue_last_chunk();
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::stream_write(std::string &&chunk, ResponseStream::WriteHandler on_written) {
+
+  // held until handlers return, so headers they set after writing are still sent
+  if (handling_ && !headers_sent_) {
+    held_.push_back({"", std::move(chunk), false, 0, std::move(on_written)});
+    return;
+  }
+  send_stream_header();
+  queue_chunk(std::move(chunk), std::move(on_written));
+  if (!handling_)
+    flush_stream();
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::stream_end() {
+
+  if (handling_ && !headers_sent_) {
+    held_end_ = true;
+    return;
+  }
+  send_stream_header();
+  queue_last_chunk();
+  if (!handling_)
+    flush_stream();
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::queue_chunk(std::string &&chunk, ResponseStream::WriteHandler on_written) {
+
+  std::size_t accounted = chunk.size();
+  chunk = context_.stream.filtered(std::move(chunk), false);
+
+  // empty chunk would read as last-chunk, only wait for queue ahead of it
+  if (chunk.empty()) {
+    write_queue_.push_back({"", "", false, accounted, std::move(on_written)});
+  } else {
+    auto head = chunked_ ? chunk_size_line(chunk.size()) : "";
+    write_queue_.push_back({std::move(head), std::move(chunk), chunked_, accounted, std::move(on_written)});
+  }
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::queue_last_chunk() {
+
+  stream_ended_ = true;
+
+  std::string rest = context_.stream.filtered("", true);
+  if (!rest.empty()) {
+    auto head = chunked_ ? chunk_size_line(rest.size()) : "";
+    write_queue_.push_back({std::move(head), std::move(rest), chunked_, 0, nullptr});
+  }
+  write_queue_.push_back({chunked_ ? LAST_CHUNK : "", "", false, 0, nullptr});
+}
+
+
+template<typename SocketType>
+void Connection<SocketType>::flush_stream() {
+
+  if (writing_ || write_queue_.empty())
+    return;
+  ALLOC_PHASE(allocs_, write);
+
+  // queued chunk or write that completed is progress, deadline starts over
+  read_deadline_.expires_from_now(options_.stream_timeout);
+  writing_ = true;
+  in_flight_.assign(std::make_move_iterator(write_queue_.begin()),
+                    std::make_move_iterator(write_queue_.end()));
+  write_queue_.clear();
+
+  std::vector<asio::const_buffer> buffers;
+  buffers.reserve(3 * in_flight_.size());
+  for (auto &w : in_flight_) {
+    if (!w.head.empty()) buffers.push_back(asio::buffer(w.head));
+    if (!w.data.empty()) buffers.push_back(asio::buffer(w.data));
+    if (w.framed) buffers.push_back(asio::buffer(CRLF, 2));
+  }
+
+  asio::async_write(
+    socket_,
+    buffers,
+    [ this, self = this->shared_from_this() ](
+        std::error_code ec, std::size_t bytes_written) {
+      ALLOC_PHASE(allocs_, write);
+      bytes_out_ += bytes_written;
+
+      writing_ = false;
+      std::vector<PendingWrite> written;
+      written.swap(in_flight_);
+
+      std::size_t body_bytes = 0;
+      for (auto &w : written) body_bytes += w.accounted;
+      context_.stream.written(body_bytes);
+
+      for (auto &w : written) {
+        if (w.on_written) w.on_written(ec);
+      }
+
+      if (ec || (stream_ended_ && write_queue_.empty())) {
+        context_.stream.reset();
+        keep_alive_.reset();
+        // timed out already
+        if (!stopped_) terminate();
+        return;
+      }
+      read_deadline_.expires_from_now(options_.stream_timeout);
+      flush_stream();
+    });
+}
+
+
+// plain streams run primary templates of start and terminate, TLS has its own,
+// rest of members are instantiated from these
+template void Connection<TcpSocket>::start();
+template void Connection<TcpSocket>::terminate();
+template void Connection<MemorySocket>::start();
+template void Connection<MemorySocket>::terminate();
 
 }
 
-#pragma clang diagnostic pop
\ No newline at end of file
+#pragma clang diagnostic pop
@@ -6,11 +6,25 @@
 #include "asio/basic_waitable_timer.hpp"
 
 #include <chrono>
+#include <deque>
+#include <memory>  // shared_ptr
 #include <utility> // enable_shared_from_this, move
+#include <vector>
 
 #include "Message.h"
 #include "RequestParser.h"
+#include "BodyParser.h"
+#include "FileReader.h"
+#include "WorkPool.h"
+#include "AdmissionControl.h"
+#include "LoopMonitor.h"
+#include "Metrics.h"
+#include "MemorySocket.h"
+#include "TrafficRecorder.h"
+#include "AccessLog.h"
+#include "AllocProfiler.h"
 #include "Router.h"
+#include "Trace.h"
 
 
 namespace Theros
@@ -23,6 +37,15 @@ using TcpSocket = asio::ip::tcp::socket;
 using SslSocket = asio::ssl::stream<asio::ip::tcp::socket>;
 using ClockType = std::chrono::steady_clock;
 
+struct ConnectionOptions {
+  std::size_t read_buffer_bytes = 4096;             // unit of socket reads
+  std::size_t max_header_bytes = 1 << 20;           // 1MB, read before headers are parsed, 400 past it
+  std::size_t max_body_bytes = 1 << 20;             // 1MB, larger bodies must be streamed
+  std::size_t file_block_bytes = 1 << 16;           // 64KB, unit of file reads when sendfile is not available
+  ClockType::duration read_timeout = std::chrono::seconds(2);   // of each read, 408 once it passes
+  ClockType::duration stream_timeout = std::chrono::seconds(30);  // streamed response makes no progress, closed once it passes
+};
+
 template <typename SocketType>
 class Connection
     : public std::enable_shared_from_this<Connection<SocketType>>
@@ -30,18 +53,39 @@ class Connection
 
 public:
   using DeadlineTimer = asio::basic_waitable_timer<ClockType>;
+  using Options = ConnectionOptions;
+  using BufferType = std::vector<char>;
+  using BufferIterator = typename BufferType::iterator;
   static constexpr auto max_time = ClockType::duration::max();
-  static constexpr auto read_timeout = std::chrono::seconds(2);
 
-  explicit Connection(asio::io_service &io_service, Router& router);
-  explicit Connection(asio::io_service &io_service, asio::ssl::context &context, Router& router);
+  explicit Connection(asio::io_service &io_service, Router& router, const Options &options = Options());
+  explicit Connection(asio::io_service &io_service, asio::ssl::context &context, Router& router,
+                      const Options &options = Options());
+  ~Connection()    // connection dropped without being stopped
+  {
+    record_metrics();
+    if (recorded_) recorder_.closed(recorded_);
+  }
 
   /**
    * @brief   Starts reading asynchronously
    *          For TLS, do handshake first
+   *          Connection counts against AdmissionControl from here on
    */
   void start();
 
+  /**
+   * @brief   Counts connection with AdmissionControl, by address of peer,
+   *          and opens it with TrafficRecorder if recording
+   */
+  void admit();
+
+  /**
+   * @brief   Counts request with Metrics, and AllocProfiler if built with it, and logs it with AccessLog,
+   *          once, if it was routed
+   */
+  void record_metrics();
+
   /**
    * @brief   Stops timer 
    */
@@ -58,12 +102,105 @@ public:
    */
   void read();
 
+  /**
+   * @brief   Called once request header is parsed, [begin, end) is the 
+   *          part of buffer following the header.
+   *          Resolves route and decides how request body is delivered
+   *            -# buffered into request_.body, up to options_.max_body_bytes
+   *            -# streamed to handlers through context_.body
+   */
+  void on_header(BufferIterator begin, BufferIterator end);
+
+  /**
+   * @brief   Read some from socket and decode as request body
+   */
+  void read_body();
+
+  /**
+   * @brief   Decodes [begin, end) as request body
+   *          Buffered, appends to request_.body and handles request when done
+   *          Streaming, stages decoded bytes and completes pending body read
+   */
+  void parse_body(BufferIterator begin, BufferIterator end);
+
+  /**
+   * @brief   Serves a read on context_.body, from staged bytes or socket
+   */
+  void pull_body();
+
+  /**
+   * @brief   Executes handlers of resolved route on context_
+   */
+  void handle_request();
+
   /**
    * @brief   Write buffer to socket 
    *          Call terminate()
    */
   void write();
 
+  /**
+   * @brief   Runs hooks registered with Context::on_headers, once
+   */
+  void run_headers_hooks();
+
+  /**
+   * @brief   Writes status line, headers and body, dispatching on type of response_.content
+   *            -# std::monostate, response_.body serialized with headers
+   *            -# SharedBufferBody, gather write of headers and shared buffer, no copy
+   *            -# FileBody, headers then file range, with sendfile(2) on plain tcp
+   *            -# GeneratorBody, headers then chunks pulled as socket drains
+   *            -# SerializedBody, payload as is, in a single write
+   */
+  void write_body(std::monostate);
+  void write_body(SharedBufferBody::value_type &buffer);
+  void write_body(FileBody::value_type &file);
+  void write_body(GeneratorBody::value_type &generator);
+  void write_body(SerializedBody::value_type &serialized);
+
+  /**
+   * @brief   Sends rest of file range of response_.content
+   *          TcpSocket, sendfile(2) and wait for writability on EAGAIN
+   *          otherwise, read file in blocks with FileReader and write to socket
+   */
+  void send_file_body();
+  /**
+   * @brief   Pulls next chunk from generator of response_.content
+   */
+  void pull_generator();
+
+  /**
+   * @brief   Sends response once handlers returned,
+   *          either whole of response_ or, if handlers started context_.stream,
+   *          headers followed by whatever chunks are queued
+   */
+  void respond();
+
+  /**
+   * @brief   Sink of context_.stream, frames chunk and queues it for writing
+   *          While handlers run and headers are not sent yet, chunks are held instead,
+   *          so headers set after a write are included once handlers return
+   */
+  void stream_write(std::string &&chunk, ResponseStream::WriteHandler on_written);
+  void stream_end();
+  /** Filters and frames chunk into write_queue_, headers must be queued already */
+  void queue_chunk(std::string &&chunk, ResponseStream::WriteHandler on_written);
+  void queue_last_chunk();
+
+  /**
+   * @brief   Queues status line and headers of a streamed response, once,
+   *          followed by chunks held while handlers were running
+   *          Uses chunked transfer encoding for HTTP/1.1,
+   *          otherwise body is delimited by closing connection
+   */
+  void send_stream_header();
+
+  /**
+   * @brief   Writes all queued chunks with a single gather write,
+   *          completion handlers of chunks are called after they are written
+   */
+  void flush_stream();
+
   /**
    * @brief   Checks deadline expiration, 
    *          If expired, terminates connection 
@@ -73,38 +210,148 @@ public:
    */
   void check_read_deadline();
   void send_read_timeout();
+  /**
+   * @brief   Cuts a streamed response short once it made no progress for options_.stream_timeout,
+   *          i.e. handlers stopped writing without end() or peer stopped reading,
+   *          releases keep_alive_ so connection is not held on to for good
+   */
+  void send_stream_timeout();
+
+  /**
+   * @brief   Parks response for Context::defer, read deadline is lifted,
+   *          response is sent once resumed or after timeout
+   */
+  Context::ResumeFunc defer(ClockType::duration timeout, Context::HookFunc on_timeout);
+  /**
+   * @brief   Runs f of a resumed or timed out defer on io_service thread, then responds,
+   *          unless f parked response again
+   */
+  void resume(Context::HookFunc f);
+
+  /**
+   * @brief   Runs chain of a blocking route on work_pool_, responds from io_service once done,
+   *          or with 503 if pool is full
+   */
+  void offload();
 
 public:
   SocketType socket_;
 
 private:
-  std::array<char, 4096> buffer_;
+  asio::io_service &io_service_;
+  Options options_;
+  BufferType buffer_;
   DeadlineTimer read_deadline_;
   Request request_;
   Response response_;
   Context context_;
   RequestParser request_parser_;
+  BodyParser body_parser_;
   Router &router_;
+  Router::RouteType route_;
+  std::vector<Context::HandleFunc> chain_;   // callables of route_, kept while handlers may be suspended
+  bool streaming_ = false;      // route consumes body through context_.body
+  bool handling_ = false;       // handlers are executing
+  bool blocking_ = false;       // route runs on work_pool_
+  bool offloaded_ = false;      // handlers are executing on work_pool_
+  bool resume_pending_ = false; // resumed while offloaded_, resumed_ runs once handlers are done
+  Context::HookFunc resumed_;
+  std::string body_chunk_;      // decoded but undelivered body bytes, when streaming
+  bool stopped_ = false;        // timer is cancelled for good
+  bool deferred_ = false;       // handlers parked response with context_.defer
+  DeadlineTimer defer_deadline_;
+
+  std::string payload_;         // serialized response_, alive until written
+  std::vector<char> file_buffer_;   // block of FileBody, when not using sendfile
+  FileReader &file_reader_;
+  WorkPool &work_pool_;
+  AdmissionControl &admission_;
+  LoopMonitor &monitor_;
+  Metrics &metrics_;
+  TrafficRecorder &recorder_;
+  AccessLog &access_log_;
+  std::string peer_;                  // address of client, empty if unknown
+  std::uint64_t recorded_ = 0;        // id of connection in recorder_, 0 if not recorded
+  bool routed_ = false;         // headers parsed and route resolved, not yet counted by metrics_
+  ClockType::time_point routed_at_;
+  std::uint64_t bytes_in_ = 0;
+  std::uint64_t bytes_out_ = 0;
+  AdmissionControl::Slot slot_;       // live while connection is
+  AdmissionControl::Permit permit_;   // request is in flight, released once response is written
+#ifdef _ALLOC_PROFILE_
+  PhaseAllocs allocs_;                // of request, by phase
+#endif
+#ifdef _TRACE_
+  std::int64_t trace_at_ = 0;         // start of phase being traced, see TRACE_* of Defines.h
+  std::int64_t trace_write_at_ = 0;   // response started being written, 0 if not yet
+#endif
+
+  struct PendingWrite {
+    std::string head;           // headers, or chunk-size line
+    std::string data;           // chunk data
+    bool framed;                // chunk data followed by CRLF
+    std::size_t accounted;      // bytes written to context_.stream, before filter
+    ResponseStream::WriteHandler on_written;
+  };
+  std::deque<PendingWrite> write_queue_;
+  std::vector<PendingWrite> in_flight_;
+  std::vector<PendingWrite> held_;  // raw chunks written before handlers returned
+  bool held_end_ = false;           // stream ended before handlers returned
+  bool headers_sent_ = false;
+  bool chunked_ = false;
+  bool writing_ = false;
+  bool stream_ended_ = false;
+  std::shared_ptr<Connection> keep_alive_;  // held while handlers may write to context_.stream, until stream_timeout
 };
 
 template <typename SocketType>
-Connection<SocketType>::Connection(asio::io_service &io_service, Router &router)
+Connection<SocketType>::Connection(asio::io_service &io_service, Router &router, const Options &options)
     : socket_(io_service),
+      io_service_(io_service),
+      options_(options),
+      buffer_(options.read_buffer_bytes),
       read_deadline_(io_service),
       context_{request_, response_},
-      router_(router)
+      router_(router),
+      defer_deadline_(io_service),
+      file_reader_(asio::use_service<FileReader>(io_service)),
+      work_pool_(asio::use_service<WorkPool>(io_service)),
+      admission_(asio::use_service<AdmissionControl>(io_service)),
+      monitor_(asio::use_service<LoopMonitor>(io_service)),
+      metrics_(asio::use_service<Metrics>(io_service)),
+      recorder_(asio::use_service<TrafficRecorder>(io_service)),
+      access_log_(asio::use_service<AccessLog>(io_service))
 {
   read_deadline_.expires_from_now(max_time);
+  context_.io_service = &io_service;
+#ifdef _TRACE_
+  context_.trace_id = Tracer::instance().next_request();
+#endif
 };
 
 template <typename SocketType>
-Connection<SocketType>::Connection(asio::io_service &io_service, asio::ssl::context &context, Router &router)
+Connection<SocketType>::Connection(asio::io_service &io_service, asio::ssl::context &context, Router &router, const Options &options)
     : socket_(io_service, context),
+      io_service_(io_service),
+      options_(options),
+      buffer_(options.read_buffer_bytes),
       read_deadline_(io_service),
       context_{request_, response_},
-      router_(router)
+      router_(router),
+      defer_deadline_(io_service),
+      file_reader_(asio::use_service<FileReader>(io_service)),
+      work_pool_(asio::use_service<WorkPool>(io_service)),
+      admission_(asio::use_service<AdmissionControl>(io_service)),
+      monitor_(asio::use_service<LoopMonitor>(io_service)),
+      metrics_(asio::use_service<Metrics>(io_service)),
+      recorder_(asio::use_service<TrafficRecorder>(io_service)),
+      access_log_(asio::use_service<AccessLog>(io_service))
 {
   read_deadline_.expires_from_now(max_time);
+  context_.io_service = &io_service;
+#ifdef _TRACE_
+  context_.trace_id = Tracer::instance().next_request();
+#endif
 };
 
 } // namespace Theros
@@ -7,6 +7,7 @@ namespace Theros
 {
 
 constexpr char CRLF[] = "\r\n";
+constexpr char LAST_CHUNK[] = "0\r\n\r\n";
 
 
 /**
@@ -0,0 +1,158 @@
+#ifndef __COROUTINE_H__
+#define __COROUTINE_H__
+
+#include "Task.h"
+
+#ifdef THEROS_COROUTINES
+
+#include "asio.hpp"
+#include "asio/basic_waitable_timer.hpp"
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "Body.h"
+#include "FileReader.h"
+#include "Router.h"
+#include "WorkPool.h"
+
+namespace Theros
+{
+
+/**
+ * Awaitables for coroutine handlers, see Task
+ *
+ *    -- resumed from io_service of ctx, i.e. on the thread running connection
+ *    -- outside of a connection, Context::io_service is null, they complete at once,
+ *       sleep_for and read_file with std::errc::not_supported, offload by running f inline
+ */
+namespace detail
+{
+
+struct SleepAwaiter {
+    using Timer = asio::basic_waitable_timer<std::chrono::steady_clock>;
+
+    asio::io_service *io_service;
+    std::chrono::steady_clock::duration duration;
+    std::shared_ptr<Timer> timer;
+    std::error_code ec;
+
+    bool await_ready() const noexcept { return !io_service; }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        timer = std::make_shared<Timer>(*io_service);
+        timer->expires_from_now(duration);
+        timer->async_wait([this, h](std::error_code e) {
+            ec = e;
+            h.resume();
+        });
+    }
+    std::error_code await_resume() const
+    {
+        return io_service ? ec : std::make_error_code(std::errc::not_supported);
+    }
+};
+
+
+struct ReadAwaiter {
+    asio::io_service *io_service;
+    std::shared_ptr<FileHandle> file;
+    off_t offset;
+    char *data;
+    std::size_t size;
+    std::error_code ec;
+    std::size_t n = 0;
+
+    bool await_ready() const noexcept { return !io_service; }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        asio::use_service<FileReader>(*io_service).async_read(file, offset, data, size,
+            [this, h](std::error_code e, std::size_t bytes_read) {
+                ec = e;
+                n = bytes_read;
+                h.resume();
+            });
+    }
+    std::pair<std::error_code, std::size_t> await_resume() const
+    {
+        if (!io_service) return {std::make_error_code(std::errc::not_supported), 0};
+        return {ec, n};
+    }
+};
+
+
+template <typename F, typename R = std::invoke_result_t<F &>>
+struct OffloadAwaiter {
+    using Result = std::conditional_t<std::is_void_v<R>, bool, R>;   // bool stands in for void
+
+    asio::io_service *io_service;
+    F f;
+    std::optional<Result> result;
+    std::exception_ptr exception;
+
+    void run()
+    {
+        try {
+            if constexpr (std::is_void_v<R>) { f(); result.emplace(true); }
+            else result.emplace(f());
+        } catch (...) {
+            exception = std::current_exception();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+        if (!io_service) {
+            run();
+            return false;
+        }
+        bool queued = asio::use_service<WorkPool>(*io_service).submit([this, h]() {
+            run();
+            io_service->post([h]() { h.resume(); });
+        });
+        if (!queued)
+            exception = std::make_exception_ptr(
+                std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again), "WorkPool full"));
+        return queued;
+    }
+    R await_resume()
+    {
+        if (exception) std::rethrow_exception(exception);
+        if constexpr (!std::is_void_v<R>) return std::move(*result);
+    }
+};
+
+} // namespace detail
+
+
+/** Resumes after duration, error if timer was cancelled */
+inline auto sleep_for(Context &ctx, std::chrono::steady_clock::duration duration)
+{
+    return detail::SleepAwaiter{ctx.io_service, duration};
+}
+
+/** Reads up to size bytes of file at offset into data with FileReader, resumes with (error, bytes read) */
+inline auto read_file(Context &ctx, std::shared_ptr<FileHandle> file, off_t offset, char *data, std::size_t size)
+{
+    return detail::ReadAwaiter{ctx.io_service, std::move(file), offset, data, size};
+}
+
+/**
+ * Runs f on WorkPool, resumes with its result back on io_service,
+ * throws std::system_error if pool is full, or what f threw
+ */
+template <typename F>
+auto offload(Context &ctx, F f)
+{
+    return detail::OffloadAwaiter<F>{ctx.io_service, std::move(f)};
+}
+
+} // namespace Theros
+
+#endif // THEROS_COROUTINES
+#endif // __COROUTINE_H__
@@ -25,6 +25,35 @@ using JsonType = nlohmann::json;
 #endif
 
 
+// Request phase spans, recorded by Tracer (Trace.h), nothing is left of them without _TRACE_
+//      TRACE_MARK(t)                  stores current time in t
+//      TRACE_SPAN(name, id, since)    records span name of request id, from since to now
+//      TRACE_SCOPE(name, id, arg)     records span name of request id over rest of scope
+//      TRACE_INSTANT(name, id)        records event name of request id, at current time
+#ifdef _TRACE_
+    #define TRACE_MARK(t) ((t) = ::Theros::Tracer::now())
+    #define TRACE_SPAN(name, id, since) ::Theros::Tracer::instance().record((name), (id), (since), ::Theros::Tracer::now())
+    #define TRACE_SCOPE(name, id, arg) ::Theros::TraceScope trace_scope_((name), (id), (arg))
+    #define TRACE_INSTANT(name, id) ::Theros::Tracer::instance().instant((name), (id))
+#else
+    #define TRACE_MARK(t) __DO_NOTHING__
+    #define TRACE_SPAN(name, id, since) __DO_NOTHING__
+    #define TRACE_SCOPE(name, id, arg) __DO_NOTHING__
+    #define TRACE_INSTANT(name, id) __DO_NOTHING__
+#endif
+
+
+// Heap allocations of calling thread are counted towards phase of allocs (PhaseAllocs of AllocProfiler.h)
+// over rest of scope, innermost one wins, nothing is left of it without _ALLOC_PROFILE_
+//      ALLOC_PHASE(allocs, phase)     e.g. ALLOC_PHASE(allocs_, parse)
+#ifdef _ALLOC_PROFILE_
+    #define ALLOC_PHASE(allocs, phase) \
+        ::Theros::AllocScope alloc_scope_((allocs)[static_cast<std::size_t>(::Theros::AllocPhase::phase)])
+#else
+    #define ALLOC_PHASE(allocs, phase) __DO_NOTHING__
+#endif
+
+
 #ifdef _DEBUG_
     #define ASSERT(expr) do { if(expr) { __FORMAT__(## format) }  } while(0) 
 #else
@@ -0,0 +1,408 @@
+#include <unistd.h>         // pread, close
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>          // memset
+
+#include "FileReader.h"
+
+#ifdef THEROS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace Theros
+{
+
+asio::io_service::id FileReader::id;
+
+
+#ifdef THEROS_IO_URING
+
+/**
+ * @brief   Submission and completion rings shared with kernel,
+ *          set up with raw system calls, so liburing is not needed
+ */
+struct FileReader::Ring {
+    int fd = -1;
+    io_uring_params params;
+
+    void *sq_ptr = MAP_FAILED;
+    void *cq_ptr = MAP_FAILED;
+    std::size_t sq_bytes = 0, cq_bytes = 0, sqes_bytes = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+
+    bool setup(unsigned entries)
+    {
+        std::memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+
+        sq_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) sq_bytes = cq_bytes = std::max(sq_bytes, cq_bytes);
+
+        sq_ptr = ::mmap(nullptr, sq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) return false;
+        cq_ptr = single_mmap ? sq_ptr :
+            ::mmap(nullptr, cq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) return false;
+
+        sqes_bytes = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe *>(
+            ::mmap(nullptr, sqes_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) return false;
+
+        auto sq = static_cast<char *>(sq_ptr);
+        sq_head  = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sq_tail  = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask  = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+        auto cq = static_cast<char *>(cq_ptr);
+        cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes    = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete = 0, unsigned flags = 0)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    ~Ring()
+    {
+        if (sqes != MAP_FAILED) ::munmap(sqes, sqes_bytes);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) ::munmap(cq_ptr, cq_bytes);
+        if (sq_ptr != MAP_FAILED) ::munmap(sq_ptr, sq_bytes);
+        if (fd >= 0) ::close(fd);
+    }
+};
+
+#endif
+
+
+FileReader::FileReader(asio::io_service &io_service)
+    : asio::io_service::service(io_service),
+      io_service_(io_service),
+      backend_(FileIoBackend::thread_pool)
+#ifdef THEROS_IO_URING
+      , eventfd_(io_service)
+#endif
+{
+#ifdef THEROS_IO_URING
+    if (setup_ring())
+        backend_ = FileIoBackend::io_uring;
+#endif
+}
+
+
+FileReader::~FileReader()
+{
+    shutdown_service();
+}
+
+
+bool FileReader::use_backend(FileIoBackend backend)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_) return backend == backend_;
+
+#ifdef THEROS_IO_URING
+    if (backend == FileIoBackend::io_uring && !ring_ && !setup_ring())
+        return false;
+    if (backend == FileIoBackend::thread_pool && ring_) {
+        asio::error_code ec;
+        eventfd_.close(ec);
+        ring_.reset();
+    }
+#else
+    if (backend == FileIoBackend::io_uring)
+        return false;
+#endif
+
+    backend_ = backend;
+    return true;
+}
+
+
+void FileReader::shutdown_service()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_) return;
+        stopped_ = true;
+    }
+    ready_.notify_all();
+    for (auto &thread : threads_)
+        thread.join();
+    threads_.clear();
+    queue_.clear();
+
+#ifdef THEROS_IO_URING
+    if (ring_) drain();
+    asio::error_code ec;
+    eventfd_.close(ec);
+    ring_.reset();
+    pending_.clear();
+#endif
+    work_.reset();
+}
+
+
+void FileReader::async_read(std::shared_ptr<FileHandle> file, off_t offset, char *data, std::size_t size, ReadHandler handler)
+{
+    auto op = std::make_unique<ReadOp>();
+    op->file = std::move(file);
+    op->offset = offset;
+    op->data = data;
+    op->size = size;
+    op->handler = std::move(handler);
+    op->iov.iov_base = data;
+    op->iov.iov_len = size;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopped_) return;
+    started_ = true;
+    if (outstanding_++ == 0)
+        work_ = std::make_unique<asio::io_service::work>(io_service_);
+
+#ifdef THEROS_IO_URING
+    if (backend_ == FileIoBackend::io_uring) {
+        pending_.push_back(std::move(op));
+        // batch reads issued before the event loop gets back to us into one submission
+        if (!submit_posted_) {
+            submit_posted_ = true;
+            io_service_.post([this]() { submit(); });
+        }
+        return;
+    }
+#endif
+
+    if (threads_.empty()) {
+        for (unsigned i = 0; i < pool_threads; ++i)
+            threads_.emplace_back([this]() { run_worker(); });
+    }
+    queue_.push_back(std::move(op));
+    lock.unlock();
+    ready_.notify_one();
+}
+
+
+void FileReader::complete(std::unique_ptr<ReadOp> op, std::error_code ec, std::size_t n)
+{
+    io_service_.post([this, handler = std::move(op->handler), ec, n]() {
+        handler(ec, n);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--outstanding_ == 0)
+            work_.reset();
+    });
+}
+
+
+void FileReader::run_worker()
+{
+    while (true) {
+        std::unique_ptr<ReadOp> op;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this]() { return stopped_ || !queue_.empty(); });
+            if (stopped_) return;
+            op = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        ssize_t n;
+        do {
+            n = ::pread(op->file->fd(), op->data, op->size, op->offset);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0)
+            complete(std::move(op), std::error_code(errno, std::generic_category()), 0);
+        else
+            complete(std::move(op), std::error_code(), static_cast<std::size_t>(n));
+    }
+}
+
+
+#ifdef THEROS_IO_URING
+
+bool FileReader::setup_ring()
+{
+    auto ring = std::make_unique<Ring>();
+    if (!ring->setup(ring_entries))
+        return false;
+
+    int efd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (efd < 0)
+        return false;
+    if (::syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_EVENTFD, &efd, 1) < 0) {
+        ::close(efd);
+        return false;
+    }
+
+    eventfd_.assign(efd);
+    ring_ = std::move(ring);
+    return true;
+}
+
+
+void FileReader::submit()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    submit_posted_ = false;
+    if (stopped_) return;
+
+    Ring &ring = *ring_;
+    unsigned tail = *ring.sq_tail;
+    unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+
+    // completion queue is twice as large, bound in flight reads by it so completions are never dropped
+    while (!pending_.empty() && tail - head < ring.params.sq_entries && in_flight_.size() < ring.params.cq_entries) {
+        std::unique_ptr<ReadOp> op = std::move(pending_.front());
+        pending_.pop_front();
+
+        unsigned index = tail & *ring.sq_mask;
+        io_uring_sqe &sqe = ring.sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = op->file->fd();
+        sqe.off = static_cast<std::uint64_t>(op->offset);
+        sqe.addr = reinterpret_cast<std::uint64_t>(&op->iov);
+        sqe.len = 1;
+        sqe.user_data = reinterpret_cast<std::uint64_t>(op.get());
+        ring.sq_array[index] = index;
+        ++tail;
+
+        ReadOp *key = op.get();
+        in_flight_.emplace(key, std::move(op));
+    }
+    __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+
+    unsigned to_submit = tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+    if (to_submit > 0 && ring.enter(to_submit) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        // ring is unusable, fail reads in submission queue
+        std::vector<std::unique_ptr<ReadOp>> failed;
+        for (unsigned i = tail - to_submit; i != tail; ++i) {
+            auto found = in_flight_.find(reinterpret_cast<ReadOp *>(ring.sqes[ring.sq_array[i & *ring.sq_mask]].user_data));
+            if (found == in_flight_.end()) continue;
+            failed.push_back(std::move(found->second));
+            in_flight_.erase(found);
+        }
+        std::error_code ec(errno, std::generic_category());
+        for (auto &op : failed)
+            complete(std::move(op), ec, 0);
+    }
+
+    // retry what did not fit once completions free up room
+    if (!pending_.empty() && in_flight_.empty() && !submit_posted_) {
+        submit_posted_ = true;
+        io_service_.post([this]() { submit(); });
+    }
+    wait_completions();
+}
+
+
+void FileReader::wait_completions()
+{
+    if (waiting_ || in_flight_.empty()) return;
+    waiting_ = true;
+
+    eventfd_.async_read_some(
+        asio::buffer(&eventfd_value_, sizeof(eventfd_value_)),
+        [this](std::error_code ec, std::size_t) {
+            if (ec) return;     // cancelled on shutdown
+            reap();
+        });
+}
+
+
+void FileReader::drain()
+{
+    // kernel writes into buffers of reads in flight until they complete,
+    // so ring and ops are only released once every one of them has a completion
+    std::lock_guard<std::mutex> lock(mutex_);
+    Ring &ring = *ring_;
+
+    unsigned tail = *ring.sq_tail;
+    for (auto &entry : in_flight_) {
+        // reads that get no cancel, e.g. submission queue is full, are waited for all the same
+        if (tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) >= ring.params.sq_entries) break;
+        unsigned index = tail & *ring.sq_mask;
+        io_uring_sqe &sqe = ring.sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.fd = -1;
+        sqe.addr = reinterpret_cast<std::uint64_t>(entry.first);
+        sqe.user_data = 0;
+        ring.sq_array[index] = index;
+        ++tail;
+    }
+    __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+    unsigned to_submit = tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+
+    while (true) {
+        unsigned head = *ring.cq_head;
+        unsigned cq_tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        // handlers are dropped, as with reads not yet submitted
+        for (; head != cq_tail; ++head)
+            in_flight_.erase(reinterpret_cast<ReadOp *>(ring.cqes[head & *ring.cq_mask].user_data));
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+        if (in_flight_.empty()) break;
+
+        int submitted = ring.enter(to_submit, 1, IORING_ENTER_GETEVENTS);
+        if (submitted < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            // ring is unusable, closing it cancels what is left, ops are leaked rather than freed under kernel
+            for (auto &entry : in_flight_) entry.second.release();
+            in_flight_.clear();
+            break;
+        }
+        if (submitted > 0) to_submit -= std::min<unsigned>(to_submit, submitted);
+    }
+}
+
+
+void FileReader::reap()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiting_ = false;
+    if (stopped_) return;
+
+    Ring &ring = *ring_;
+    unsigned head = *ring.cq_head;
+    unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head) {
+        io_uring_cqe &cqe = ring.cqes[head & *ring.cq_mask];
+        auto found = in_flight_.find(reinterpret_cast<ReadOp *>(cqe.user_data));
+        if (found == in_flight_.end()) continue;
+
+        std::unique_ptr<ReadOp> op = std::move(found->second);
+        in_flight_.erase(found);
+        if (cqe.res < 0)
+            complete(std::move(op), std::error_code(-cqe.res, std::generic_category()), 0);
+        else
+            complete(std::move(op), std::error_code(), static_cast<std::size_t>(cqe.res));
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+    if (!pending_.empty() && !submit_posted_) {
+        submit_posted_ = true;
+        io_service_.post([this]() { submit(); });
+    }
+    wait_completions();
+}
+
+#endif
+
+} // namespace Theros
@@ -0,0 +1,135 @@
+#ifndef __FILEREADER_H__
+#define __FILEREADER_H__
+
+#include "asio.hpp"
+
+#include <sys/types.h>
+#include <sys/uio.h>    // iovec
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Body.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && !defined(THEROS_NO_IO_URING)
+#define THEROS_IO_URING 1
+#endif
+#endif
+
+namespace Theros
+{
+
+enum class FileIoBackend {
+    io_uring = 1,       // reads submitted to a ring, completions signalled on an eventfd
+    thread_pool,        // blocking pread on worker threads
+};
+
+
+/**
+ * @brief   Asynchronous file reads that never block the io_service thread,
+ *          an io_service service, one per io_service
+ *
+ *          auto &reader = asio::use_service<FileReader>(io_service);
+ *          reader.async_read(file, offset, data, size, [](std::error_code ec, std::size_t n) { ... });
+ *
+ *          -- io_uring, if kernel supports it,
+ *              reads requested within one run of the event loop are submitted
+ *              with a single io_uring_enter(2), completions are reaped when
+ *              eventfd registered with the ring turns readable
+ *          -- otherwise, a pool of threads doing pread(2)
+ *
+ *          Handlers are always invoked from io_service, never inline,
+ *          with the number of bytes read, 0 at end of file
+ *
+ * @note    data must stay valid until handler is called, file is kept alive by reader
+ */
+class FileReader : public asio::io_service::service
+{
+public:
+    using ReadHandler = std::function<void(std::error_code, std::size_t)>;
+
+    static constexpr unsigned ring_entries = 256;
+    static constexpr unsigned pool_threads = 2;
+
+    static asio::io_service::id id;
+
+    explicit FileReader(asio::io_service &io_service);
+    ~FileReader();
+
+    /**
+     * @brief   Reads up to size bytes of file at offset into data
+     */
+    void async_read(std::shared_ptr<FileHandle> file, off_t offset, char *data, std::size_t size, ReadHandler handler);
+
+    /**
+     * @brief   Switches backend, only before first read
+     *          Returns false if backend is not available, backend is unchanged
+     */
+    bool use_backend(FileIoBackend backend);
+    FileIoBackend backend() const { return backend_; }
+
+    /**
+     * @brief   Stops worker threads and releases ring, pending reads are dropped,
+     *          blocks until reads submitted to ring are cancelled or complete
+     */
+    void shutdown_service();
+    void shutdown() { shutdown_service(); }
+
+private:
+    struct ReadOp {
+        std::shared_ptr<FileHandle> file;
+        off_t offset;
+        char *data;
+        std::size_t size;
+        ReadHandler handler;
+        struct iovec iov;
+    };
+
+    asio::io_service &io_service_;
+    FileIoBackend backend_;
+    bool started_ = false;              // a read was issued, backend is fixed
+    bool stopped_ = false;
+    std::mutex mutex_;
+
+    // keeps io_service::run() from returning while reads are outstanding
+    std::size_t outstanding_ = 0;
+    std::unique_ptr<asio::io_service::work> work_;
+
+    void complete(std::unique_ptr<ReadOp> op, std::error_code ec, std::size_t n);
+
+    // thread pool
+    std::condition_variable ready_;
+    std::deque<std::unique_ptr<ReadOp>> queue_;
+    std::vector<std::thread> threads_;
+
+    void run_worker();
+
+#ifdef THEROS_IO_URING
+    struct Ring;
+    std::unique_ptr<Ring> ring_;
+    asio::posix::stream_descriptor eventfd_;
+    std::uint64_t eventfd_value_;
+    std::deque<std::unique_ptr<ReadOp>> pending_;   // not yet submitted
+    std::unordered_map<ReadOp *, std::unique_ptr<ReadOp>> in_flight_;   // submitted, by user_data
+    bool submit_posted_ = false;
+    bool waiting_ = false;                          // eventfd read is outstanding
+
+    bool setup_ring();
+    void submit();
+    void wait_completions();
+    void reap();
+    void drain();
+#endif
+};
+
+} // namespace Theros
+#endif // __FILEREADER_H__
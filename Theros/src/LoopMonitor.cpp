@@ -0,0 +1,150 @@
+#include <cstdio>
+#include <vector>
+
+#include "LoopMonitor.h"
+
+namespace Theros
+{
+
+asio::io_service::id LoopMonitor::id;
+
+
+LoopMonitor::LoopMonitor(asio::io_service &io_service)
+    : asio::io_service::service(io_service), io_service_(io_service)
+{
+}
+
+
+LoopMonitor::~LoopMonitor()
+{
+  shutdown_service();
+}
+
+
+bool LoopMonitor::configure(const Options &options)
+{
+  std::lock_guard<std::mutex> lock(start_mutex_);
+  if (started_) return false;
+  options_ = options;
+  return true;
+}
+
+
+void LoopMonitor::start()
+{
+  std::lock_guard<std::mutex> lock(start_mutex_);
+  if (started_) return;
+  started_ = true;
+
+  timer_ = std::make_unique<Timer>(io_service_);
+  due_ = Clock::now() + options_.interval;
+  timer_->expires_at(due_);
+  timer_->async_wait([this](std::error_code ec) { if (!ec) probe(); });
+
+  if (options_.slow_handler != Clock::duration::zero())
+    watchdog_ = std::thread([this]() { run_watchdog(); });
+}
+
+
+void LoopMonitor::probe()
+{
+  auto now = Clock::now();
+  lag_.observe(std::chrono::duration<double>(now - due_).count());
+
+  // next deadline counts from now, a long stall shows up as one late probe, not a burst of them
+  due_ = now + options_.interval;
+  timer_->expires_at(due_);
+  timer_->async_wait([this](std::error_code ec) { if (!ec) probe(); });
+}
+
+
+auto LoopMonitor::watch(const Request &req) -> Scope
+{
+  Scope scope;
+  if (!started_ || options_.slow_handler == Clock::duration::zero()) return scope;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  scope.monitor_ = this;
+  scope.id_ = ++next_id_;
+  running_.emplace(scope.id_, Running{request_method_as_string(req.method), req.uri.abs_path, Clock::now(), false});
+  return scope;
+}
+
+
+void LoopMonitor::leave(std::uint64_t id)
+{
+  Running running;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = running_.find(id);
+    if (it == running_.end()) return;
+    running = std::move(it->second);
+    running_.erase(it);
+  }
+
+  auto elapsed = Clock::now() - running.started_at;
+  if (elapsed < options_.slow_handler) return;
+  ++slow_handlers_;
+  report({std::move(running.method), std::move(running.path), elapsed, false});
+}
+
+
+void LoopMonitor::run_watchdog()
+{
+  // checks twice per threshold, a handler is reported at most half a threshold late
+  auto period = options_.slow_handler / 2;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopped_) {
+    wake_.wait_for(lock, period);
+    if (stopped_) break;
+
+    auto now = Clock::now();
+    std::vector<SlowHandler> stuck;
+    for (auto &entry : running_) {
+      auto &running = entry.second;
+      if (running.reported || now - running.started_at < options_.slow_handler) continue;
+      running.reported = true;
+      stuck.push_back({running.method, running.path, now - running.started_at, true});
+    }
+
+    lock.unlock();
+    for (auto &slow : stuck)
+      report(slow);
+    lock.lock();
+  }
+}
+
+
+void LoopMonitor::report(const SlowHandler &slow)
+{
+  if (options_.on_slow) {
+    options_.on_slow(slow);
+    return;
+  }
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(slow.elapsed).count();
+  fprintf(stderr, "slow handler: %s %s %s %lldms\n", slow.method.c_str(), slow.path.c_str(),
+          slow.running ? "running for" : "took", static_cast<long long>(ms));
+}
+
+
+void LoopMonitor::shutdown_service()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped_) return;
+    stopped_ = true;
+  }
+  wake_.notify_all();
+  if (watchdog_.joinable())
+    watchdog_.join();
+  timer_.reset();
+}
+
+
+LoopMonitor::Scope::~Scope()
+{
+  if (monitor_) monitor_->leave(id_);
+}
+
+} // namespace Theros
@@ -0,0 +1,131 @@
+#ifndef __LOOPMONITOR_H__
+#define __LOOPMONITOR_H__
+
+#include "asio.hpp"
+#include "asio/basic_waitable_timer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "Histogram.h"
+#include "Message.h"
+
+namespace Theros
+{
+
+/** A handler that ran on io_service thread for longer than LoopMonitorOptions::slow_handler */
+struct SlowHandler {
+    std::string method;
+    std::string path;
+    std::chrono::steady_clock::duration elapsed;
+    bool running;       // reported by watchdog while handler still blocks loop, reported again once it returns
+};
+
+struct LoopMonitorOptions {
+    using SlowHandlerFunc = std::function<void(const SlowHandler &)>;
+
+    std::chrono::steady_clock::duration interval = std::chrono::milliseconds(100);     // between lag probes
+    std::chrono::steady_clock::duration slow_handler = std::chrono::milliseconds(50);  // zero disables watchdog
+    SlowHandlerFunc on_slow;    // called on loop thread once handler returns, or on watchdog thread while running,
+                                // prints to stderr if empty
+};
+
+/**
+ * @brief   Measures how late io_service gets to work, and reports handlers that hold it up,
+ *          an io_service service, one per io_service
+ *
+ *          auto &monitor = asio::use_service<LoopMonitor>(io_service);
+ *          monitor.configure(options);     // optional, before start
+ *          monitor.start();
+ *
+ *          -- a timer due every interval records how long after its deadline it ran into lag(),
+ *             with io_service run by one thread, as by Server, that is scheduling lag of that thread
+ *          -- Connection runs handlers inside watch(), those still running after slow_handler are
+ *             reported by a watchdog thread, and again with their total time once they return.
+ *             Handlers of blocking routes run on WorkPool, and are not watched
+ */
+class LoopMonitor : public asio::io_service::service
+{
+public:
+  using Options = LoopMonitorOptions;
+  using Clock = std::chrono::steady_clock;
+  using Timer = asio::basic_waitable_timer<Clock>;
+
+  /** Handler running on loop thread, until destroyed */
+  class Scope
+  {
+  public:
+    Scope() = default;
+    Scope(Scope &&other) noexcept : monitor_(other.monitor_), id_(other.id_) { other.monitor_ = nullptr; }
+    Scope &operator=(Scope &&) = delete;
+    ~Scope();
+  private:
+    friend class LoopMonitor;
+    LoopMonitor *monitor_ = nullptr;
+    std::uint64_t id_ = 0;
+  };
+
+  static asio::io_service::id id;
+
+  explicit LoopMonitor(asio::io_service &io_service);
+  ~LoopMonitor();
+
+  /** Replaces options, only before start, returns false afterwards */
+  bool configure(const Options &options);
+
+  /** Starts lag probes and watchdog, once */
+  void start();
+  bool started() const { return started_; }
+
+  /** Watches a handler serving req, inert until started */
+  Scope watch(const Request &req);
+
+  /** Scheduling lag in seconds */
+  const Histogram &lag() const { return lag_; }
+  /** Handlers that returned after more than slow_handler */
+  std::uint64_t slow_handlers() const { return slow_handlers_; }
+
+  void shutdown_service();
+
+private:
+  struct Running {
+    std::string method;
+    std::string path;
+    Clock::time_point started_at;
+    bool reported;
+  };
+
+  asio::io_service &io_service_;
+  Options options_;
+  std::atomic<bool> started_{false};
+  std::mutex start_mutex_;
+
+  Histogram lag_;
+  std::unique_ptr<Timer> timer_;
+  Clock::time_point due_;
+
+  std::mutex mutex_;
+  std::unordered_map<std::uint64_t, Running> running_;
+  std::uint64_t next_id_ = 0;
+  std::atomic<std::uint64_t> slow_handlers_{0};
+
+  std::thread watchdog_;
+  std::condition_variable wake_;
+  bool stopped_ = false;
+
+  void probe();
+  void run_watchdog();
+  void leave(std::uint64_t id);
+  void report(const SlowHandler &slow);
+};
+
+} // namespace Theros
+#endif // __LOOPMONITOR_H__
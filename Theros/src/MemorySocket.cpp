@@ -0,0 +1,76 @@
+#include "MemorySocket.h"
+
+namespace Theros
+{
+
+void MemorySocket::Channel::notify()
+{
+  if (!parked) return;
+  auto read = std::move(parked);
+  parked = nullptr;
+  if (!read(false))
+    parked = std::move(read);
+}
+
+
+void MemorySocket::Channel::abort()
+{
+  if (!parked) return;
+  auto read = std::move(parked);
+  parked = nullptr;
+  read(true);
+}
+
+
+void MemorySocket::connect(MemorySocket &peer)
+{
+  auto a = std::make_shared<Channel>();
+  auto b = std::make_shared<Channel>();
+  in_ = a;
+  out_ = b;
+  peer.in_ = b;
+  peer.out_ = a;
+  closed_ = peer.closed_ = false;
+}
+
+
+asio::ip::tcp::endpoint MemorySocket::remote_endpoint(asio::error_code &ec) const
+{
+  if (!is_open()) {
+    ec = asio::error::not_connected;
+    return {};
+  }
+  ec = asio::error_code();
+  return asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0);
+}
+
+
+void MemorySocket::shutdown(asio::ip::tcp::socket::shutdown_type what, asio::error_code &ec)
+{
+  if (!is_open()) {
+    ec = asio::error::not_connected;
+    return;
+  }
+  ec = asio::error_code();
+  if (what != asio::ip::tcp::socket::shutdown_receive) {
+    out_->eof = true;
+    out_->notify();
+  }
+  if (what != asio::ip::tcp::socket::shutdown_send)
+    in_->broken = true;
+}
+
+
+void MemorySocket::close(asio::error_code &ec)
+{
+  ec = asio::error_code();
+  if (!in_ || closed_) return;
+  closed_ = true;
+
+  in_->broken = true;
+  in_->abort();
+  out_->eof = true;
+  out_->notify();
+}
+
+} // namespace Theros
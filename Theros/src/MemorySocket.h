@@ -0,0 +1,153 @@
+#ifndef __MEMORY_SOCKET_H__
+#define __MEMORY_SOCKET_H__
+
+#include "asio.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace Theros
+{
+
+/**
+ * @brief   One end of an in-memory duplex byte stream, in place of TcpSocket without the kernel,
+ *          for benchmarking and fuzzing Connection, parser, router and handlers together
+ *
+ *          auto conn = std::make_shared<Connection<MemorySocket>>(io_service, router);
+ *          MemorySocket client(io_service);
+ *          client.connect(conn->socket_);
+ *          conn->start();
+ *          asio::async_write(client, asio::buffer(request), ...);
+ *
+ *          -- async_read_some and async_write_some, as asio::async_read and asio::async_write expect,
+ *             handlers always run from io_service, never inline
+ *          -- writes never block, bytes are buffered until peer reads them
+ *          -- closing or shutting down sending gives peer eof once it read what was buffered,
+ *             writes to a closed end fail with broken_pipe
+ *          -- both ends are used from one thread at a time, as Connection does with io_service
+ */
+class MemorySocket
+{
+public:
+  using lowest_layer_type = MemorySocket;
+
+  explicit MemorySocket(asio::io_service &io_service) : io_service_(io_service) {}
+  ~MemorySocket() { close(); }
+  MemorySocket(const MemorySocket &) = delete;
+  MemorySocket &operator=(const MemorySocket &) = delete;
+
+  /** Pairs this end with peer, bytes written to one are read from the other */
+  void connect(MemorySocket &peer);
+
+  MemorySocket &lowest_layer() { return *this; }
+  asio::io_service &get_io_service() { return io_service_; }
+#if defined(ASIO_VERSION) && ASIO_VERSION >= 101100
+  // composed operations of later asio look up executor of stream
+  using executor_type = asio::io_service::executor_type;
+  executor_type get_executor() { return io_service_.get_executor(); }
+#endif
+
+  bool is_open() const { return in_ && !closed_; }
+  /** Loopback, there is no address behind an in-memory peer */
+  asio::ip::tcp::endpoint remote_endpoint(asio::error_code &ec) const;
+
+  void shutdown(asio::ip::tcp::socket::shutdown_type what, asio::error_code &ec);
+  void close(asio::error_code &ec);
+  void close() { asio::error_code ec; close(ec); }
+
+  // handlers are taken by reference, as by sockets of asio, composed operations pass themselves
+  // as handler and buffers prepared from their own state in one call
+  template <typename MutableBufferSequence, typename ReadHandler>
+  void async_read_some(const MutableBufferSequence &buffers, ReadHandler &&handler);
+
+  template <typename ConstBufferSequence, typename WriteHandler>
+  void async_write_some(const ConstBufferSequence &buffers, WriteHandler &&handler);
+
+private:
+  // bytes flowing one way
+  struct Channel {
+    std::string bytes;
+    std::size_t offset = 0;         // read so far
+    bool eof = false;               // writing end is closed
+    bool broken = false;            // reading end is closed, writes fail
+    std::function<bool(bool aborted)> parked;   // read waiting for bytes, returns false to stay parked
+
+    void notify();
+    void abort();
+  };
+
+  asio::io_service &io_service_;
+  std::shared_ptr<Channel> in_;
+  std::shared_ptr<Channel> out_;
+  bool closed_ = false;
+
+  template <typename Handler>
+  void complete(Handler &&handler, asio::error_code ec, std::size_t n)
+  {
+    io_service_.post([handler = std::forward<Handler>(handler), ec, n]() mutable { handler(ec, n); });
+  }
+};
+
+
+template <typename MutableBufferSequence, typename ReadHandler>
+void MemorySocket::async_read_some(const MutableBufferSequence &buffers, ReadHandler &&handler)
+{
+  if (!is_open()) {
+    complete(handler, asio::error::not_connected, 0);
+    return;
+  }
+  if (asio::buffer_size(buffers) == 0) {
+    complete(handler, asio::error_code(), 0);
+    return;
+  }
+
+  auto in = in_;
+  auto read = [this, in, buffers, handler = std::decay_t<ReadHandler>(std::forward<ReadHandler>(handler))](bool aborted) mutable {
+    if (aborted) {
+      complete(handler, asio::error::operation_aborted, 0);
+      return true;
+    }
+    if (in->offset < in->bytes.size()) {
+      auto n = asio::buffer_copy(buffers, asio::buffer(&in->bytes[in->offset], in->bytes.size() - in->offset));
+      in->offset += n;
+      // drop what was read once it outweighs what is left
+      if (in->offset * 2 >= in->bytes.size()) {
+        in->bytes.erase(0, in->offset);
+        in->offset = 0;
+      }
+      complete(handler, asio::error_code(), n);
+      return true;
+    }
+    if (in->eof) {
+      complete(handler, asio::error::eof, 0);
+      return true;
+    }
+    return false;
+  };
+
+  if (!read(false))
+    in->parked = std::move(read);
+}
+
+
+template <typename ConstBufferSequence, typename WriteHandler>
+void MemorySocket::async_write_some(const ConstBufferSequence &buffers, WriteHandler &&handler)
+{
+  if (!is_open() || out_->eof || out_->broken) {
+    complete(handler, asio::error::broken_pipe, 0);
+    return;
+  }
+
+  auto size = asio::buffer_size(buffers);
+  auto at = out_->bytes.size();
+  out_->bytes.resize(at + size);
+  asio::buffer_copy(asio::buffer(&out_->bytes[at], size), buffers);
+  complete(std::forward<WriteHandler>(handler), asio::error_code(), size);
+  out_->notify();
+}
+
+} // namespace Theros
+#endif // __MEMORY_SOCKET_H__
@@ -101,6 +101,17 @@ std::ostream& operator<<(std::ostream& os, const Response& res) {
   return os << s;
 }
 
+std::string chunk_size_line(std::size_t size)
+{
+  static constexpr char hex_digits[] = "0123456789abcdef";
+  std::string s;
+  do {
+    s.insert(s.begin(), hex_digits[size & 0xf]);
+    size >>= 4;
+  } while (size);
+  return s + CRLF;
+}
+
 int status_code_as_int(StatusCode status_code) 
 { 
   return enum_map(status_codes, status_code); 
@@ -7,8 +7,11 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <type_traits>
 
 #include "Constants.h"
+#include "Body.h"
+#include "StrUtils.h"   // iequals
 
 
 namespace Theros
@@ -19,13 +22,6 @@ namespace Theros
 // Message 
 ////////////////////////////////////////////////////////////////////////
 
-struct DefaultBody  {
-public:
-  using value_type = std::string;
-public:
-
-};
-
 enum class HttpVersion : uint8_t {
   zero_nine,
   one_zero,
@@ -57,7 +53,7 @@ public:
   /** 
    * Methods for manipulating headers 
    */
-  /** Finds header value given a header name */
+  /** Finds header value given a header name, names are case insensitive, rfc7230 section 3.2 */
   std::string FindHeader(const std::string& name);
   /** Setting a header either modifies an existing header in place or insert a new one */
   void SetHeader(const Header& header); 
@@ -128,9 +124,19 @@ RequestMethod request_method_from_cstr(const char* method);
 class Response : public Message<> {
 public:
   StatusCode status_code;
+  AnyBody    content;     // takes precedence over body if set
 public:
   Response() : status_code(StatusCode::OK) { }
 
+  /** 
+   * Replace body with a value of given BodyType, 
+   *    -- DefaultBody, FileBody, SharedBufferBody sets Content-Length
+   *    -- GeneratorBody is sent with chunked transfer encoding
+   *    -- SerializedBody replaces status line and headers as well
+   */
+  template<typename BodyType>
+  void SetBody(typename BodyType::value_type value);
+
   /** Serialize and concatenate status line, headers, and body */
   std::string ToPayload() const;
   /** Serialize status line, and headers */
@@ -141,6 +147,9 @@ public:
   friend std::ostream& operator<<(std::ostream& os, const Response& res);
 };
 
+/** Chunk header for chunked transfer encoding, chunk-size in hex followed by CRLF */
+std::string chunk_size_line(std::size_t size);
+
 int status_code_as_int(StatusCode status_code);
 const char* status_code_as_reason(StatusCode status_code);
 StatusCode status_code_from_int(int status_code);
@@ -154,7 +163,7 @@ template<typename BodyType>
 auto Message<BodyType>::find_header_by_name(const std::string& name) -> HeadersIterator
 {
   return std::find_if(headers.begin(), headers.end(), 
-    [&name](Header& h){ return h.name == name; });
+    [&name](Header& h){ return iequals(h.name, name); });
 }
 
 template<typename BodyType>
@@ -180,7 +189,7 @@ template<typename BodyType>
 void Message<BodyType>::RemoveHeader(const std::string& name)
 {
   auto end = std::remove_if(headers.begin(), headers.end(),
-    [&name](Header& h) { return h.name == name; });
+    [&name](Header& h) { return iequals(h.name, name); });
   headers.erase(end, headers.end());
 }
 
@@ -208,6 +217,33 @@ std::string Message<BodyType>::ContentType()
 template<typename BodyType>
 void Message<BodyType>::ContentLength(int length) { SetHeader({"Content-Length", std::to_string(length)}); }
 
+
+template<typename BodyType>
+void Response::SetBody(typename BodyType::value_type value)
+{
+  if constexpr (std::is_same_v<BodyType, DefaultBody>) {
+    SetHeader({"Content-Length", std::to_string(value.size())});
+    body = std::move(value);
+    content = std::monostate{};
+  } else if constexpr (std::is_same_v<BodyType, FileBody>) {
+    SetHeader({"Content-Length", std::to_string(value.length)});
+    body.clear();
+    content = std::move(value);
+  } else if constexpr (std::is_same_v<BodyType, SharedBufferBody>) {
+    SetHeader({"Content-Length", std::to_string(value ? value->size() : 0)});
+    body.clear();
+    content = std::move(value);
+  } else if constexpr (std::is_same_v<BodyType, GeneratorBody>) {
+    RemoveHeader("Content-Length");
+    body.clear();
+    content = std::move(value);
+  } else {
+    static_assert(std::is_same_v<BodyType, SerializedBody>, "Unknown BodyType");
+    body.clear();
+    content = std::move(value);
+  }
+}
+
 template<typename BodyType>
 void Message<BodyType>::ContentType(const std::string& cont_type) { SetHeader({"Content-Type", cont_type}); }
 
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstdio>
+#include <map>
+
+#include "LoopMonitor.h"
+#include "Metrics.h"
+
+namespace Theros
+{
+
+asio::io_service::id Metrics::id;
+constexpr char Metrics::unmatched[];
+
+namespace
+{
+std::string format_double(double value)
+{
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.9g", value);
+  return buffer;
+}
+
+std::string escape_label(const std::string &value)
+{
+  std::string escaped;
+  for (char c : value) {
+    if (c == '\\' || c == '"') escaped += '\\';
+    if (c == '\n') { escaped += "\\n"; continue; }
+    escaped += c;
+  }
+  return escaped;
+}
+
+// buckets of a Prometheus histogram, sum is in unit of bounds
+void write_histogram(std::string &out, const std::string &name, const std::string &labels,
+                     const std::vector<double> &bounds, const std::vector<std::uint64_t> &cumulative,
+                     std::uint64_t count, double sum)
+{
+  std::string sep = labels.empty() ? "" : ",";
+  for (std::size_t i = 0; i < bounds.size(); ++i)
+    out += name + "_bucket{" + labels + sep + "le=\"" + format_double(bounds[i]) + "\"} " + std::to_string(cumulative[i]) + "\n";
+  out += name + "_bucket{" + labels + sep + "le=\"+Inf\"} " + std::to_string(count) + "\n";
+  std::string braces = labels.empty() ? "" : "{" + labels + "}";
+  out += name + "_sum" + braces + " " + format_double(sum) + "\n";
+  out += name + "_count" + braces + " " + std::to_string(count) + "\n";
+}
+}
+
+
+Metrics::Metrics(asio::io_service &io_service)
+    : asio::io_service::service(io_service), io_service_(io_service)
+{
+}
+
+
+void Metrics::record(RequestMethod method, const std::string &route, int status,
+                     Clock::duration latency, std::uint64_t bytes_in, std::uint64_t bytes_out)
+{
+  auto m = static_cast<std::size_t>(method);
+  if (m >= method_count) return;
+
+  auto &shard = shards_.local();
+  auto &routes = shard.routes[m];
+  auto found = routes.find(route);
+  if (found == routes.end()) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    found = routes.emplace(route, std::make_unique<Counters>()).first;
+  }
+
+  auto &counters = *found->second;
+  if (status >= min_status && status <= max_status)
+    counters.statuses[status - min_status].fetch_add(1, std::memory_order_relaxed);
+  counters.bytes_in.fetch_add(bytes_in, std::memory_order_relaxed);
+  counters.bytes_out.fetch_add(bytes_out, std::memory_order_relaxed);
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+  counters.latency.record(static_cast<std::uint64_t>(std::max<decltype(ns)>(ns, 0)));
+}
+
+
+auto Metrics::snapshot() const -> std::vector<RouteStats>
+{
+  std::map<std::pair<std::string, std::size_t>, RouteStats> merged;
+  std::map<std::pair<std::string, std::size_t>, std::map<int, std::uint64_t>> statuses;
+
+  shards_.for_each([&merged, &statuses](Shard &shard) {
+    std::lock_guard<std::mutex> shard_lock(shard.mutex);
+    for (std::size_t m = 0; m < method_count; ++m) {
+      for (auto &entry : shard.routes[m]) {
+        auto key = std::make_pair(entry.first, m);
+        auto &stats = merged[key];
+        stats.method = static_cast<RequestMethod>(m);
+        stats.route = entry.first;
+
+        auto &counters = *entry.second;
+        for (int i = 0; i <= max_status - min_status; ++i) {
+          auto n = counters.statuses[i].load(std::memory_order_relaxed);
+          if (n) statuses[key][i + min_status] += n;
+        }
+        stats.bytes_in += counters.bytes_in.load(std::memory_order_relaxed);
+        stats.bytes_out += counters.bytes_out.load(std::memory_order_relaxed);
+        counters.latency.add_to(stats.latency);
+      }
+    }
+  });
+
+  std::vector<RouteStats> result;
+  for (auto &entry : merged) {
+    auto &stats = entry.second;
+    for (auto &status : statuses[entry.first]) {
+      stats.statuses.push_back(status);
+      stats.requests += status.second;
+    }
+    result.push_back(std::move(stats));
+  }
+  return result;
+}
+
+
+std::string Metrics::prometheus() const
+{
+  auto routes = snapshot();
+  std::string out;
+
+  auto labels = [](const RouteStats &stats) {
+    return "method=\"" + request_method_as_string(stats.method) + "\",route=\"" + escape_label(stats.route) + "\"";
+  };
+
+  out += "# HELP theros_requests_total Requests served, by route and status code\n";
+  out += "# TYPE theros_requests_total counter\n";
+  for (auto &stats : routes)
+    for (auto &status : stats.statuses)
+      out += "theros_requests_total{" + labels(stats) + ",code=\"" + std::to_string(status.first) + "\"} " +
+             std::to_string(status.second) + "\n";
+
+  out += "# HELP theros_request_bytes_total Bytes of requests received, headers included\n";
+  out += "# TYPE theros_request_bytes_total counter\n";
+  for (auto &stats : routes)
+    out += "theros_request_bytes_total{" + labels(stats) + "} " + std::to_string(stats.bytes_in) + "\n";
+
+  out += "# HELP theros_response_bytes_total Bytes of responses sent, headers included\n";
+  out += "# TYPE theros_response_bytes_total counter\n";
+  for (auto &stats : routes)
+    out += "theros_response_bytes_total{" + labels(stats) + "} " + std::to_string(stats.bytes_out) + "\n";
+
+  const auto &bounds = Histogram::latency_bounds();
+  out += "# HELP theros_request_duration_seconds Time from request headers parsed to response written\n";
+  out += "# TYPE theros_request_duration_seconds histogram\n";
+  for (auto &stats : routes) {
+    std::vector<std::uint64_t> cumulative;
+    for (double bound : bounds)
+      cumulative.push_back(stats.latency.count_at_most(static_cast<std::uint64_t>(bound * 1e9)));
+    write_histogram(out, "theros_request_duration_seconds", labels(stats), bounds, cumulative,
+                    stats.latency.count, stats.latency.sum / 1e9);
+  }
+
+  auto &monitor = asio::use_service<LoopMonitor>(io_service_);
+  if (monitor.started()) {
+    auto lag = monitor.lag().snapshot();
+    std::vector<std::uint64_t> cumulative;
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < lag.bounds.size(); ++i)
+      cumulative.push_back(seen += lag.counts[i]);
+    out += "# HELP theros_event_loop_lag_seconds How late io_service ran a timer past its deadline\n";
+    out += "# TYPE theros_event_loop_lag_seconds histogram\n";
+    write_histogram(out, "theros_event_loop_lag_seconds", "", lag.bounds, cumulative, lag.count, lag.sum);
+  }
+  return out;
+}
+
+
+Handler Metrics::endpoint()
+{
+  enable();
+  return Handler([this](Context &ctx) {
+    ctx.res.SetHeader({"Content-Type", "text/plain; version=0.0.4"});
+    ctx.res.SetBody<DefaultBody>(prometheus());
+  });
+}
+
+} // namespace Theros
@@ -0,0 +1,100 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include "asio.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Constants.h"
+#include "Histogram.h"
+#include "Router.h"
+#include "ThreadShards.h"
+
+namespace Theros
+{
+
+/**
+ * @brief   Per route request counters and latency histograms, an io_service service, one per io_service
+ *
+ *          auto &metrics = asio::use_service<Metrics>(io_service);
+ *          router.get("/metrics", metrics.endpoint());     // recording starts here, or with enable()
+ *
+ *          -- Connection records each request once its response is written, keyed by method and
+ *             pattern of resolved route, i.e. "/users/<id>" rather than "/users/42"
+ *          -- every thread records into a shard of its own, with relaxed atomics and no lock,
+ *             shards are merged only when read
+ *          -- latency is from request headers being parsed to response being written, in an HdrHistogram
+ *             of nanoseconds, exported as a Prometheus histogram in seconds
+ */
+class Metrics : public asio::io_service::service
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr char unmatched[] = "unmatched";   // route of requests without one
+
+  struct RouteStats {
+    RequestMethod method;
+    std::string route;
+    std::vector<std::pair<int, std::uint64_t>> statuses;   // (status code, count), ascending
+    std::uint64_t requests = 0;
+    std::uint64_t bytes_in = 0;
+    std::uint64_t bytes_out = 0;
+    HdrHistogram::Snapshot latency;     // nanoseconds
+  };
+
+  static asio::io_service::id id;
+
+  explicit Metrics(asio::io_service &io_service);
+
+  void enable(bool on = true) { enabled_.store(on, std::memory_order_relaxed); }
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  /** Counts one request, route is a pattern, see Handler::pattern */
+  void record(RequestMethod method, const std::string &route, int status,
+              Clock::duration latency, std::uint64_t bytes_in, std::uint64_t bytes_out);
+
+  /** Merged over threads, ordered by route then method */
+  std::vector<RouteStats> snapshot() const;
+
+  /** Prometheus text exposition format, with lag of LoopMonitor if started */
+  std::string prometheus() const;
+
+  /** Handler serving prometheus(), enables recording */
+  Handler endpoint();
+
+  void shutdown_service() {}
+
+private:
+  static constexpr int min_status = 100;
+  static constexpr int max_status = 599;
+
+  struct Counters {
+    std::array<std::atomic<std::uint64_t>, max_status - min_status + 1> statuses{};
+    std::atomic<std::uint64_t> bytes_in{0};
+    std::atomic<std::uint64_t> bytes_out{0};
+    HdrHistogram latency;
+  };
+
+  // written by one thread only, mutex guards adding routes against readers
+  struct Shard {
+    std::mutex mutex;
+    std::array<std::unordered_map<std::string, std::unique_ptr<Counters>>, method_count> routes;
+  };
+
+  asio::io_service &io_service_;
+  std::atomic<bool> enabled_{false};
+  ThreadShards<Shard> shards_;
+};
+
+} // namespace Theros
+#endif // __METRICS_H__
@@ -147,7 +147,8 @@ constexpr bool is_token(char c) { return !is_ctl(c) && !is_separator(c) && is_ch
 template <typename In>
 inline std::tuple<In, ParseStatus> RequestParser::parse(Request &request, In begin, In end)
 {
-    ParseStatus status;
+    // nothing consumed from an empty range, still in progress
+    ParseStatus status = ParseStatus::in_progress;
     while (begin != end)
     {
     status = consume(request, *begin++);
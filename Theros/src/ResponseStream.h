@@ -0,0 +1,114 @@
+#ifndef __RESPONSESTREAM_H__
+#define __RESPONSESTREAM_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace Theros
+{
+
+/**
+ * @brief   Incrementally written response body, handed to handlers through Context::stream
+ *
+ *          Headers go out as soon as handlers return, with whatever headers handlers set
+ *          by then, even after a write. Body follows
+ *          as chunks with chunked transfer encoding, so time to first byte does not depend
+ *          on how long the body takes to produce.
+ *
+ *          write() returns false once more than high_water_mark bytes are queued,
+ *          producers should then wait for on_written before writing more
+ *
+ *          router.get("/count", [](Context& ctx) {
+ *              for (int i = 0; i < 10; ++i)
+ *                  ctx.stream.write(std::to_string(i) + "\n");
+ *              ctx.stream.end();
+ *          });
+ */
+class ResponseStream
+{
+public:
+    using WriteHandler = std::function<void(std::error_code ec)>;
+    using SinkFunc     = std::function<void(std::string &&chunk, WriteHandler on_written)>;
+    using EndFunc      = std::function<void()>;
+    using FilterFunc   = std::function<std::string(std::string &&chunk, bool last)>;
+    static constexpr std::size_t high_water_mark = 1 << 16; // 64KB
+private:
+    SinkFunc    sink_;
+    EndFunc     end_;
+    FilterFunc  filter_;
+    bool        started_ = false;
+    bool        ended_ = false;
+    std::size_t buffered_ = 0;     // bytes queued but not yet written to socket
+public:
+    /**
+     * @brief   Switches response to streaming, without writing any body yet
+     *          Headers are flushed once handlers return
+     */
+    void begin() { started_ = true; }
+    /**
+     * @brief   Queues a chunk of body, on_written is invoked once chunk is written to socket
+     *          Returns true if more can be written without waiting
+     */
+    bool write(std::string chunk, WriteHandler on_written = nullptr)
+    {
+        started_ = true;
+        if (ended_ || !sink_) {
+            if (on_written) on_written(std::make_error_code(std::errc::not_connected));
+            return false;
+        }
+        buffered_ += chunk.size();
+        sink_(std::move(chunk), std::move(on_written));
+        return buffered_ < high_water_mark;
+    }
+    /**
+     * @brief   Finishes response, writes last-chunk
+     */
+    void end()
+    {
+        started_ = true;
+        if (ended_) return;
+        ended_ = true;
+        if (end_) end_();
+    }
+
+    bool started() const { return started_; }
+    bool ended() const { return ended_; }
+    std::size_t buffered() const { return buffered_; }
+
+    /**
+     * @brief   Connection side, sink receives every chunk written, end is called once
+     */
+    void attach(SinkFunc sink, EndFunc end)
+    {
+        sink_ = std::move(sink);
+        end_ = std::move(end);
+    }
+    /**
+     * @brief   Transforms body on its way to socket, e.g. compression,
+     *          called on every chunk, then once with last set when stream ends
+     */
+    void filter(FilterFunc f) { filter_ = std::move(f); }
+    /** Connection side, chunk after filter */
+    std::string filtered(std::string &&chunk, bool last)
+    {
+        return filter_ ? filter_(std::move(chunk), last) : std::move(chunk);
+    }
+    /** Connection side, n bytes of body left the write queue */
+    void written(std::size_t n) { buffered_ -= std::min(n, buffered_); }
+    /** Reset stream for next request */
+    void reset()
+    {
+        sink_ = nullptr;
+        end_ = nullptr;
+        filter_ = nullptr;
+        started_ = ended_ = false;
+        buffered_ = 0;
+    }
+};
+
+} // namespace Theros
+#endif // __RESPONSESTREAM_H__
@@ -20,6 +20,12 @@ auto Router::resolve(RequestMethod method, const std::string& path) -> RouteType
 
     RouteType route;
 
+    if (found == t.end()) {
+        std::string mount_point = find_mount_point(path);
+        if (!mount_point.empty() && mount_point != path)
+            return resolve(method, mount_point);
+    }
+
     while(found != t.end()) {
         route.push_back(*found);
         --found;
@@ -45,6 +51,17 @@ auto Router::resolve(RequestMethod method,
     RoutingTable& t = routing_tables[to_underlying_t(method)];
     auto found = t.find(path, kvs);
 
+    if (found == t.end()) {
+        std::string mount_point = find_mount_point(path);
+        if (!mount_point.empty() && mount_point != path) {
+            auto route = resolve(method, mount_point, kvs);
+            auto rest = path.substr(mount_point.size());
+            if (!rest.empty() && rest.front() == '/') rest.erase(0, 1);
+            kvs.push_back({"*", rest});
+            return route;
+        }
+    }
+
     RouteType route;
     while(found != t.end()) {
         route.push_back(*found);
@@ -69,6 +86,20 @@ auto Router::table(RequestMethod method) -> RoutingTable&
 }
 
 
+std::string Router::find_mount_point(const std::string& path) const
+{
+    std::string longest;
+    for (const auto& mount_point : mount_points) {
+        if (mount_point.size() <= longest.size() || path.compare(0, mount_point.size(), mount_point) != 0)
+            continue;
+        // "/static" is a mount point for "/static/a" but not "/statics"
+        if (path.size() == mount_point.size() || mount_point.back() == '/' || path[mount_point.size()] == '/')
+            longest = mount_point;
+    }
+    return longest;
+}
+
+
 std::ostream& operator<<(std::ostream& os, const Router& r)
 {
     for(int i = 0; i < method_count; ++i) {
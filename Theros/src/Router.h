@@ -1,8 +1,17 @@
 #ifndef __ROUTER_H__
 #define __ROUTER_H__
 
+#include "asio.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <functional>
 #include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -11,6 +20,11 @@
 #include "Utils.h"  // to_underlying_t
 
 #include "Message.h"
+#include "BodyReader.h"
+#include "ResponseStream.h"
+#include "Task.h"
+#include "Trace.h"
+#include "WorkPool.h"
 
 namespace Theros {
 
@@ -19,54 +33,268 @@ namespace Theros {
 struct Context
 {
     using MapType = std::unordered_map<std::string, std::string>;
+    using HandleFunc = std::function<void(Context &)>;
+    using HookFunc = std::function<void(Context &)>;
+    using ResumeFunc = std::function<void(HookFunc)>;
+    using DeferFunc = std::function<ResumeFunc(std::chrono::steady_clock::duration timeout, HookFunc on_timeout)>;
 public:
-    Request&    req;
-    Response&   res;
-    MapType&    param;
-    MapType&    query;
+    Request&        req;
+    Response&       res;
+    MapType&        param;
+    MapType&        query;
+    BodyReader      body;       // request body, only on streaming routes
+    ResponseStream  stream;     // response body written incrementally, instead of res.body
+    std::vector<HookFunc> headers_hooks;
+    asio::io_service *io_service = nullptr;     // of connection serving request, null outside of one
+    std::uint64_t   trace_id = 0;               // request of spans recorded with TRACE_* macros
+private:
+    bool            ended_ = false;
+    DeferFunc       defer_;
+    const std::vector<HandleFunc> *chain_ = nullptr;   // handlers being run
+    std::size_t     cursor_ = 0;                        // next handler of chain_ to run
 public:
     Context(Request &req, Response &res)
             : req(req), res(res), param(req.uri_param), query(req.uri_query){ };
+
+    // Registers f to run once, right before status line and headers are serialized,
+    // after handlers are done with res, e.g. to transform body set by later handlers.
+    // Hooks run in reverse order of registration, outer middlewares see the final response
+    void on_headers(HookFunc f) { headers_hooks.push_back(std::move(f)); }
+
+    // Finalizes response, handlers after the current one are skipped
+    void end() { ended_ = true; }
+    bool ended() const { return ended_; }
+
+    // Runs handlers after the current one right away, returns once they are done or one of them
+    // ended response, so caller can act on res afterwards. Handlers that do not call next()
+    // are followed by the rest of chain once they return.
+    // Response may still be streamed or parked by defer() after next() returns
+    void next() {
+        while (chain_ && cursor_ < chain_->size() && !ended_) {
+            auto &f = (*chain_)[cursor_++];
+            TRACE_SCOPE("handler", trace_id, static_cast<std::int64_t>(cursor_ - 1));
+            f(*this);
+        }
+    }
+
+    // Runs chain in order until one handler ends response, a nested run returns to outer chain
+    void run(const std::vector<HandleFunc> &chain) {
+        auto outer_chain = chain_;
+        auto outer_cursor = cursor_;
+        chain_ = &chain;
+        cursor_ = 0;
+        next();
+        chain_ = outer_chain;
+        cursor_ = outer_cursor;
+    }
+
+    // Parks response, handlers after the current one are skipped and nothing is sent once they return.
+    // Returned function may be called once, from any thread, f then runs on connection's thread
+    // right before response is sent. If not resumed within timeout, on_timeout runs instead.
+    // Returns empty function, and leaves chain running, if context is not attached to a connection
+    ResumeFunc defer(std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::max(),
+                     HookFunc on_timeout = nullptr) {
+        if (!defer_) return nullptr;
+        end();
+        return defer_(timeout, std::move(on_timeout));
+    }
+    // Like defer(), but once resumed, handlers after the current one run before response is sent,
+    // for a handler that finishes asynchronously. f, if any, runs before them, and may end() to skip them.
+    // on_timeout, as with defer(), runs instead and skips them
+    ResumeFunc suspend(std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::max(),
+                       HookFunc on_timeout = nullptr) {
+        auto chain = chain_;
+        auto cursor = cursor_;
+        auto resume = defer(timeout, std::move(on_timeout));
+        if (!resume) return nullptr;
+        return [resume, chain, cursor](HookFunc f) {
+            resume([f, chain, cursor](Context &ctx) {
+                ctx.ended_ = false;
+                if (f) f(ctx);
+                ctx.chain_ = chain;
+                ctx.cursor_ = cursor;
+                ctx.next();
+                ctx.chain_ = nullptr;
+                ctx.cursor_ = 0;
+            });
+        };
+    }
+
+    // Runs tasks in parallel on WorkPool of connection, response is parked meanwhile. Once all are done,
+    // merge gets their results in order of tasks on connection's thread, then handlers after the current one run.
+    // A task that throws turns response into 500, a full pool into 503, merge is then skipped.
+    // Outside of a connection, tasks run one after another before parallel() returns
+    //
+    //      ctx.parallel<int>({ [](){ return score(a); }, [](){ return score(b); } },
+    //                        [](Context &ctx, std::vector<int> &scores) { ... });
+    template <typename R>
+    void parallel(std::vector<std::function<R()>> tasks, std::function<void(Context &, std::vector<R> &)> merge);
+
+    // Connection side, parks response when handlers call defer()
+    void attach_defer(DeferFunc f) { defer_ = std::move(f); }
 };
 
 
+template <typename R>
+void Context::parallel(std::vector<std::function<R()>> tasks, std::function<void(Context &, std::vector<R> &)> merge)
+{
+    // shared by subtasks, last one to finish resumes connection
+    struct Join {
+        std::vector<std::function<R()>> tasks;
+        std::vector<std::optional<R>> results;
+        std::function<void(Context &, std::vector<R> &)> merge;
+        std::atomic<std::size_t> remaining{0};
+        std::mutex mutex;
+        std::exception_ptr exception;       // first one thrown
+        std::atomic<bool> rejected{false};
+        ResumeFunc resume;
+
+        void run(std::size_t i) {
+            try {
+                results[i].emplace(tasks[i]());
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!exception) exception = std::current_exception();
+            }
+        }
+        void finish(Context &ctx) {
+            if (exception || rejected) {
+                ctx.res.status_code = exception ? StatusCode::Internal_Server_Error : StatusCode::Service_Unavailable;
+                if (!exception) ctx.res.SetHeader({"Retry-After", "1"});
+                ctx.end();
+                return;
+            }
+            std::vector<R> merged;
+            merged.reserve(results.size());
+            for (auto &result : results)
+                merged.push_back(std::move(*result));
+            if (merge) merge(ctx, merged);
+        }
+    };
+
+    auto join = std::make_shared<Join>();
+    join->results.resize(tasks.size());
+    join->tasks = std::move(tasks);
+    join->merge = std::move(merge);
+
+    auto resume = (io_service && !join->tasks.empty()) ? suspend() : nullptr;
+    if (!resume) {
+        for (std::size_t i = 0; i < join->tasks.size(); ++i)
+            join->run(i);
+        join->finish(*this);
+        return;
+    }
+
+    join->resume = std::move(resume);
+    join->remaining = join->tasks.size();
+    auto done = [](const std::shared_ptr<Join> &join) {
+        if (--join->remaining == 0)
+            join->resume([join](Context &ctx) { join->finish(ctx); });
+    };
+
+    auto &pool = asio::use_service<WorkPool>(*io_service);
+    for (std::size_t i = 0; i < join->tasks.size(); ++i) {
+        // once pool is full, rest are not started
+        if (join->rejected || !pool.submit([join, i, done]() { join->run(i); done(join); })) {
+            join->rejected = true;
+            done(join);
+        }
+    }
+}
+
+
 template <typename F>
 constexpr bool is_handler_v = callable_with<F, Context&>() || callable_with<F>();
 template <typename... Fs>
 constexpr bool are_handlers_v = satisfies_all< is_handler_v<Fs>... >;
 
+// Handlers returning Task<> are coroutines, started instead of called
+template <typename F, typename = void>
+struct returns_task : std::false_type {};
+#ifdef THEROS_COROUTINES
+template <typename F>
+struct returns_task<F, std::enable_if_t<std::is_same_v<std::invoke_result_t<F&, Context&>, Task<>>>> : std::true_type {};
+#endif
+template <typename F>
+constexpr bool returns_task_v = returns_task<F>::value;
+
 // A wrapper around a callable that consumes Context
 class Handler 
 {
 public:
-    using HandleFunc    = std::function<void(Context &)>;
+    using HandleFunc    = Context::HandleFunc;
     using ValueT        = std::vector<HandleFunc>;
     static int handler_id_counter;      // init to 0
 protected:
     ValueT          handler_;
     int             handler_id_;
+    bool            streaming_ = false;
+    bool            blocking_ = false;
+    std::string     pattern_;       // path registered with Router, e.g. "/users/<id>"
 public:
     explicit Handler() {};
     template <typename... Fs>
     explicit Handler(Fs... fs) : handler_id_(++handler_id_counter) {
         static_assert(are_handlers_v<Fs...>, "Incorrect function arguments to Handler constructor");
-        handler_ = { wrap(fs, callable_with<Fs, Context&>())...  };
+        (append(fs), ...);
+        (inherit_options(fs), ...);
     }
 
     template <typename F>
-    inline HandleFunc wrap(F f, std::false_type) { return [f](Context& ctx){ f(); }; };
+    inline HandleFunc wrap(F f, std::false_type) { return [f](Context& ctx) mutable { f(); }; };
     template <typename F>
-    inline HandleFunc wrap(F f, std::true_type) { return [f](Context& ctx){ f(ctx); }; };
+    inline HandleFunc wrap(F f, std::true_type) { return [f](Context& ctx) mutable { f(ctx); }; };
 
-    // Appends a new callable to handler_ 
+    // Appends a new callable to handler_, callables of a Handler are spliced in,
+    // so that every callable of a route takes part in the same chain
     template <typename F>
-    inline void append(F f) { handler_.push_back(wrap(f, callable_with<F, Context&>())); }
+    inline void append(F f) {
+        if constexpr (std::is_base_of_v<Handler, F>)
+            handler_.insert(handler_.end(), f.handler_.begin(), f.handler_.end());
+        else if constexpr (returns_task_v<F>)
+            handler_.push_back([f](Context& ctx) mutable { f(ctx).start(ctx); });
+        else
+            handler_.push_back(wrap(f, callable_with<F, Context&>()));
+    }
+
+    // Appends callables of other, keeping options of both
+    inline void merge(const Handler& other) {
+        handler_.insert(handler_.end(), other.handler_.begin(), other.handler_.end());
+        streaming_ = streaming_ || other.streaming_;
+        blocking_ = blocking_ || other.blocking_;
+    }
 
     // Gets id of handler
     inline int id() const { return handler_id_; };
+
+    // Callables in order of registration
+    inline const ValueT& functions() const { return handler_; }
+
+    // Path pattern handler is registered under, set by Router
+    inline const std::string& pattern() const { return pattern_; }
+    inline Handler& pattern(const std::string& path) { pattern_ = path; return *this; }
+
+    // Marks handler as consuming request body through Context::body, 
+    // route is then executed right after headers, before body is read
+    inline Handler& streaming(bool on = true) { streaming_ = on; return *this; }
+    inline bool streaming() const { return streaming_; }
+
+    // Marks handler as doing blocking disk or CPU work, route is then executed on WorkPool,
+    // response is written from io_service once handlers return. No effect on streaming routes
+    inline Handler& blocking(bool on = true) { blocking_ = on; return *this; }
+    inline bool blocking() const { return blocking_; }
+private:
+    // Wrapping a Handler keeps its options
+    template <typename F>
+    inline void inherit_options(const F& f) {
+        if constexpr (std::is_base_of_v<Handler, F>) {
+            streaming_ = streaming_ || f.streaming_;
+            blocking_ = blocking_ || f.blocking_;
+        }
+    }
 public:
     // Invoke on context 
-    void operator()(Context& ctx) { for(auto& f: handler_) { f(ctx);} }
+    void operator()(Context& ctx) { ctx.run(handler_); }
     operator bool() const { return handler_.size() != 0; }
     friend inline bool operator< (const Handler& lhs, const Handler& rhs) { return lhs.handler_id_ < rhs.handler_id_; }
     friend inline bool operator==(const Handler &rhs, const Handler &lhs) { return !(rhs < lhs) && !(lhs < rhs); }
@@ -85,6 +313,7 @@ public:
     using RoutingTables     = std::vector<RoutingTable>;
 public:
     RoutingTables routing_tables;
+    std::vector<std::string> mount_points;    // paths registered with use()
 public:
     explicit Router() : routing_tables(method_count) {}
 
@@ -103,6 +332,8 @@ public:
     void  use(const std::string& path, Fs&&... fs);
 
     // Looks up path to yield a sequence of handlers, empty if no matching path found
+    //      paths without a route of their own fall back to longest mount point (see use()) 
+    //      that is a prefix of path, the rest of path is yielded as kv ("*", rest)
     RouteType resolve(RequestMethod method, const std::string& path);
     RouteType resolve(RequestMethod method, 
                       const std::string& path,
@@ -114,6 +345,10 @@ public:
     // Gets backend table for storing routes
     RoutingTable& table(RequestMethod method);
 
+    // Finds longest mount point that is a prefix of path, ending at a segment boundary,
+    // empty if there is none
+    std::string find_mount_point(const std::string& path) const;
+
     friend std::ostream& operator<<(std::ostream& os, const Router& r);
 };
 
@@ -125,7 +360,12 @@ void Router::handle(RequestMethod method, const std::string& path, Fs&&... fs)
 {
     auto &t = routing_tables[to_underlying_t(method)];
     auto h = Handler(std::forward<Fs>(fs)...);
-    t.insert({path, h});
+    h.pattern(path);
+    if (t.insert({path, h}) == t.end()) {
+        // path is taken, handlers registered later run after those registered earlier
+        auto found = t.find(path);
+        if (found != t.end()) (*found).merge(h);
+    }
 }
 
 template <typename... Fs> 
@@ -137,8 +377,10 @@ void  Router::put(const std::string& path, Fs&&... fs) { handle(RequestMethod::P
 template <typename... Fs>
 void  Router::use(const std::string& path, Fs&&... fs) 
 {
+    if (std::find(mount_points.begin(), mount_points.end(), path) == mount_points.end())
+        mount_points.push_back(path);
     for(auto i = to_underlying_t(RequestMethod::GET); i != to_underlying_t(RequestMethod::UNDETERMINED); ++i)
-        handle(static_cast<RequestMethod>(i), path, std::forward<Fs>(fs)...);
+        handle(static_cast<RequestMethod>(i), path, fs...);    // copies, each method gets its own
 }
 
 
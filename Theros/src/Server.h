@@ -10,12 +10,19 @@
 #include "asio/ssl/impl/src.hpp"
 
 #include <fstream>
+#include <stdexcept>
 #include <string>
 #include <utility>
 
 #include "Defines.h"
+#include "AdmissionControl.h"
+#include "LoopMonitor.h"
+#include "Metrics.h"
+#include "TrafficRecorder.h"
+#include "AccessLog.h"
 #include "Connection.h"
 #include "Router.h"
+#include "ServerConfig.h"
 
 namespace Theros
 {
@@ -28,15 +35,23 @@ using ServerAddr = std::pair<std::string, int>;
 template <typename Derived>
 class GenericServer
 {
-public:
-  constexpr static int max_header_bytes = 1 << 20; // 1MB
 public:
   /* non-copy-constructible */
   GenericServer(const GenericServer &) = delete;
   GenericServer &operator=(const GenericServer &) = delete;
 
   explicit GenericServer(const ServerAddr server_addr)
-      : server_address_(server_addr), io_service_(), acceptor_(io_service_){};
+      : GenericServer(with_address(ServerConfig(), server_addr)){};
+
+  /**
+   * @brief   Server as configured, admission control and work pool are configured from it here
+   */
+  explicit GenericServer(const ServerConfig &config)
+      : config_(config), server_address_(config.host, config.port), io_service_(), acceptor_(io_service_)
+  {
+    admission().configure(config_.admission);
+    asio::use_service<WorkPool>(io_service_).configure(config_.work_pool);
+  };
 
   /**
    * @brief   Starts the server
@@ -49,15 +64,43 @@ public:
 
     // configure acceptor
     acceptor_.open(endpoint.protocol());
-    acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true));
-    acceptor_.set_option(asio::ip::tcp::no_delay(true));
+    acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(config_.reuse_address));
+    acceptor_.set_option(asio::ip::tcp::no_delay(config_.no_delay));
     acceptor_.bind(endpoint);
-    acceptor_.listen();
+    acceptor_.listen(config_.backlog);
     /* accpeting connection on an event loop */
     static_cast<Derived *>(this)->accept_connection();
+    monitor().start();
     io_service_.run();
   }
 
+  /**
+   * @brief   Connection and request limits of server, configure before run()
+   */
+  AdmissionControl &admission() { return asio::use_service<AdmissionControl>(io_service_); }
+
+  /**
+   * @brief   Event loop lag and slow handler reports, started by run() unless started already
+   */
+  LoopMonitor &monitor() { return asio::use_service<LoopMonitor>(io_service_); }
+
+  /**
+   * @brief   Per route request metrics, serve them with router_.get("/metrics", metrics().endpoint())
+   */
+  Metrics &metrics() { return asio::use_service<Metrics>(io_service_); }
+
+  /**
+   * @brief   Records inbound bytes of connections once opened, replay them with ./bin/replay
+   */
+  TrafficRecorder &recorder() { return asio::use_service<TrafficRecorder>(io_service_); }
+
+  /**
+   * @brief   Access log of requests, written from a thread of its own once opened
+   */
+  AccessLog &access_log() { return asio::use_service<AccessLog>(io_service_); }
+
+  const ServerConfig &config() const { return config_; }
+
   /**
    * @brief   Getting server address fields
    */
@@ -73,6 +116,17 @@ public:
            std::to_string(port());
   }
 
+protected:
+  ServerConfig config_;
+
+private:
+  static ServerConfig with_address(ServerConfig config, const ServerAddr &server_addr)
+  {
+    config.host = server_addr.first;
+    config.port = server_addr.second;
+    return config;
+  }
+
 public:
   Router router_;
   ServerAddr server_address_; // (host, port) pair
@@ -88,14 +142,21 @@ class HttpServer : public GenericServer<HttpServer>
 public:
   explicit HttpServer(const ServerAddr server_addr)
       : GenericServer(server_addr){};
+  explicit HttpServer(const ServerConfig &config)
+      : GenericServer(config){};
   /**
    * @brief   Accept connection and creates new session
    */
   void accept_connection()
   {
+    // at max_connections, accepting resumes once a connection closes
+    if (!admission().accepting()) {
+      admission().when_accepting([this]() { accept_connection(); });
+      return;
+    }
 
     auto new_conn =
-        std::make_shared<Connection<TcpSocket>>(io_service_, router_);
+        std::make_shared<Connection<TcpSocket>>(io_service_, router_, config_.connection);
 
     acceptor_.async_accept(
         new_conn->socket_,
@@ -125,15 +186,25 @@ public:
   {
     configure_ssl_context();
   };
+  explicit HttpsServer(const ServerConfig &config)
+      : GenericServer(config), context_(asio::ssl::context::sslv23)
+  {
+    configure_ssl_context();
+  };
 
   /**
    * @brief   Accept connection and creates new session
    */
   void accept_connection()
   {
+    // at max_connections, accepting resumes once a connection closes
+    if (!admission().accepting()) {
+      admission().when_accepting([this]() { accept_connection(); });
+      return;
+    }
 
     auto new_conn =
-        std::make_shared<Connection<SslSocket>>(io_service_, context_, router_);
+        std::make_shared<Connection<SslSocket>>(io_service_, context_, router_, config_.connection);
 
     acceptor_.async_accept(
         new_conn->socket_.lowest_layer(),
@@ -156,7 +227,7 @@ private:
 
 private:
   /**
-   * @brief   Sets options, key, cert for Openssl
+   * @brief   Sets options, key, cert for Openssl, files are those of config_.tls
    */
   void inline configure_ssl_context()
   {
@@ -164,19 +235,30 @@ private:
                          asio::ssl::context::no_sslv2 |
                          asio::ssl::context::single_dh_use);
 
-    context_.set_password_callback([](
+    context_.set_password_callback([file = config_.tls.passphrase](
         std::size_t max_length, asio::ssl::context::password_purpose purpose) {
       std::string passphrase;
-      std::fstream passinf("Summer/ssl/passphrase", std::ios::in);
+      std::fstream passinf(file, std::ios::in);
       if (passinf)
       {
         std::getline(passinf, passphrase);
       }
       return passphrase;
     });
-    context_.use_private_key_file("Summer/ssl/key.pem", asio::ssl::context::pem);
-    context_.use_certificate_chain_file("Summer/ssl/cert.pem");
-    context_.use_tmp_dh_file("Summer/ssl/dh512.pem");
+    // file that cannot be loaded is named, rather than a bare error of OpenSSL
+    auto load = [](const char *key, const std::string &path, auto use) {
+      try {
+        use(path);
+      } catch (const std::exception &e) {
+        throw std::runtime_error(std::string("tls.") + key + ": cannot load " + path + ": " + e.what());
+      }
+    };
+    load("private_key", config_.tls.private_key,
+         [this](const std::string &path) { context_.use_private_key_file(path, asio::ssl::context::pem); });
+    load("certificate_chain", config_.tls.certificate_chain,
+         [this](const std::string &path) { context_.use_certificate_chain_file(path); });
+    load("dh_params", config_.tls.dh_params,
+         [this](const std::string &path) { context_.use_tmp_dh_file(path); });
   };
 };
 
@@ -0,0 +1,249 @@
+#include <fstream>
+#include <set>
+#include <stdexcept>
+
+#include "ServerConfig.h"
+
+namespace Theros
+{
+
+namespace
+{
+const char *limit_names[] = {"none", "fixed", "aimd", "gradient"};
+
+/** Members of a JSON object read into fields, any member left unread is an error */
+class Fields
+{
+public:
+  Fields(const JsonType &json, const std::string &where) : json_(json), where_(where)
+  {
+    if (!json.is_object()) fail(where, "expected an object");
+  }
+
+  void read(const char *key, std::size_t &value)
+  {
+    if (auto member = find(key)) {
+      if (!member->is_number_integer() || member->get<long long>() < 0) fail(path(key), "expected a non-negative integer");
+      value = member->get<std::size_t>();
+    }
+  }
+
+  void read(const char *key, int &value)
+  {
+    if (auto member = find(key)) {
+      if (!member->is_number_integer()) fail(path(key), "expected an integer");
+      value = member->get<int>();
+    }
+  }
+
+  void read(const char *key, double &value)
+  {
+    if (auto member = find(key)) {
+      if (!member->is_number()) fail(path(key), "expected a number");
+      value = member->get<double>();
+    }
+  }
+
+  void read(const char *key, bool &value)
+  {
+    if (auto member = find(key)) {
+      if (!member->is_boolean()) fail(path(key), "expected true or false");
+      value = member->get<bool>();
+    }
+  }
+
+  void read(const char *key, std::string &value)
+  {
+    if (auto member = find(key)) {
+      if (!member->is_string()) fail(path(key), "expected a string");
+      value = member->get<std::string>();
+    }
+  }
+
+  template <typename Duration, typename Unit>
+  void read_duration(const char *key, Duration &value, Unit unit)
+  {
+    std::size_t count = 0;
+    if (!find(key)) return;
+    read(key, count);
+    value = std::chrono::duration_cast<Duration>(unit * count);
+  }
+
+  void read(const char *key, ConcurrencyLimit &value)
+  {
+    std::string name;
+    if (!find(key)) return;
+    read(key, name);
+    for (std::size_t i = 0; i < sizeof(limit_names) / sizeof(limit_names[0]); ++i)
+      if (name == limit_names[i]) {
+        value = static_cast<ConcurrencyLimit>(i);
+        return;
+      }
+    fail(path(key), "expected one of none, fixed, aimd, gradient");
+  }
+
+  /** Nested object, if present */
+  const JsonType *object(const char *key) { return find(key); }
+
+  std::string path(const char *key) const { return where_.empty() ? key : where_ + "." + key; }
+
+  /** Throws on first member no read above asked for */
+  void check_unknown() const
+  {
+    for (auto it = json_.begin(); it != json_.end(); ++it)
+      if (!known_.count(it.key())) fail(path(it.key().c_str()), "unknown key");
+  }
+
+  [[noreturn]] static void fail(const std::string &where, const std::string &what)
+  {
+    throw std::runtime_error("server config: " + (where.empty() ? std::string("top level") : where) + ": " + what);
+  }
+
+private:
+  const JsonType &json_;
+  std::string where_;
+  std::set<std::string> known_;
+
+  const JsonType *find(const char *key)
+  {
+    known_.insert(key);
+    auto it = json_.find(key);
+    return it == json_.end() ? nullptr : &*it;
+  }
+};
+
+void read_connection(const JsonType &json, ConnectionOptions &options)
+{
+  Fields fields(json, "connection");
+  fields.read("read_buffer_bytes", options.read_buffer_bytes);
+  fields.read("max_header_bytes", options.max_header_bytes);
+  fields.read("max_body_bytes", options.max_body_bytes);
+  fields.read("file_block_bytes", options.file_block_bytes);
+  fields.read_duration("read_timeout_ms", options.read_timeout, std::chrono::milliseconds(1));
+  fields.read_duration("stream_timeout_ms", options.stream_timeout, std::chrono::milliseconds(1));
+  fields.check_unknown();
+  if (options.read_buffer_bytes == 0) Fields::fail("connection.read_buffer_bytes", "must not be 0");
+  if (options.file_block_bytes == 0) Fields::fail("connection.file_block_bytes", "must not be 0");
+}
+
+void read_admission(const JsonType &json, AdmissionOptions &options)
+{
+  Fields fields(json, "admission");
+  fields.read("max_connections", options.max_connections);
+  fields.read("max_connections_per_ip", options.max_connections_per_ip);
+  fields.read("limit", options.limit);
+  fields.read("initial_limit", options.initial_limit);
+  fields.read("min_limit", options.min_limit);
+  fields.read("max_limit", options.max_limit);
+  fields.read_duration("aimd_latency_threshold_ms", options.aimd_latency_threshold, std::chrono::milliseconds(1));
+  fields.read("aimd_backoff", options.aimd_backoff);
+  fields.read("gradient_smoothing", options.gradient_smoothing);
+  fields.read("gradient_window", options.gradient_window);
+  fields.read_duration("retry_after_s", options.retry_after, std::chrono::seconds(1));
+  fields.check_unknown();
+}
+
+void read_work_pool(const JsonType &json, WorkPoolOptions &options)
+{
+  Fields fields(json, "work_pool");
+  fields.read("threads", options.threads);
+  fields.read("max_queued", options.max_queued);
+  fields.check_unknown();
+}
+
+void read_tls(const JsonType &json, TlsFiles &tls)
+{
+  Fields fields(json, "tls");
+  fields.read("private_key", tls.private_key);
+  fields.read("certificate_chain", tls.certificate_chain);
+  fields.read("dh_params", tls.dh_params);
+  fields.read("passphrase", tls.passphrase);
+  fields.check_unknown();
+}
+
+template <typename Duration>
+long long count_as(ClockType::duration d)
+{
+  return std::chrono::duration_cast<Duration>(d).count();
+}
+}
+
+
+ServerConfig ServerConfig::from_json(const JsonType &json)
+{
+  ServerConfig config;
+  Fields fields(json, "");
+  fields.read("host", config.host);
+  fields.read("port", config.port);
+  fields.read("backlog", config.backlog);
+  fields.read("reuse_address", config.reuse_address);
+  fields.read("no_delay", config.no_delay);
+  if (auto connection = fields.object("connection")) read_connection(*connection, config.connection);
+  if (auto admission = fields.object("admission")) read_admission(*admission, config.admission);
+  if (auto work_pool = fields.object("work_pool")) read_work_pool(*work_pool, config.work_pool);
+  if (auto tls = fields.object("tls")) read_tls(*tls, config.tls);
+  fields.check_unknown();
+
+  if (config.port < 0 || config.port > 65535) Fields::fail("port", "expected 0 to 65535");
+  if (config.backlog <= 0) Fields::fail("backlog", "must be positive");
+  return config;
+}
+
+
+ServerConfig ServerConfig::load(const std::string &path)
+{
+  std::ifstream file(path);
+  if (!file) throw std::runtime_error("server config: cannot read " + path);
+  JsonType json;
+  try {
+    file >> json;
+  } catch (const std::exception &e) {
+    throw std::runtime_error("server config: " + path + ": " + e.what());
+  }
+  return from_json(json);
+}
+
+
+JsonType ServerConfig::to_json() const
+{
+  return {
+    {"host", host},
+    {"port", port},
+    {"backlog", backlog},
+    {"reuse_address", reuse_address},
+    {"no_delay", no_delay},
+    {"connection", {
+      {"read_buffer_bytes", connection.read_buffer_bytes},
+      {"max_header_bytes", connection.max_header_bytes},
+      {"max_body_bytes", connection.max_body_bytes},
+      {"file_block_bytes", connection.file_block_bytes},
+      {"read_timeout_ms", count_as<std::chrono::milliseconds>(connection.read_timeout)},
+      {"stream_timeout_ms", count_as<std::chrono::milliseconds>(connection.stream_timeout)},
+    }},
+    {"admission", {
+      {"max_connections", admission.max_connections},
+      {"max_connections_per_ip", admission.max_connections_per_ip},
+      {"limit", limit_names[static_cast<std::size_t>(admission.limit)]},
+      {"initial_limit", admission.initial_limit},
+      {"min_limit", admission.min_limit},
+      {"max_limit", admission.max_limit},
+      {"aimd_latency_threshold_ms", count_as<std::chrono::milliseconds>(admission.aimd_latency_threshold)},
+      {"aimd_backoff", admission.aimd_backoff},
+      {"gradient_smoothing", admission.gradient_smoothing},
+      {"gradient_window", admission.gradient_window},
+      {"retry_after_s", admission.retry_after.count()},
+    }},
+    {"work_pool", {
+      {"threads", work_pool.threads},
+      {"max_queued", work_pool.max_queued},
+    }},
+    {"tls", {
+      {"private_key", tls.private_key},
+      {"certificate_chain", tls.certificate_chain},
+      {"dh_params", tls.dh_params},
+      {"passphrase", tls.passphrase},
+    }},
+  };
+}
+
+} // namespace Theros
@@ -0,0 +1,74 @@
+#ifndef __SERVER_CONFIG_H__
+#define __SERVER_CONFIG_H__
+
+#include "asio.hpp"
+
+#include <cstddef>
+#include <string>
+
+#include "Defines.h"
+#include "AdmissionControl.h"
+#include "Connection.h"
+#include "WorkPool.h"
+
+namespace Theros
+{
+
+/**
+ * @brief   Key, certificate chain and DH parameters of HttpsServer, PEM files,
+ *          relative to working directory, defaults are the self-signed ones of Theros/ssl
+ *          for a server run from top of repository
+ */
+struct TlsFiles {
+  std::string private_key = "Theros/ssl/key.pem";
+  std::string certificate_chain = "Theros/ssl/cert.pem";
+  std::string dh_params = "Theros/ssl/dh2048.pem";
+  std::string passphrase = "Theros/ssl/passphrase";   // file with passphrase of key on first line, may be missing
+};
+
+/**
+ * @brief   Tunables of a server, for GenericServer(const ServerConfig &), defaults are those of a
+ *          server made from an address alone
+ *
+ *          auto config = ServerConfig::load("server.json");
+ *          HttpsServer app(config);
+ *
+ *          {
+ *            "host": "0.0.0.0", "port": 8443,
+ *            "backlog": 1024, "reuse_address": true, "no_delay": true,
+ *            "connection": { "read_buffer_bytes": 16384, "read_timeout_ms": 5000, "stream_timeout_ms": 60000,
+ *                            "max_header_bytes": 65536, "max_body_bytes": 8388608, "file_block_bytes": 65536 },
+ *            "admission": { "max_connections": 10000, "max_connections_per_ip": 64, "limit": "gradient",
+ *                           "initial_limit": 64, "min_limit": 4, "max_limit": 1024, "retry_after_s": 1 },
+ *            "work_pool": { "threads": 8, "max_queued": 4096 },
+ *            "tls": { "private_key": "ssl/key.pem", "certificate_chain": "ssl/cert.pem",
+ *                     "dh_params": "ssl/dh2048.pem", "passphrase": "ssl/passphrase" }
+ *          }
+ *
+ *          -- every key is optional, an unknown key or a value of the wrong type throws std::runtime_error
+ *             naming it, so a typo does not silently leave a default in place
+ *          -- durations are integers with their unit in the key, _ms or _s
+ */
+struct ServerConfig {
+  std::string host = "127.0.0.1";
+  int port = 8888;
+  int backlog = asio::socket_base::max_connections;     // of listening socket
+  bool reuse_address = true;
+  bool no_delay = true;
+
+  ConnectionOptions connection;
+  AdmissionOptions admission;
+  WorkPoolOptions work_pool;
+  TlsFiles tls;
+
+  /** Parses a JSON object as above, throws std::runtime_error */
+  static ServerConfig from_json(const JsonType &json);
+  /** Reads and parses a JSON file, throws std::runtime_error */
+  static ServerConfig load(const std::string &path);
+
+  /** As JSON, in the form from_json reads */
+  JsonType to_json() const;
+};
+
+} // namespace Theros
+#endif // __SERVER_CONFIG_H__
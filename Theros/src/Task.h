@@ -0,0 +1,176 @@
+#ifndef __TASK_H__
+#define __TASK_H__
+
+// coroutine handlers need C++20, THEROS_COROUTINES is defined if compiler supports them
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define THEROS_COROUTINES 1
+#endif
+#endif
+
+#ifdef THEROS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#include "Constants.h"
+
+namespace Theros
+{
+
+template <typename T = void>
+class Task;
+
+namespace detail
+{
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;               // coroutine awaiting this one
+    std::function<void(std::exception_ptr)> on_done;    // set once a handler's task is detached
+    std::exception_ptr exception;
+
+    // lazy, runs once awaited or started
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            auto &promise = h.promise();
+            if (promise.continuation)
+                return promise.continuation;
+            // detached, nothing else owns frame
+            if (promise.on_done) {
+                auto on_done = std::move(promise.on_done);
+                auto exception = promise.exception;
+                h.destroy();
+                on_done(exception);
+            }
+            return std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { exception = std::current_exception(); }
+    void rethrow_if_failed() { if (exception) std::rethrow_exception(exception); }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+    template <typename U>
+    void return_value(U &&u) { value.emplace(std::forward<U>(u)); }
+    T result() { rethrow_if_failed(); return std::move(*value); }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    void return_void() {}
+    void result() { rethrow_if_failed(); }
+};
+
+} // namespace detail
+
+
+/**
+ * @brief   Lazily started coroutine, co_await it from another coroutine for its result
+ *
+ *          A Task<> returned by a handler is started by Handler, response is parked
+ *          with Context::suspend, remaining handlers run, and response is sent,
+ *          once it completes
+ *
+ *          router.get("/later", [](Context &ctx) -> Task<> {
+ *              co_await sleep_for(ctx, std::chrono::milliseconds(100));
+ *              ctx.res.SetBody<DefaultBody>("done");
+ *          });
+ *
+ *          See Coroutine.h for awaitables on Context
+ */
+template <typename T>
+class Task
+{
+public:
+    struct promise_type : detail::Promise<T> {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) { }
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task() { if (handle_) handle_.destroy(); }
+
+    auto operator co_await() noexcept
+    {
+        struct Awaiter {
+            handle_type handle;
+            bool await_ready() noexcept { return !handle || handle.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+            {
+                handle.promise().continuation = caller;
+                return handle;
+            }
+            T await_resume() { return handle.promise().result(); }
+        };
+        return Awaiter{handle_};
+    }
+
+    /**
+     * @brief   Runs task of a handler, response is parked first, remaining handlers of ctx
+     *          run once it completes, even if it does so before start returns.
+     *          Exception thrown turns response into 500,
+     *          outside of a connection one thrown before first suspension propagates
+     */
+    template <typename Ctx>
+    void start(Ctx &ctx)
+    {
+        auto handle = std::exchange(handle_, nullptr);
+        auto resume = ctx.suspend();
+
+        // outside of a connection nothing is parked, awaitables complete at once
+        if (!resume) {
+            handle.resume();
+            if (handle.done()) {
+                auto exception = handle.promise().exception;
+                handle.destroy();
+                if (exception) std::rethrow_exception(exception);
+                return;
+            }
+            handle.promise().on_done = [](std::exception_ptr) {};
+            return;
+        }
+
+        // in place before first resume, an awaitable may complete on another thread, e.g. of WorkPool,
+        // before resume() returns here. A task done already is resolved by it from final_suspend
+        handle.promise().on_done = [resume](std::exception_ptr exception) {
+            resume([exception](Ctx &ctx) {
+                if (!exception) return;
+                ctx.res.status_code = StatusCode::Internal_Server_Error;
+                ctx.end();
+            });
+        };
+        handle.resume();
+    }
+
+private:
+    explicit Task(handle_type handle) : handle_(handle) { }
+    handle_type handle_;
+};
+
+} // namespace Theros
+
+#endif // THEROS_COROUTINES
+#endif // __TASK_H__
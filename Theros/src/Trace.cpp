@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+#include "Router.h"
+#include "Trace.h"
+
+namespace Theros
+{
+
+namespace
+{
+thread_local void *current_ring = nullptr;
+}
+
+
+// re-armed after each signal, pending wait keeps signals alive until io_service is destroyed
+void Tracer::wait_for_signal(std::shared_ptr<asio::signal_set> signals, const Tracer *tracer, std::string path)
+{
+  signals->async_wait([signals, tracer, path](std::error_code ec, int) {
+    if (ec) return;
+    tracer->dump(path);
+    wait_for_signal(signals, tracer, path);
+  });
+}
+
+
+Tracer &Tracer::instance()
+{
+  static Tracer tracer;
+  return tracer;
+}
+
+
+std::int64_t Tracer::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+auto Tracer::local_ring() -> Ring &
+{
+  if (current_ring) return *static_cast<Ring *>(current_ring);
+
+  std::lock_guard<std::mutex> lock(rings_mutex_);
+  rings_.push_back(std::make_unique<Ring>());
+  rings_.back()->thread = static_cast<std::uint32_t>(rings_.size());
+  current_ring = rings_.back().get();
+  return *rings_.back();
+}
+
+
+void Tracer::record(const char *name, std::uint64_t request, std::int64_t begin, std::int64_t end, std::int64_t arg)
+{
+  auto &ring = local_ring();
+  auto head = ring.head.load(std::memory_order_relaxed);
+  auto &slot = ring.slots[head % ring_size];
+
+  // sequence is odd while fields are inconsistent, readers retry or skip slot
+  auto sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.request.store(request, std::memory_order_relaxed);
+  slot.begin.store(begin, std::memory_order_relaxed);
+  slot.end.store(end, std::memory_order_relaxed);
+  slot.arg.store(arg, std::memory_order_relaxed);
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+
+auto Tracer::spans() const -> std::vector<Span>
+{
+  std::vector<Span> spans;
+
+  std::lock_guard<std::mutex> lock(rings_mutex_);
+  for (auto &ring : rings_) {
+    auto head = ring->head.load(std::memory_order_acquire);
+    auto first = head > ring_size ? head - ring_size : 0;
+    for (auto i = first; i < head; ++i) {
+      auto &slot = ring->slots[i % ring_size];
+      auto before = slot.sequence.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      Span span{slot.name.load(std::memory_order_relaxed), slot.request.load(std::memory_order_relaxed),
+                slot.begin.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed),
+                slot.arg.load(std::memory_order_relaxed), ring->thread};
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != before || !span.name) continue;
+      spans.push_back(span);
+    }
+  }
+
+  std::stable_sort(spans.begin(), spans.end(), [](const Span &a, const Span &b) { return a.begin < b.begin; });
+  return spans;
+}
+
+
+void Tracer::clear()
+{
+  std::lock_guard<std::mutex> lock(rings_mutex_);
+  // only owner thread moves head, cleared slots read as empty until written again
+  for (auto &ring : rings_)
+    for (std::size_t i = 0; i < ring_size; ++i)
+      ring->slots[i].name.store(nullptr, std::memory_order_relaxed);
+}
+
+
+std::string Tracer::chrome_json() const
+{
+  JsonType events = JsonType::array();
+
+  for (auto &span : spans()) {
+    JsonType event = {
+      {"name", span.name},
+      {"cat", "request"},
+      {"id", span.request},
+      {"pid", 1},
+      {"tid", span.thread},
+      {"ts", span.begin / 1000.0},
+    };
+    if (span.arg >= 0) event["args"] = {{"index", span.arg}};
+
+    // async events, a request gets a track of its own even as requests interleave on a thread
+    if (span.end == span.begin) {
+      event["ph"] = "n";
+      events.push_back(event);
+      continue;
+    }
+    event["ph"] = "b";
+    events.push_back(event);
+    event["ph"] = "e";
+    event["ts"] = span.end / 1000.0;
+    events.push_back(event);
+  }
+
+  JsonType trace = {{"traceEvents", events}, {"displayTimeUnit", "ns"}};
+  return trace.dump();
+}
+
+
+bool Tracer::dump(const std::string &path) const
+{
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out << chrome_json();
+  return static_cast<bool>(out);
+}
+
+
+std::function<void(Context &)> Tracer::endpoint()
+{
+  return [this](Context &ctx) {
+    ctx.res.SetHeader({"Content-Type", "application/json"});
+    ctx.res.SetBody<DefaultBody>(chrome_json());
+  };
+}
+
+
+void Tracer::dump_on_signal(asio::io_service &io_service, int signal_number, const std::string &path)
+{
+  wait_for_signal(std::make_shared<asio::signal_set>(io_service, signal_number), this, path);
+}
+
+} // namespace Theros
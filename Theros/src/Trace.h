@@ -0,0 +1,111 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include "asio.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Defines.h"
+
+namespace Theros
+{
+
+struct Context;
+
+/**
+ * @brief   Process wide recorder of request phase spans, exported as Chrome trace JSON,
+ *          which chrome://tracing and Perfetto load
+ *
+ *          Spans are recorded with TRACE_* macros of Defines.h, and only if compiled with _TRACE_
+ *
+ *          router.get("/trace", Tracer::instance().endpoint());
+ *          Tracer::instance().dump_on_signal(io_service, SIGUSR2, "theros.trace.json");
+ *
+ *          -- each thread records into a ring of its own, newest spans overwrite oldest,
+ *             without locks, a reader skips slots overwritten while it copies them
+ *          -- a request is an async track of its own, spans are named after phases:
+ *             accept, tls handshake, first byte, parse headers, route, handler, write
+ */
+class Tracer
+{
+public:
+  static constexpr std::size_t ring_size = 1 << 14;    // spans kept per thread
+
+  struct Span {
+    const char *name;           // string literal
+    std::uint64_t request;
+    std::int64_t begin;         // ns, steady clock
+    std::int64_t end;
+    std::int64_t arg;           // e.g. index of handler in chain, -1 if none
+    std::uint32_t thread;
+  };
+
+  static Tracer &instance();
+  static std::int64_t now();
+
+  /** Id for spans of a new request */
+  std::uint64_t next_request() { return ++requests_; }
+
+  void record(const char *name, std::uint64_t request, std::int64_t begin, std::int64_t end, std::int64_t arg = -1);
+  void instant(const char *name, std::uint64_t request) { auto t = now(); record(name, request, t, t); }
+
+  /** Spans of all threads, oldest first */
+  std::vector<Span> spans() const;
+  void clear();
+
+  /** {"traceEvents": [...]}, in Chrome trace event format */
+  std::string chrome_json() const;
+  bool dump(const std::string &path) const;
+
+  /** Handler serving chrome_json() */
+  std::function<void(Context &)> endpoint();
+  /** Writes chrome_json() to path whenever signal_number is raised, from io_service */
+  void dump_on_signal(asio::io_service &io_service, int signal_number, const std::string &path);
+
+private:
+  struct Slot {
+    std::atomic<std::uint64_t> sequence{0};     // odd while being written
+    std::atomic<const char *> name{nullptr};
+    std::atomic<std::uint64_t> request{0};
+    std::atomic<std::int64_t> begin{0}, end{0}, arg{0};
+  };
+  struct Ring {
+    std::uint32_t thread;
+    std::atomic<std::uint64_t> head{0};         // spans written so far
+    std::unique_ptr<Slot[]> slots{new Slot[ring_size]};
+  };
+
+  std::atomic<std::uint64_t> requests_{0};
+  mutable std::mutex rings_mutex_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+
+  Tracer() = default;
+  Ring &local_ring();
+  static void wait_for_signal(std::shared_ptr<asio::signal_set> signals, const Tracer *tracer, std::string path);
+};
+
+
+/** Records a span over its lifetime, see TRACE_SCOPE */
+class TraceScope
+{
+public:
+  TraceScope(const char *name, std::uint64_t request, std::int64_t arg = -1)
+      : name_(name), request_(request), arg_(arg), begin_(Tracer::now()) {}
+  ~TraceScope() { Tracer::instance().record(name_, request_, begin_, Tracer::now(), arg_); }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+private:
+  const char *name_;
+  std::uint64_t request_;
+  std::int64_t arg_;
+  std::int64_t begin_;
+};
+
+} // namespace Theros
+#endif // __TRACE_H__
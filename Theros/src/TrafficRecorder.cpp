@@ -0,0 +1,334 @@
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BodyParser.h"
+#include "Message.h"
+#include "TrafficRecorder.h"
+
+namespace Theros
+{
+
+asio::io_service::id TrafficRecorder::id;
+
+namespace
+{
+constexpr std::size_t magic_bytes = sizeof(traffic_magic) - 1;
+constexpr std::uint64_t max_data_bytes = 1 << 24;    // larger is taken for a corrupt log
+
+void append_varint(std::string &out, std::uint64_t value)
+{
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+}
+
+
+/**
+ * @brief   Masks values of redacted headers in inbound bytes of one connection as they
+ *          stream by, a header may span reads, bodies are skipped by their framing so
+ *          body bytes are never taken for header lines
+ *
+ *          -- gives up, leaving the rest as read, on framing BodyParser rejects, the
+ *             connection answers 400 and closes then anyway
+ */
+class TrafficRecorder::Redactor
+{
+public:
+  explicit Redactor(const std::vector<std::string> &names) : names_(names) {}
+
+  void redact(char *data, std::size_t size);
+
+private:
+  enum class State { line_start, request_line, name, value, masked_value, body, passthrough };
+  static constexpr std::size_t max_name_bytes = 256;     // longer names are not redacted nor framing
+  static constexpr std::size_t max_value_bytes = 256;    // of framing headers
+
+  const std::vector<std::string> &names_;
+  State state_ = State::line_start;
+  bool request_line_ = true;    // next line is request line, i.e. at start of a request
+  bool masked_ = false;         // value of last header is masked, as are its folded lines
+  std::string name_;
+  std::string value_;
+  Request request_;             // framing headers of current request
+  BodyParser body_;
+
+  bool redacted(const std::string &name) const
+  {
+    for (auto &redacted_name : names_)
+      if (iequals(name, redacted_name)) return true;
+    return false;
+  }
+  void end_header();
+  void end_head();
+  void start_request()
+  {
+    state_ = State::line_start;
+    request_line_ = true;
+    masked_ = false;
+  }
+};
+
+
+void TrafficRecorder::Redactor::redact(char *data, std::size_t size)
+{
+  for (std::size_t i = 0; i < size; ++i) {
+    char &c = data[i];
+    switch (state_) {
+    case State::line_start:
+      if (c == '\r') break;
+      if (c == '\n') {
+        if (!request_line_) end_head();
+        break;
+      }
+      if (request_line_) {
+        state_ = State::request_line;
+      } else if ((c == ' ' || c == '\t') && masked_) {
+        // obs-fold, line continues a masked value
+        c = '*';
+        state_ = State::masked_value;
+      } else {
+        masked_ = false;
+        name_.assign(1, c);
+        state_ = State::name;
+      }
+      break;
+    case State::request_line:
+      if (c == '\n') {
+        request_line_ = false;
+        state_ = State::line_start;
+      }
+      break;
+    case State::name:
+      if (c == ':') {
+        masked_ = name_.size() < max_name_bytes && redacted(name_);
+        value_.clear();
+        state_ = masked_ ? State::masked_value : State::value;
+      } else if (c == '\n') {
+        state_ = State::line_start;
+      } else if (name_.size() < max_name_bytes) {
+        name_ += c;
+      }
+      break;
+    case State::value:
+      if (c == '\n') {
+        end_header();
+        state_ = State::line_start;
+      } else if (c != '\r' && value_.size() < max_value_bytes) {
+        value_ += c;
+      }
+      break;
+    case State::masked_value:
+      if (c == '\n') state_ = State::line_start;
+      else if (c != '\r') c = '*';
+      break;
+    case State::body: {
+      std::string decoded;
+      auto result = body_.parse(data + i, data + size, decoded);
+      i = std::get<0>(result) - data - 1;
+      if (std::get<1>(result) == ParseStatus::accept) start_request();
+      else if (std::get<1>(result) == ParseStatus::reject) state_ = State::passthrough;
+      break;
+    }
+    case State::passthrough:
+      return;
+    }
+  }
+}
+
+
+// keeps headers BodyParser frames body by
+void TrafficRecorder::Redactor::end_header()
+{
+  if (!iequals(name_, "Content-Length") && !iequals(name_, "Transfer-Encoding")) return;
+  auto first = value_.find_first_not_of(" \t");
+  auto last = value_.find_last_not_of(" \t");
+  request_.headers.push_back({name_, first == std::string::npos ? "" : value_.substr(first, last + 1 - first)});
+}
+
+
+void TrafficRecorder::Redactor::end_head()
+{
+  body_ = BodyParser();
+  auto status = body_.frame(request_);
+  request_.headers.clear();
+  if (status == ParseStatus::in_progress) state_ = State::body;
+  else if (status == ParseStatus::accept) start_request();
+  else state_ = State::passthrough;
+}
+
+
+TrafficRecorder::TrafficRecorder(asio::io_service &io_service)
+    : asio::io_service::service(io_service)
+{
+}
+
+
+TrafficRecorder::~TrafficRecorder()
+{
+  close();
+}
+
+
+bool TrafficRecorder::open(const std::string &path, const TrafficRecorderOptions &options)
+{
+  close();
+  std::lock_guard<std::mutex> lock(mutex_);
+  // owner only, a log holds what clients sent, fchmod for a log that existed with wider mode
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (fd_ < 0) return false;
+  if (::fchmod(fd_, S_IRUSR | S_IWUSR) != 0) {
+    ::close(fd_);
+    fd_ = -1;
+    return false;
+  }
+
+  buffer_.reserve(buffer_bytes + buffer_bytes / 4);
+  buffer_.assign(traffic_magic, magic_bytes);
+  buffer_ += static_cast<char>(traffic_version);
+  last_at_ = Clock::now();
+  next_connection_ = 1;
+  redacted_headers_ = options.redacted_headers;
+  redactors_.clear();
+  recording_.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+
+void TrafficRecorder::close()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!recording()) return;
+  flush();
+  recording_.store(false, std::memory_order_relaxed);
+  if (fd_ >= 0) ::close(fd_);
+  fd_ = -1;
+  redactors_.clear();
+}
+
+
+std::uint64_t TrafficRecorder::opened()
+{
+  if (!recording()) return 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!recording()) return 0;
+  auto connection = next_connection_++;
+  append(TrafficRecord::Kind::open, connection);
+  if (!redacted_headers_.empty())
+    redactors_.emplace(connection, std::unique_ptr<Redactor>(new Redactor(redacted_headers_)));
+  return connection;
+}
+
+
+void TrafficRecorder::received(std::uint64_t connection, const char *data, std::size_t size)
+{
+  if (!recording()) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!recording()) return;
+  append(TrafficRecord::Kind::data, connection);
+  append_varint(buffer_, size);
+  auto at = buffer_.size();
+  buffer_.append(data, size);
+  auto redactor = redactors_.find(connection);
+  if (redactor != redactors_.end()) redactor->second->redact(&buffer_[at], size);
+  if (buffer_.size() >= buffer_bytes) flush();
+}
+
+
+void TrafficRecorder::closed(std::uint64_t connection)
+{
+  if (!recording()) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!recording()) return;
+  append(TrafficRecord::Kind::close, connection);
+  redactors_.erase(connection);
+  if (buffer_.size() >= buffer_bytes) flush();
+}
+
+
+void TrafficRecorder::append(TrafficRecord::Kind kind, std::uint64_t connection)
+{
+  auto now = Clock::now();
+  auto delta = std::chrono::duration_cast<std::chrono::microseconds>(now - last_at_);
+  // rounds down, carrying the rest over to next record, so timestamps do not drift
+  last_at_ += delta;
+  buffer_ += static_cast<char>(kind);
+  append_varint(buffer_, delta.count());
+  append_varint(buffer_, connection);
+}
+
+
+void TrafficRecorder::flush()
+{
+  std::size_t written = 0;
+  while (written < buffer_.size()) {
+    auto n = ::write(fd_, buffer_.data() + written, buffer_.size() - written);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      // recording stops, log ends in a record cut short which the reader stops at
+      recording_.store(false, std::memory_order_relaxed);
+      ::close(fd_);
+      fd_ = -1;
+      redactors_.clear();
+      break;
+    }
+    written += n;
+  }
+  buffer_.clear();
+}
+
+
+TrafficReader::TrafficReader(const std::string &path)
+    : in_(path, std::ios::binary)
+{
+  char header[magic_bytes + 1];
+  good_ = in_.read(header, sizeof(header)) &&
+          std::memcmp(header, traffic_magic, magic_bytes) == 0 &&
+          static_cast<std::uint8_t>(header[magic_bytes]) == traffic_version;
+}
+
+
+bool TrafficReader::next(TrafficRecord &record)
+{
+  if (!good_) return false;
+
+  char kind;
+  std::uint64_t delta, connection;
+  if (!in_.get(kind) || static_cast<std::uint8_t>(kind) > static_cast<std::uint8_t>(TrafficRecord::Kind::close) || !read_varint(delta) || !read_varint(connection))
+    return false;
+
+  record.kind = static_cast<TrafficRecord::Kind>(kind);
+  record.connection = connection;
+  record.data.clear();
+  if (record.kind == TrafficRecord::Kind::data) {
+    std::uint64_t size;
+    if (!read_varint(size) || size > max_data_bytes) return false;
+    record.data.resize(size);
+    if (!in_.read(&record.data[0], size)) return false;
+  }
+
+  at_ += std::chrono::microseconds(delta);
+  record.at = at_;
+  return true;
+}
+
+
+bool TrafficReader::read_varint(std::uint64_t &value)
+{
+  value = 0;
+  char c;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (!in_.get(c)) return false;
+    value |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+    if (!(c & 0x80)) return true;
+  }
+  return false;
+}
+
+} // namespace Theros
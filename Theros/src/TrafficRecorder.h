@@ -0,0 +1,134 @@
+#ifndef __TRAFFIC_RECORDER_H__
+#define __TRAFFIC_RECORDER_H__
+
+#include "asio.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Theros
+{
+
+/**
+ * @brief   Traffic log, raw inbound bytes of connections with timestamps, compact binary
+ *
+ *          "THTRAFFIC" version, then records until end of file
+ *              kind        1 byte, see TrafficRecord::Kind
+ *              delta       varint, microseconds since previous record
+ *              connection  varint, ids start at 1 in order connections are opened
+ *              size, data  varint then bytes, of data records only
+ *
+ *          -- varints are LEB128, 7 bits per byte, low bits first
+ *          -- bytes are as Connection read them, i.e. decrypted for TLS, so a log holds
+ *             request bodies and, unless redacted, credentials in clear
+ */
+struct TrafficRecord {
+  enum class Kind : std::uint8_t { open = 0, data = 1, close = 2 };
+
+  Kind kind;
+  std::chrono::microseconds at;     // since start of recording
+  std::uint64_t connection;
+  std::string data;
+};
+
+constexpr char traffic_magic[] = "THTRAFFIC";
+constexpr std::uint8_t traffic_version = 1;
+
+struct TrafficRecorderOptions {
+  // values of these request headers are masked with '*', byte for byte, before they are buffered,
+  // empty records them as read
+  std::vector<std::string> redacted_headers = {"Authorization", "Cookie", "Proxy-Authorization"};
+};
+
+
+/**
+ * @brief   Records traffic of Connections into a log, an io_service service, one per io_service
+ *
+ *          server.recorder().open("traffic.log");   // before run()
+ *          ./bin/replay traffic.log --port=8888
+ *
+ *          -- a log is a copy of what clients sent, bodies included, it is created readable
+ *             by its owner only (0600) and credentials are masked by default, see
+ *             TrafficRecorderOptions, keep it out of places others can read
+ *          -- nothing is recorded, and nothing is locked, until open()
+ *          -- records are buffered and written in blocks of buffer_bytes, and on close(),
+ *             a log cut short by a crash ends at its last whole record
+ */
+class TrafficRecorder : public asio::io_service::service
+{
+public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr std::size_t buffer_bytes = 1 << 16;
+
+  static asio::io_service::id id;
+
+  explicit TrafficRecorder(asio::io_service &io_service);
+  ~TrafficRecorder();
+
+  /** Starts recording into path, truncating it, false if it cannot be written */
+  bool open(const std::string &path, const TrafficRecorderOptions &options = TrafficRecorderOptions());
+  /** Stops recording, flushing buffered records */
+  void close();
+  bool recording() const { return recording_.load(std::memory_order_relaxed); }
+
+  /** Id of a newly accepted connection, 0 if not recording */
+  std::uint64_t opened();
+  /** Bytes read from connection, an id returned by opened() */
+  void received(std::uint64_t connection, const char *data, std::size_t size);
+  void closed(std::uint64_t connection);
+
+  void shutdown_service() { close(); }
+
+private:
+  class Redactor;
+
+  std::atomic<bool> recording_{false};
+  std::mutex mutex_;
+  int fd_ = -1;
+  std::string buffer_;
+  Clock::time_point last_at_;
+  std::uint64_t next_connection_ = 1;
+  std::vector<std::string> redacted_headers_;
+  std::unordered_map<std::uint64_t, std::unique_ptr<Redactor>> redactors_;   // by connection
+
+  // appends header of a record, timestamped now, mutex_ held
+  void append(TrafficRecord::Kind kind, std::uint64_t connection);
+  void flush();
+};
+
+
+/**
+ * @brief   Reads back a log written by TrafficRecorder
+ *
+ *          TrafficReader reader("traffic.log");
+ *          TrafficRecord record;
+ *          while (reader.next(record)) ...
+ */
+class TrafficReader
+{
+public:
+  explicit TrafficReader(const std::string &path);
+
+  /** File is open and starts with a header of a known version */
+  bool good() const { return good_; }
+
+  /** Next record, false at end of log, or at a record cut short */
+  bool next(TrafficRecord &record);
+
+private:
+  std::ifstream in_;
+  bool good_ = false;
+  std::chrono::microseconds at_{0};
+
+  bool read_varint(std::uint64_t &value);
+};
+
+} // namespace Theros
+#endif // __TRAFFIC_RECORDER_H__
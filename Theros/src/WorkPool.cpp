@@ -0,0 +1,155 @@
+#include <algorithm>
+
+#include "WorkPool.h"
+
+namespace Theros
+{
+
+asio::io_service::id WorkPool::id;
+
+namespace
+{
+// worker currently running on this thread, to keep tasks it submits on its own deque
+thread_local const WorkPool *current_pool = nullptr;
+thread_local std::size_t current_worker = 0;
+}
+
+
+WorkPool::WorkPool(asio::io_service &io_service)
+    : asio::io_service::service(io_service)
+{
+}
+
+
+WorkPool::~WorkPool()
+{
+    shutdown_service();
+}
+
+
+bool WorkPool::configure(const Options &options)
+{
+    std::lock_guard<std::mutex> lock(start_mutex_);
+    if (started_) return false;
+    options_ = options;
+    return true;
+}
+
+
+void WorkPool::start()
+{
+    std::lock_guard<std::mutex> lock(start_mutex_);
+    if (started_) return;
+
+    std::size_t count = options_.threads ? options_.threads : std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t i = 0; i < count; ++i)
+        workers_.push_back(std::make_unique<Worker>());
+    for (std::size_t i = 0; i < count; ++i)
+        threads_.emplace_back([this, i]() { run_worker(i); });
+    started_ = true;
+}
+
+
+bool WorkPool::submit(Task task)
+{
+    if (!started_) start();
+    if (stopped_) return false;
+
+    if (queued_.fetch_add(1) >= options_.max_queued) {
+        --queued_;
+        ++rejected_;
+        return false;
+    }
+
+    std::size_t index = in_worker() ? current_worker : next_++ % workers_.size();
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->deque.push_back({std::move(task), Clock::now()});
+    }
+    // taking sleep_mutex_ orders this wake up after a worker that found nothing starts to wait
+    { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+    wake_.notify_one();
+    return true;
+}
+
+
+bool WorkPool::in_worker() const
+{
+    return current_pool == this;
+}
+
+
+bool WorkPool::take(std::size_t index, Item &item)
+{
+    {
+        auto &own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.deque.empty()) {
+            item = std::move(own.deque.front());
+            own.deque.pop_front();
+            --queued_;
+            return true;
+        }
+    }
+
+    // steal from back, away from where victim takes its own
+    for (std::size_t i = 1; i < workers_.size(); ++i) {
+        auto &victim = *workers_[(index + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.deque.empty()) {
+            item = std::move(victim.deque.back());
+            victim.deque.pop_back();
+            --queued_;
+            ++stolen_;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void WorkPool::run_worker(std::size_t index)
+{
+    current_pool = this;
+    current_worker = index;
+
+    while (!stopped_) {
+        Item item;
+        if (!take(index, item)) {
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wake_.wait(lock, [this]() { return stopped_ || queued_ > 0; });
+            continue;
+        }
+
+        auto waited = Clock::now() - item.queued_at;
+        queue_time_total_ += waited.count();
+        auto max = queue_time_max_.load();
+        while (waited.count() > max && !queue_time_max_.compare_exchange_weak(max, waited.count())) { }
+        if (options_.on_queue_time) options_.on_queue_time(waited);
+
+        item.task();
+        ++executed_;
+    }
+}
+
+
+auto WorkPool::stats() const -> Stats
+{
+    return {executed_, rejected_, stolen_, queued_,
+            Clock::duration(queue_time_total_.load()), Clock::duration(queue_time_max_.load())};
+}
+
+
+void WorkPool::shutdown_service()
+{
+    if (stopped_.exchange(true)) return;
+    { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+    wake_.notify_all();
+    for (auto &thread : threads_)
+        thread.join();
+    threads_.clear();
+    for (auto &worker : workers_)
+        worker->deque.clear();
+}
+
+} // namespace Theros
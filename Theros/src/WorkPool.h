@@ -0,0 +1,112 @@
+#ifndef __WORKPOOL_H__
+#define __WORKPOOL_H__
+
+#include "asio.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Theros
+{
+
+struct WorkPoolOptions {
+    using QueueTimeFunc = std::function<void(std::chrono::steady_clock::duration)>;
+
+    std::size_t threads = 0;            // 0 is one per hardware thread
+    std::size_t max_queued = 1024;      // submit() fails once this many tasks wait for a thread
+    QueueTimeFunc on_queue_time;        // called by worker with time each task waited, before running it
+};
+
+/**
+ * @brief   Work-stealing thread pool for work that must not run on the io_service thread,
+ *          an io_service service, one per io_service
+ *
+ *          auto &pool = asio::use_service<WorkPool>(io_service);
+ *          pool.configure(options);      // optional, before first submit
+ *          pool.submit([]() { ... });
+ *
+ *          -- each worker owns a deque, tasks submitted from a worker go to its own deque,
+ *             others are spread round robin
+ *          -- an idle worker takes from front of own deque, then steals from back of others
+ *          -- threads start on first submit
+ *
+ *          Tasks run on worker threads, results are handed back with io_service::post
+ */
+class WorkPool : public asio::io_service::service
+{
+public:
+    using Options = WorkPoolOptions;
+    using Task = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        std::uint64_t executed;
+        std::uint64_t rejected;             // submit() over max_queued
+        std::uint64_t stolen;               // tasks run by a worker other than the one queued on
+        std::size_t   queued;
+        Clock::duration queue_time_total;   // summed over executed tasks
+        Clock::duration queue_time_max;
+    };
+
+    static asio::io_service::id id;
+
+    explicit WorkPool(asio::io_service &io_service);
+    ~WorkPool();
+
+    /** Replaces options, only before first submit, returns false afterwards */
+    bool configure(const Options &options);
+
+    /** Queues task, returns false if pool is full or shut down, task is then dropped */
+    bool submit(Task task);
+
+    /** True on a worker thread of this pool */
+    bool in_worker() const;
+
+    std::size_t threads() const { return workers_.size(); }
+    Stats stats() const;
+
+    /** Stops workers, queued tasks are dropped */
+    void shutdown_service();
+    void shutdown() { shutdown_service(); }
+
+private:
+    struct Item {
+        Task task;
+        Clock::time_point queued_at;
+    };
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Item> deque;
+    };
+
+    Options options_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::mutex start_mutex_;
+    std::atomic<bool> started_{false};
+
+    // workers with nothing to do sleep on wake_
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> stopped_{false};
+    std::atomic<std::size_t> queued_{0};
+    std::atomic<std::size_t> next_{0};      // round robin over workers
+
+    std::atomic<std::uint64_t> executed_{0}, rejected_{0}, stolen_{0};
+    std::atomic<Clock::rep> queue_time_total_{0}, queue_time_max_{0};
+
+    void start();
+    void run_worker(std::size_t index);
+    bool take(std::size_t index, Item &item);
+};
+
+} // namespace Theros
+#endif // __WORKPOOL_H__
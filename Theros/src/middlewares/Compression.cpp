@@ -0,0 +1,366 @@
+#include <zlib.h>
+
+#ifdef THEROS_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <variant>
+
+#include "Compression.h"
+#include "../utilities/StrUtils.h"
+
+namespace Theros
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+enum class Coding { gzip = 0, deflate, br, unsupported };
+constexpr int coding_count = 3;     // of supported codings, unsupported has no encoder
+
+Coding coding_from_string(const std::string &coding)
+{
+    if (coding == "gzip") return Coding::gzip;
+    if (coding == "deflate") return Coding::deflate;
+#ifdef THEROS_BROTLI
+    if (coding == "br") return Coding::br;
+#endif
+    return Coding::unsupported;
+}
+
+
+/**
+ * @brief   Compressor state, reset and reused across responses
+ */
+class Encoder
+{
+public:
+    virtual ~Encoder() = default;
+    /** Starts a new stream at level */
+    virtual void reset(int level) = 0;
+    /** Appends compressed data to out, flushed so far, or finished if last */
+    virtual void encode(const char *data, std::size_t size, bool last, std::string &out) = 0;
+};
+
+
+class ZlibEncoder : public Encoder
+{
+private:
+    z_stream zs_;
+    int level_;
+    bool ok_;
+public:
+    // windowBits 15 is zlib format ("deflate"), 15 + 16 is gzip format
+    ZlibEncoder(bool gzip, int level) : level_(level)
+    {
+        std::memset(&zs_, 0, sizeof(zs_));
+        ok_ = deflateInit2(&zs_, level, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~ZlibEncoder() override { if (ok_) deflateEnd(&zs_); }
+
+    void reset(int level) override
+    {
+        if (!ok_) return;
+        deflateReset(&zs_);
+        if (level != level_) {
+            deflateParams(&zs_, level, Z_DEFAULT_STRATEGY);
+            level_ = level;
+        }
+    }
+
+    void encode(const char *data, std::size_t size, bool last, std::string &out) override
+    {
+        if (!ok_ || (!last && size == 0)) return;
+
+        zs_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        zs_.avail_in = static_cast<uInt>(size);
+
+        // deflateBound is enough for all of it in one go, grow in the rare case it is not
+        std::size_t used = out.size();
+        out.resize(used + deflateBound(&zs_, size) + 16);
+        while (true) {
+            zs_.next_out = reinterpret_cast<Bytef *>(&out[used]);
+            zs_.avail_out = static_cast<uInt>(out.size() - used);
+            int ret = deflate(&zs_, last ? Z_FINISH : Z_SYNC_FLUSH);
+            used = out.size() - zs_.avail_out;
+            if (ret == Z_STREAM_ERROR || ret == Z_STREAM_END || zs_.avail_out != 0) break;
+            out.resize(out.size() + (1 << 14));
+        }
+        out.resize(used);
+    }
+};
+
+
+#ifdef THEROS_BROTLI
+class BrotliEncoder : public Encoder
+{
+private:
+    BrotliEncoderState *state_ = nullptr;
+public:
+    explicit BrotliEncoder(int level) { reset(level); }
+    ~BrotliEncoder() override { if (state_) BrotliEncoderDestroyInstance(state_); }
+
+    // brotli has no reset, a new instance is cheap compared to compressing
+    void reset(int level) override
+    {
+        if (state_) BrotliEncoderDestroyInstance(state_);
+        state_ = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        // quality 4 is about as fast as zlib level 6, and smaller
+        BrotliEncoderSetParameter(state_, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(std::max(0, level - 2)));
+    }
+
+    void encode(const char *data, std::size_t size, bool last, std::string &out) override
+    {
+        if (!state_ || (!last && size == 0)) return;
+
+        auto next_in = reinterpret_cast<const uint8_t *>(data);
+        std::size_t avail_in = size;
+        auto op = last ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH;
+        while (true) {
+            std::size_t avail_out = 0;
+            if (!BrotliEncoderCompressStream(state_, op, &avail_in, &next_in, &avail_out, nullptr, nullptr))
+                return;
+            std::size_t n = 0;
+            const uint8_t *output = BrotliEncoderTakeOutput(state_, &n);
+            out.append(reinterpret_cast<const char *>(output), n);
+            if (avail_in == 0 && !BrotliEncoderHasMoreOutput(state_) && (!last || BrotliEncoderIsFinished(state_)))
+                break;
+        }
+    }
+};
+#endif
+
+
+/**
+ * @brief   Per thread, idle encoders and how busy compression keeps the thread
+ */
+struct ThreadState {
+    static constexpr std::size_t max_idle = 4;
+    static constexpr auto window = std::chrono::milliseconds(100);
+
+    std::vector<std::unique_ptr<Encoder>> idle[coding_count];
+    Clock::time_point window_start = Clock::now();
+    Clock::duration busy{0};
+    int backoff = 0;                // levels below configured level
+};
+
+thread_local ThreadState thread_state;
+
+
+std::unique_ptr<Encoder> acquire(Coding coding, int level)
+{
+    auto &idle = thread_state.idle[static_cast<int>(coding)];
+    std::unique_ptr<Encoder> encoder;
+    if (!idle.empty()) {
+        encoder = std::move(idle.back());
+        idle.pop_back();
+        encoder->reset(level);
+        return encoder;
+    }
+
+    switch (coding) {
+        case Coding::gzip:      return std::make_unique<ZlibEncoder>(true, level);
+        case Coding::deflate:   return std::make_unique<ZlibEncoder>(false, level);
+#ifdef THEROS_BROTLI
+        case Coding::br:        return std::make_unique<BrotliEncoder>(level);
+#endif
+        default:                return nullptr;
+    }
+}
+
+void release(Coding coding, std::unique_ptr<Encoder> encoder)
+{
+    auto &idle = thread_state.idle[static_cast<int>(coding)];
+    if (encoder && idle.size() < ThreadState::max_idle)
+        idle.push_back(std::move(encoder));
+}
+
+
+/**
+ * @brief   Accounts time spent compressing, once per window adjusts backoff
+ *          by share of wall time the thread spent compressing
+ */
+void record(Clock::time_point start, const CompressionOptions &options)
+{
+    auto &state = thread_state;
+    auto now = Clock::now();
+    state.busy += now - start;
+
+    auto elapsed = now - state.window_start;
+    if (elapsed < ThreadState::window) return;
+
+    double load = std::chrono::duration<double>(state.busy).count() / std::chrono::duration<double>(elapsed).count();
+    if (load > options.busy_high && options.level - state.backoff > options.min_level)
+        ++state.backoff;
+    else if (load < options.busy_low && state.backoff > 0)
+        --state.backoff;
+
+    state.window_start = now;
+    state.busy = Clock::duration(0);
+}
+
+
+bool is_compressible(const CompressionOptions &options, const std::string &content_type)
+{
+    if (content_type.empty()) return true;
+    return std::any_of(options.types.begin(), options.types.end(), [&content_type](const std::string &type) {
+        return content_type.compare(0, type.size(), type) == 0;
+    });
+}
+
+
+void add_vary(Response &res)
+{
+    std::string vary = res.FindHeader("Vary");
+    if (vary.empty())
+        res.SetHeader({"Vary", "Accept-Encoding"});
+    else if (vary != "*" && vary.find("Accept-Encoding") == std::string::npos)
+        res.SetHeader({"Vary", vary + ", Accept-Encoding"});
+}
+
+} // namespace
+
+
+Compression::Compression(const Options &options)
+    : Handler(), options_(std::make_shared<const Options>(options))
+{
+    auto compression_handler = [options = options_](Context &ctx) {
+        std::string coding = negotiate(ctx.req.FindHeader("Accept-Encoding"));
+        ctx.on_headers([options, coding](Context &ctx) { apply(options, coding, ctx); });
+    };
+    append(compression_handler);
+}
+
+
+std::string Compression::negotiate(const std::string &accept_encoding)
+{
+#ifdef THEROS_BROTLI
+    const std::vector<std::string> supported = {"br", "gzip", "deflate"};
+#else
+    const std::vector<std::string> supported = {"gzip", "deflate"};
+#endif
+    std::vector<double> q(supported.size(), -1);   // -1, not mentioned
+    double q_any = -1;
+
+    std::size_t begin = 0;
+    while (begin < accept_encoding.size()) {
+        std::size_t end = accept_encoding.find(',', begin);
+        if (end == std::string::npos) end = accept_encoding.size();
+        std::string item = accept_encoding.substr(begin, end - begin);
+        begin = end + 1;
+
+        item.erase(std::remove(item.begin(), item.end(), ' '), item.end());
+        std::size_t semicolon = item.find(';');
+        std::string coding = item.substr(0, semicolon);
+        double value = 1;
+        if (semicolon != std::string::npos) {
+            std::size_t q_pos = item.find("q=", semicolon);
+            if (q_pos != std::string::npos)
+                value = std::atof(item.c_str() + q_pos + 2);
+        }
+
+        if (coding == "*") {
+            q_any = value;
+            continue;
+        }
+        for (std::size_t i = 0; i < supported.size(); ++i)
+            if (iequals(coding, supported[i])) q[i] = value;
+    }
+
+    std::string best;
+    double best_q = 0;
+    for (std::size_t i = 0; i < supported.size(); ++i) {
+        double value = q[i] >= 0 ? q[i] : q_any;
+        if (value > best_q) {
+            best = supported[i];
+            best_q = value;
+        }
+    }
+    return best;
+}
+
+
+std::string Compression::compress(const std::string &coding, const std::string &data, int level)
+{
+    Coding c = coding_from_string(coding);
+    if (c == Coding::unsupported)
+        throw std::invalid_argument("Compression: unsupported content-coding \"" + coding + "\"");
+    auto encoder = acquire(c, level);
+    std::string out;
+    if (!encoder) return out;
+    encoder->encode(data.data(), data.size(), true, out);
+    release(c, std::move(encoder));
+    return out;
+}
+
+
+int Compression::current_level(const Options &options)
+{
+    return std::max(options.min_level, options.level - thread_state.backoff);
+}
+
+
+void Compression::apply(std::shared_ptr<const Options> options_ptr, const std::string &coding, Context &ctx)
+{
+    const Options &options = *options_ptr;
+    auto &res = ctx.res;
+
+    int status = status_code_as_int(res.status_code);
+    if (ctx.req.method == RequestMethod::HEAD || status < 200 || status == 204 || status == 206 || status == 304)
+        return;
+    if (!res.FindHeader("Content-Encoding").empty() ||
+        res.FindHeader("Cache-Control").find("no-transform") != std::string::npos ||
+        !is_compressible(options, res.FindHeader("Content-Type")) ||
+        std::holds_alternative<FileBody::value_type>(res.content))
+        return;
+
+    bool streamed = ctx.stream.started() || std::holds_alternative<GeneratorBody::value_type>(res.content);
+    auto *shared = std::get_if<SharedBufferBody::value_type>(&res.content);
+    if (!streamed) {
+        std::size_t size = shared ? (*shared ? (*shared)->size() : 0) : res.body.size();
+        if (size < options.threshold) return;
+    }
+
+    // representation now depends on Accept-Encoding, whether or not this client gets it compressed
+    add_vary(res);
+    Coding c = coding_from_string(coding);
+    if (c == Coding::unsupported) return;
+
+    res.SetHeader({"Content-Encoding", coding});
+    int level = current_level(options);
+
+    if (streamed) {
+        res.RemoveHeader("Content-Length");
+
+        struct StreamState { std::unique_ptr<Encoder> encoder; };
+        auto state = std::make_shared<StreamState>();
+        state->encoder = acquire(c, level);
+
+        ctx.stream.filter([state, c, options = options_ptr](std::string &&chunk, bool last) {
+            std::string out;
+            if (!state->encoder) return out;
+            auto start = Clock::now();
+            state->encoder->encode(chunk.data(), chunk.size(), last, out);
+            record(start, *options);
+            // hand state back to this thread for reuse
+            if (last) release(c, std::move(state->encoder));
+            return out;
+        });
+        return;
+    }
+
+    auto start = Clock::now();
+    if (shared)
+        res.SetBody<SharedBufferBody>(SharedBufferBody::make(compress(coding, **shared, level)));
+    else
+        res.SetBody<DefaultBody>(compress(coding, res.body, level));
+    record(start, options);
+}
+
+} // namespace Theros
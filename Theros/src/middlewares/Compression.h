@@ -0,0 +1,69 @@
+#ifndef __COMPRESSION_H__
+#define __COMPRESSION_H__
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../Message.h"
+#include "../Router.h"
+
+namespace Theros
+{
+
+struct CompressionOptions {
+    std::size_t threshold = 1024;       // smaller bodies are sent as is
+    int level = 6;                      // zlib level, 1 fastest .. 9 smallest
+    int min_level = 1;                  // lowest level backed off to under load
+    double busy_high = 0.5;             // back off once compressing takes this share of a thread's time
+    double busy_low = 0.2;              // recover once below
+    std::vector<std::string> types = {  // Content-Type prefixes, responses without Content-Type are compressed too
+        "text/", "application/json", "application/javascript", "application/xml", "image/svg+xml"};
+};
+
+/**
+ * @brief   Compresses response bodies with gzip or deflate (and brotli, if built with THEROS_BROTLI),
+ *          as negotiated with Accept-Encoding
+ *
+ *          router.use("/", Compression());
+ *
+ *          -- runs after handlers, from Context::on_headers, so body set by any later handler is seen
+ *          -- res.body and SharedBufferBody are compressed at once, if larger than threshold
+ *          -- Context::stream and GeneratorBody are compressed chunk by chunk, flushed per chunk
+ *          -- FileBody is left alone, see StaticFiles for precompressed variants
+ *          -- compressor state is reused per thread, zlib is not initialized per request
+ *          -- level backs off towards min_level while compression keeps the thread busy
+ *
+ *          curl --http1.1 -v --compressed '127.0.0.1:8888/'
+ */
+class Compression : public Handler
+{
+public:
+    using Options = CompressionOptions;
+
+    explicit Compression(const Options &options = Options());
+
+    /**
+     * @brief   Picks content-coding from Accept-Encoding, highest q-value wins,
+     *          br over gzip over deflate on ties, empty if none is acceptable
+     */
+    static std::string negotiate(const std::string &accept_encoding);
+
+    /**
+     * @brief   One-shot compression of data with content-coding "gzip", "deflate" or "br",
+     *          throws std::invalid_argument for any other coding, or "br" if built without brotli
+     */
+    static std::string compress(const std::string &coding, const std::string &data, int level);
+
+    /** Level currently used on calling thread, after backing off under load */
+    static int current_level(const Options &options);
+
+private:
+    std::shared_ptr<const Options> options_;
+
+    static void apply(std::shared_ptr<const Options> options, const std::string &coding, Context &ctx);
+};
+
+} // namespace Theros
+#endif // __COMPRESSION_H__
@@ -19,6 +19,7 @@ namespace Theros
  *          Disregard credential
  * 
  *          Options may expand to node's cors https://www.npmjs.com/package/cors
+ *          Preflight is answered with 204 and ends chain
  * 
  * 
  *          curl --http1.1 -v -X GET -H "Origin: localhost" '127.0.0.1:8888/r'
@@ -85,6 +86,10 @@ class Cors : public Handler
                    headers.erase(headers.end() - 2, headers.end());
                ctx.res.SetHeader({"Access-Control-Allow-Headers", headers});
                ctx.res.SetHeader({"Access-Control-Max-Age", std::to_string(max_age_)});
+
+               // preflight is answered here, route handlers are not for OPTIONS
+               ctx.res.status_code = StatusCode::No_Content;
+               ctx.end();
            }
        };
 
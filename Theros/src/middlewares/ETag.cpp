@@ -0,0 +1,107 @@
+#include <cstdio>
+#include <ctime>
+#include <variant>
+
+#include "ETag.h"
+#include "../utilities/Codec.h"
+#include "../utilities/StrUtils.h"
+
+namespace Theros
+{
+
+ETag::ETag(const Options &options)
+    : Handler(), options_(std::make_shared<const Options>(options))
+{
+    auto etag_handler = [options = options_](Context &ctx) {
+        if (ctx.req.method != RequestMethod::GET && ctx.req.method != RequestMethod::HEAD)
+            return;
+        ctx.on_headers([options](Context &ctx) { apply(*options, ctx); });
+    };
+    append(etag_handler);
+}
+
+
+std::string ETag::compute(const std::string &body, ETagHash hash)
+{
+    if (hash == ETagHash::sha256)
+        return "\"" + SHA256Codec().digest(body) + "\"";
+
+    char etag[24];
+    std::snprintf(etag, sizeof(etag), "\"%016llx\"",
+                  static_cast<unsigned long long>(XXH64Codec::digest(body)));
+    return etag;
+}
+
+
+/** Opaque part of entity tag, weak prefix dropped, for weak comparison */
+static std::string opaque_tag(std::string tag)
+{
+    tag.erase(0, tag.find_first_not_of(' '));
+    tag.erase(tag.find_last_not_of(' ') + 1);
+    if (tag.compare(0, 2, "W/") == 0) tag.erase(0, 2);
+    return tag;
+}
+
+
+bool ETag::not_modified(Request &req, const std::string &etag, const std::string &last_modified)
+{
+    if (req.method != RequestMethod::GET && req.method != RequestMethod::HEAD)
+        return false;
+
+    std::string if_none_match = req.FindHeader("If-None-Match");
+    if (!if_none_match.empty()) {
+        if (opaque_tag(if_none_match) == "*") return true;
+        if (etag.empty()) return false;
+
+        std::string current = opaque_tag(etag);
+        std::size_t begin = 0;
+        while (begin < if_none_match.size()) {
+            std::size_t end = if_none_match.find(',', begin);
+            if (end == std::string::npos) end = if_none_match.size();
+            if (opaque_tag(if_none_match.substr(begin, end - begin)) == current) return true;
+            begin = end + 1;
+        }
+        return false;
+    }
+
+    if (last_modified.empty()) return false;
+    std::time_t since = parse_http_date(req.FindHeader("If-Modified-Since"));
+    std::time_t modified = parse_http_date(last_modified);
+    return since >= 0 && modified >= 0 && modified <= since;
+}
+
+
+void ETag::to_not_modified(Response &res)
+{
+    res.status_code = StatusCode::Not_Modified;
+    res.content = std::monostate();
+    res.body.clear();
+    res.RemoveHeader("Content-Length");
+}
+
+
+void ETag::apply(const Options &options, Context &ctx)
+{
+    auto &res = ctx.res;
+    if (res.status_code != StatusCode::OK || ctx.stream.started())
+        return;
+
+    std::string etag = res.FindHeader("ETag");
+    if (etag.empty() && ctx.req.method == RequestMethod::GET) {
+        const std::string *body = nullptr;
+        if (std::holds_alternative<std::monostate>(res.content)) {
+            body = &res.body;
+        } else if (auto *shared = std::get_if<SharedBufferBody::value_type>(&res.content)) {
+            if (*shared) body = shared->get();
+        }
+        if (body && body->size() <= options.max_bytes) {
+            etag = compute(*body, options.hash);
+            res.SetHeader({"ETag", etag});
+        }
+    }
+
+    if (not_modified(ctx.req, etag, res.FindHeader("Last-Modified")))
+        to_not_modified(res);
+}
+
+} // namespace Theros
@@ -0,0 +1,65 @@
+#ifndef __ETAG_H__
+#define __ETAG_H__
+
+#include <memory>
+#include <string>
+
+#include "../Message.h"
+#include "../Router.h"
+
+namespace Theros
+{
+
+enum class ETagHash {
+    xxh64,      // XXH64Codec, fast, 16 hex digits
+    sha256,     // SHA256Codec, 64 hex digits, when tags must not be forgeable
+};
+
+struct ETagOptions {
+    ETagHash hash = ETagHash::xxh64;
+    std::size_t max_bytes = 8 << 20;    // larger bodies are sent without ETag
+};
+
+/**
+ * @brief   Adds strong ETags to responses, and answers conditional GET with 304 Not Modified
+ *
+ *          router.use("/", ResponseCache());
+ *          router.use("/", ETag());
+ *          router.use("/", Compression());
+ *
+ *          -- runs after handlers, from Context::on_headers, body is hashed as sent,
+ *             i.e. after middlewares registered later, so each content-coding gets its own tag
+ *          -- ETag or Last-Modified set by handlers are kept, and validated against
+ *          -- If-None-Match takes precedence over If-Modified-Since
+ *          -- only 200 responses to GET, with res.body or SharedBufferBody, are hashed,
+ *             HEAD has no body to hash, it is validated against tags set by handlers
+ *          -- 304 keeps headers, drops body and Content-Length
+ */
+class ETag : public Handler
+{
+public:
+    using Options = ETagOptions;
+
+    explicit ETag(const Options &options = Options());
+
+    /** Strong entity tag of body, quoted */
+    static std::string compute(const std::string &body, ETagHash hash = ETagHash::xxh64);
+
+    /**
+     * @brief   Evaluates If-None-Match, or If-Modified-Since if absent, of a GET or HEAD request
+     *          against validators of selected representation, either may be empty
+     *          Returns true if client's copy is current, i.e. response should be 304
+     */
+    static bool not_modified(Request &req, const std::string &etag, const std::string &last_modified);
+
+    /** Turns res into a 304, keeping headers except Content-Length */
+    static void to_not_modified(Response &res);
+
+private:
+    std::shared_ptr<const Options> options_;
+
+    static void apply(const Options &options, Context &ctx);
+};
+
+} // namespace Theros
+#endif // __ETAG_H__
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <functional>
+#include <variant>
+
+#include "ResponseCache.h"
+#include "ETag.h"
+
+namespace Theros
+{
+
+ResponseCache::State::State(const Options &options) : options(options)
+{
+    std::size_t count = std::max<std::size_t>(1, options.shards);
+    for (std::size_t i = 0; i < count; ++i)
+        shards.push_back(std::make_unique<Shard>(options.max_bytes / count));
+}
+
+
+auto ResponseCache::State::shard(const std::string &key) -> Shard &
+{
+    return *shards[std::hash<std::string>()(key) % shards.size()];
+}
+
+
+ResponseCache::ResponseCache(const Options &options)
+    : Handler(), state_(std::make_shared<State>(options))
+{
+    auto response_cache_handler = [state = state_](Context &ctx) {
+        // credentials may personalize response, names are matched case insensitively by FindHeader
+        if (ctx.req.method != RequestMethod::GET ||
+            !ctx.req.FindHeader("Authorization").empty() || !ctx.req.FindHeader("Cookie").empty())
+            return;
+
+        std::string key = ResponseCache::key(ctx.req);
+        if (lookup(*state, key, ctx)) {
+            ctx.end();
+            return;
+        }
+        ctx.on_headers([state, key](Context &ctx) { store(*state, key, ctx); });
+    };
+    append(response_cache_handler);
+}
+
+
+std::string ResponseCache::normalize_query(const std::string &query)
+{
+    std::vector<std::string> params;
+    std::size_t begin = 0;
+    while (begin <= query.size()) {
+        std::size_t end = query.find('&', begin);
+        if (end == std::string::npos) end = query.size();
+        if (end > begin) params.push_back(query.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    std::sort(params.begin(), params.end());
+
+    std::string normalized;
+    for (const auto &param : params) {
+        if (!normalized.empty()) normalized += '&';
+        normalized += param;
+    }
+    return normalized;
+}
+
+
+std::string ResponseCache::key(const Request &req)
+{
+    return request_method_as_string(req.method) + " " + req.uri.abs_path + "?" + normalize_query(req.uri.query);
+}
+
+
+bool ResponseCache::lookup(State &state, const std::string &key, Context &ctx)
+{
+    std::shared_ptr<const Entry> entry;
+    {
+        Shard &shard = state.shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.lru.get(key);
+        if (found) {
+            if ((*found)->expires > std::chrono::steady_clock::now())
+                entry = *found;
+            else
+                shard.lru.erase(key);
+        }
+    }
+
+    bool hit = entry && std::all_of(entry->vary.begin(), entry->vary.end(), [&ctx](const auto &header) {
+        return ctx.req.FindHeader(header.first) == header.second;
+    });
+    if (!hit) {
+        ++state.misses;
+        return false;
+    }
+
+    ++state.hits;
+    bool not_modified = entry->not_modified && ETag::not_modified(ctx.req, entry->etag, entry->last_modified);
+    // status line follows version of this request, not of the one that filled the entry
+    ctx.res.status_code = not_modified ? StatusCode::Not_Modified : StatusCode::OK;
+    ctx.res.SetBody<SerializedBody>({not_modified ? entry->not_modified : entry->payload, ctx.res.StatusLine()});
+    return true;
+}
+
+
+/** Splits comma separated header value, blanks trimmed */
+static std::vector<std::string> split_list(const std::string &value)
+{
+    std::vector<std::string> items;
+    std::size_t begin = 0;
+    while (begin < value.size()) {
+        std::size_t end = value.find(',', begin);
+        if (end == std::string::npos) end = value.size();
+        std::string item = value.substr(begin, end - begin);
+        item.erase(0, item.find_first_not_of(' '));
+        item.erase(item.find_last_not_of(' ') + 1);
+        if (!item.empty()) items.push_back(item);
+        begin = end + 1;
+    }
+    return items;
+}
+
+
+void ResponseCache::store(State &state, const std::string &key, Context &ctx)
+{
+    auto &res = ctx.res;
+    if (res.status_code != StatusCode::OK || ctx.stream.started() || !res.FindHeader("Set-Cookie").empty())
+        return;
+
+    std::string cache_control = res.FindHeader("Cache-Control");
+    if (cache_control.find("no-store") != std::string::npos ||
+        cache_control.find("no-cache") != std::string::npos ||
+        cache_control.find("private") != std::string::npos)
+        return;
+
+    const std::string *body = nullptr;
+    if (std::holds_alternative<std::monostate>(res.content)) {
+        body = &res.body;
+    } else if (auto *shared = std::get_if<SharedBufferBody::value_type>(&res.content)) {
+        if (*shared) body = shared->get();
+    }
+    if (!body) return;
+
+    auto entry = std::make_shared<Entry>();
+    for (const auto &name : split_list(res.FindHeader("Vary"))) {
+        if (name == "*") return;
+        entry->vary.push_back({name, ctx.req.FindHeader(name)});
+    }
+
+    std::string payload = res.HeaderLine();
+    if (payload.size() + body->size() > state.options.max_entry_bytes)
+        return;
+    payload += *body;
+
+    entry->payload = std::make_shared<const std::string>(std::move(payload));
+    entry->etag = res.FindHeader("ETag");
+    entry->last_modified = res.FindHeader("Last-Modified");
+    if (!entry->etag.empty() || !entry->last_modified.empty()) {
+        Response not_modified;
+        not_modified.version = res.version;
+        not_modified.headers = res.headers;
+        ETag::to_not_modified(not_modified);
+        entry->not_modified = std::make_shared<const std::string>(not_modified.HeaderLine());
+    }
+    entry->expires = std::chrono::steady_clock::now() + state.options.ttl;
+    std::size_t cost = entry->payload->size() + key.size() + (entry->not_modified ? entry->not_modified->size() : 0);
+
+    Shard &shard = state.shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.lru.put(key, std::move(entry), cost);
+    ++state.stores;
+}
+
+
+auto ResponseCache::stats() const -> Stats
+{
+    Stats stats{state_->hits, state_->misses, state_->stores, 0, 0};
+    for (auto &shard : state_->shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.entries += shard->lru.size();
+        stats.bytes += shard->lru.cost();
+    }
+    return stats;
+}
+
+
+void ResponseCache::clear()
+{
+    for (auto &shard : state_->shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->lru.clear();
+    }
+}
+
+} // namespace Theros
@@ -0,0 +1,100 @@
+#ifndef __RESPONSECACHE_H__
+#define __RESPONSECACHE_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../Message.h"
+#include "../Router.h"
+#include "../utilities/LruCache.h"
+
+namespace Theros
+{
+
+struct ResponseCacheOptions {
+    std::chrono::milliseconds ttl{1000};    // entries are served for this long after being stored
+    std::size_t max_bytes = 64 << 20;       // budget of serialized responses, over all shards
+    std::size_t max_entry_bytes = 1 << 20;  // larger responses are not cached
+    std::size_t shards = 16;                // independent LRUs, each with its own lock
+};
+
+/**
+ * @brief   Caches GET responses, keyed by method + abs_path + query with parameters sorted
+ *
+ *          router.use("/api", ResponseCache());
+ *
+ *          -- a hit sets a SerializedBody, sent in a single write, and ends the chain
+ *          -- a miss stores the response once handlers are done, from Context::on_headers
+ *          -- only 200 responses with res.body or SharedBufferBody, without Set-Cookie,
+ *             Cache-Control no-store / no-cache / private, are stored
+ *          -- request headers named by Vary must match for a hit
+ *          -- a hit whose ETag / Last-Modified match request's validators is answered with 304
+ *          -- requests with Authorization or Cookie are neither served from nor stored into cache
+ *          -- entries live in sharded LRUs bounded by bytes, expire after ttl
+ *
+ *          Register before middlewares whose output should be cached, e.g. Compression,
+ *          their headers hooks then run before the response is stored, and are skipped on a hit
+ *
+ *          router.use("/", ResponseCache());
+ *          router.use("/", Compression());
+ */
+class ResponseCache : public Handler
+{
+public:
+    using Options = ResponseCacheOptions;
+
+    struct Entry {
+        std::shared_ptr<const std::string> payload;    // headers and body, status line is built per hit
+        std::shared_ptr<const std::string> not_modified;   // headers of 304 to conditional GET, if stored response has validators
+        std::string etag;
+        std::string last_modified;
+        std::chrono::steady_clock::time_point expires;
+        std::vector<std::pair<std::string, std::string>> vary;     // request headers at store time
+    };
+
+    struct Stats {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t stores;
+        std::size_t   entries;
+        std::size_t   bytes;
+    };
+private:
+    struct Shard {
+        std::mutex mutex;
+        LruCache<std::string, std::shared_ptr<const Entry>> lru;
+        explicit Shard(std::size_t capacity) : lru(capacity) { }
+    };
+    struct State {
+        Options options;
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::atomic<std::uint64_t> hits{0}, misses{0}, stores{0};
+        explicit State(const Options &options);
+        Shard &shard(const std::string &key);
+    };
+    std::shared_ptr<State> state_;
+public:
+    explicit ResponseCache(const Options &options = Options());
+
+    /** Cache key of request */
+    static std::string key(const Request &req);
+
+    /** Query parameters sorted, so that order does not split entries, empty parameters dropped */
+    static std::string normalize_query(const std::string &query);
+
+    Stats stats() const;
+    void clear();
+
+private:
+    static bool lookup(State &state, const std::string &key, Context &ctx);
+    static void store(State &state, const std::string &key, Context &ctx);
+};
+
+} // namespace Theros
+#endif // __RESPONSECACHE_H__
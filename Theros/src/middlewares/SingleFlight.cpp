@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <variant>
+
+#include "SingleFlight.h"
+#include "ResponseCache.h"
+
+namespace Theros
+{
+
+/**
+ * @brief   Held by leader's headers hook, releases waiters with leader's response if it can be shared,
+ *          or with nothing if not, or if hook is dropped without running, e.g. connection closed
+ */
+struct SingleFlight::Leader {
+    std::shared_ptr<State> state;
+    std::string key;
+    bool published = false;
+
+    void publish(std::shared_ptr<const Response> response)
+    {
+        published = true;
+        state->publish(key, std::move(response));
+    }
+    ~Leader() { if (!published) state->publish(key, nullptr); }
+};
+
+
+/** Busy answer to a duplicate that gave up waiting for leader */
+static void service_unavailable(Context &ctx)
+{
+    ctx.res.status_code = StatusCode::Service_Unavailable;
+    ctx.res.SetBody<DefaultBody>("");
+    ctx.res.SetHeader({"Retry-After", "1"});
+}
+
+
+/**
+ * @brief   True if leader's response can be handed to other clients, i.e. a complete 200
+ *          that is not personalized, as opposed to a 206 / 304 answering leader's own
+ *          conditional or range request, a Set-Cookie, or private / no-store
+ */
+static bool shareable(Context &ctx)
+{
+    auto &res = ctx.res;
+    if (res.status_code != StatusCode::OK || ctx.stream.started() ||
+        std::holds_alternative<GeneratorBody::value_type>(res.content) ||
+        std::holds_alternative<SerializedBody::value_type>(res.content) ||
+        !res.FindHeader("Set-Cookie").empty())
+        return false;
+
+    std::string cache_control = res.FindHeader("Cache-Control");
+    std::transform(cache_control.begin(), cache_control.end(), cache_control.begin(), ::tolower);
+    return cache_control.find("private") == std::string::npos &&
+           cache_control.find("no-store") == std::string::npos;
+}
+
+
+void SingleFlight::State::publish(const std::string &key, std::shared_ptr<const Response> response)
+{
+    std::shared_ptr<Flight> flight;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = flights.find(key);
+        if (found == flights.end()) return;
+        flight = std::move(found->second);
+        flights.erase(found);
+    }
+
+    for (auto &resume : flight->waiters) {
+        resume([response](Context &ctx) {
+            // nothing to share, waiter runs rest of chain itself
+            if (!response) return;
+            auto version = ctx.res.version;
+            ctx.res = *response;
+            ctx.res.version = version;
+            ctx.end();
+        });
+    }
+}
+
+
+SingleFlight::SingleFlight(const Options &options)
+    : Handler(), state_(std::make_shared<State>(options))
+{
+    if (!state_->options.key)
+        state_->options.key = by_url();
+
+    auto single_flight_handler = [state = state_](Context &ctx) {
+        std::string key = state->options.key(ctx);
+        if (key.empty()) return;
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        auto found = state->flights.find(key);
+
+        if (found == state->flights.end()) {
+            state->flights.emplace(key, std::make_shared<Flight>());
+            lock.unlock();
+            ++state->leaders;
+
+            auto leader = std::make_shared<Leader>();
+            leader->state = state;
+            leader->key = key;
+            ctx.on_headers([leader](Context &ctx) {
+                auto &res = ctx.res;
+                if (!shareable(ctx)) {
+                    leader->publish(nullptr);
+                    return;
+                }
+                // one copy of body, shared by leader and every waiter
+                if (std::holds_alternative<std::monostate>(res.content) && !res.body.empty())
+                    res.SetBody<SharedBufferBody>(SharedBufferBody::make(std::move(res.body)));
+                leader->publish(std::make_shared<const Response>(res));
+            });
+            return;
+        }
+
+        auto &waiters = found->second->waiters;
+        if (waiters.size() >= state->options.max_waiters) return;
+
+        auto wait = state->options.wait ? state->options.wait(key) : state->options.max_wait;
+        // resume is not called back synchronously, safe to hold lock
+        auto resume = ctx.suspend(wait, [state](Context &ctx) {
+            ++state->timeouts;
+            service_unavailable(ctx);
+        });
+        if (!resume) return;
+        waiters.push_back(std::move(resume));
+        ++state->coalesced;
+    };
+    append(single_flight_handler);
+}
+
+
+auto SingleFlight::by_url() -> KeyFunc
+{
+    // response to these may be personalized, or partial / 304 for this request only
+    static const char *const uncoalesced[] = {
+        "Authorization", "Cookie", "Range", "If-None-Match", "If-Modified-Since", "If-Range"
+    };
+    return [](Context &ctx) -> std::string {
+        auto method = ctx.req.method;
+        if (method != RequestMethod::GET && method != RequestMethod::HEAD)
+            return "";
+        for (auto name : uncoalesced) {
+            if (!ctx.req.FindHeader(name).empty()) return "";
+        }
+        return ResponseCache::key(ctx.req);
+    };
+}
+
+
+auto SingleFlight::by_url_and_headers(std::vector<std::string> names) -> KeyFunc
+{
+    return [url = by_url(), names = std::move(names)](Context &ctx) {
+        std::string key = url(ctx);
+        if (key.empty()) return key;
+        for (const auto &name : names)
+            key += "\n" + name + ": " + ctx.req.FindHeader(name);
+        return key;
+    };
+}
+
+
+auto SingleFlight::stats() const -> Stats
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return {state_->leaders, state_->coalesced, state_->timeouts, state_->flights.size()};
+}
+
+} // namespace Theros
@@ -0,0 +1,89 @@
+#ifndef __SINGLEFLIGHT_H__
+#define __SINGLEFLIGHT_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Message.h"
+#include "../Router.h"
+
+namespace Theros
+{
+
+struct SingleFlightOptions {
+    using KeyFunc  = std::function<std::string(Context &)>;
+    using WaitFunc = std::function<std::chrono::milliseconds(const std::string &key)>;
+
+    KeyFunc key;                                // requests with same key are coalesced, empty key is not,
+                                                // defaults to SingleFlight::by_url()
+    std::chrono::milliseconds max_wait{5000};   // duplicates get 503 after waiting this long
+    WaitFunc wait;                              // per key max_wait, overrides max_wait if set
+    std::size_t max_waiters = 1024;             // per key, further duplicates run handlers themselves
+};
+
+/**
+ * @brief   Coalesces identical concurrent requests, only first one (leader) runs handlers,
+ *          duplicates wait and are answered with a copy of leader's response
+ *
+ *          router.use("/", ResponseCache());
+ *          router.use("/", Compression());
+ *          router.use("/", SingleFlight());
+ *
+ *          -- duplicates are parked with Context::defer, no thread is blocked on them
+ *          -- leader's response is taken from Context::on_headers, middlewares registered before
+ *             see it as their own response in each waiter, e.g. Compression per Accept-Encoding
+ *          -- res.body is moved into a SharedBufferBody, so waiters share one copy of body
+ *          -- only a 200 without Set-Cookie, Cache-Control private or no-store is shared,
+ *             otherwise, e.g. streamed, or leader's connection goes away before responding,
+ *             waiters run the rest of chain themselves
+ *          -- waiters get 503 after max_wait
+ */
+class SingleFlight : public Handler
+{
+public:
+    using Options = SingleFlightOptions;
+    using KeyFunc = Options::KeyFunc;
+
+    struct Stats {
+        std::uint64_t leaders;      // requests that ran handlers for a key
+        std::uint64_t coalesced;    // requests parked behind a leader
+        std::uint64_t timeouts;     // duplicates that gave up waiting
+        std::size_t   in_flight;    // keys with a leader currently running
+    };
+private:
+    struct Flight {
+        std::vector<Context::ResumeFunc> waiters;
+    };
+    struct State {
+        Options options;
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+        std::atomic<std::uint64_t> leaders{0}, coalesced{0}, timeouts{0};
+        explicit State(const Options &options) : options(options) { }
+        void publish(const std::string &key, std::shared_ptr<const Response> response);
+    };
+    struct Leader;
+    std::shared_ptr<State> state_;
+public:
+    explicit SingleFlight(const Options &options = Options());
+
+    /**
+     * Key of method, abs_path and query with parameters sorted, GET and HEAD only,
+     * none for requests with Authorization, Cookie, Range or conditional headers
+     */
+    static KeyFunc by_url();
+    /** by_url(), and values of request headers named, e.g. {"Accept-Language"} */
+    static KeyFunc by_url_and_headers(std::vector<std::string> names);
+
+    Stats stats() const;
+};
+
+} // namespace Theros
+#endif // __SINGLEFLIGHT_H__
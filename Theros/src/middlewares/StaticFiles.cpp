@@ -0,0 +1,293 @@
+#include <fcntl.h>      // open
+#include <sys/stat.h>   // stat, fstat
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+#include "StaticFiles.h"
+#include "ETag.h"
+#include "../utilities/StrUtils.h"
+
+namespace Theros
+{
+
+StaticFiles::StaticFiles(const std::string &root, const Options &options)
+    : Handler(), state_(std::make_shared<State>(root, options))
+{
+    auto static_files_handler = [state = state_](Context &ctx) { serve(*state, ctx); };
+    append(static_files_handler);
+}
+
+
+std::string StaticFiles::resolve_path(const std::string &root, const std::string &rel, const std::string &index)
+{
+    std::string path = root;
+    std::size_t begin = 0;
+
+    while (begin <= rel.size()) {
+        std::size_t end = rel.find('/', begin);
+        if (end == std::string::npos) end = rel.size();
+        std::string segment = rel.substr(begin, end - begin);
+        begin = end + 1;
+
+        if (segment.empty() || segment == ".") continue;
+        if (segment == ".." || segment.find('\0') != std::string::npos) return "";
+        path += "/" + segment;
+    }
+
+    if (rel.empty() || rel.back() == '/')
+        path += "/" + index;
+    return path;
+}
+
+
+int StaticFiles::parse_range(const std::string &range, std::size_t size, std::size_t &first, std::size_t &last)
+{
+    constexpr char unit[] = "bytes=";
+    if (range.compare(0, sizeof(unit) - 1, unit) != 0) return -1;
+    std::string spec = range.substr(sizeof(unit) - 1);
+    if (spec.find(',') != std::string::npos) return -1;
+
+    std::size_t dash = spec.find('-');
+    if (dash == std::string::npos) return -1;
+    std::string first_s = spec.substr(0, dash), last_s = spec.substr(dash + 1);
+
+    auto to_size = [](const std::string &s, std::size_t &n) {
+        if (s.empty() || s.size() > 19) return false;
+        n = 0;
+        for (char c : s) {
+            if (c < '0' || c > '9') return false;
+            n = n * 10 + (c - '0');
+        }
+        return true;
+    };
+
+    if (first_s.empty()) {
+        // suffix range, last n bytes
+        std::size_t suffix;
+        if (!to_size(last_s, suffix)) return -1;
+        if (suffix == 0 || size == 0) return 0;
+        first = size - std::min(suffix, size);
+        last = size - 1;
+        return 1;
+    }
+
+    if (!to_size(first_s, first)) return -1;
+    if (last_s.empty()) {
+        last = size - 1;
+    } else {
+        if (!to_size(last_s, last) || last < first) return -1;
+        last = std::min(last, size - 1);
+    }
+    return first < size ? 1 : 0;
+}
+
+
+std::string StaticFiles::content_type(const std::string &path)
+{
+    static const std::unordered_map<std::string, std::string> mime_types = {
+        {"html", "text/html; charset=utf-8"},
+        {"htm",  "text/html; charset=utf-8"},
+        {"css",  "text/css; charset=utf-8"},
+        {"js",   "application/javascript; charset=utf-8"},
+        {"json", "application/json"},
+        {"txt",  "text/plain; charset=utf-8"},
+        {"xml",  "application/xml"},
+        {"svg",  "image/svg+xml"},
+        {"png",  "image/png"},
+        {"jpg",  "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif",  "image/gif"},
+        {"ico",  "image/x-icon"},
+        {"webp", "image/webp"},
+        {"woff", "font/woff"},
+        {"woff2","font/woff2"},
+        {"pdf",  "application/pdf"},
+        {"wasm", "application/wasm"},
+        {"mp4",  "video/mp4"},
+    };
+
+    std::size_t dot = path.rfind('.');
+    std::size_t slash = path.rfind('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return "application/octet-stream";
+
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    auto found = mime_types.find(ext);
+    return found != mime_types.end() ? found->second : "application/octet-stream";
+}
+
+
+auto StaticFiles::load(const std::string &path, bool precompressed) -> std::shared_ptr<FileEntry>
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    auto file = std::make_shared<FileHandle>(fd);
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) return nullptr;
+
+    auto entry = std::make_shared<FileEntry>();
+    entry->file = file;
+    entry->size = static_cast<std::size_t>(st.st_size);
+    entry->mtime = st.st_mtime;
+    entry->last_modified = format_http_date(st.st_mtime);
+    entry->content_type = content_type(path);
+
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%zx-%lx\"", entry->size, static_cast<long>(st.st_mtime));
+    entry->etag = etag;
+
+    if (precompressed) {
+        int gz_fd = ::open((path + ".gz").c_str(), O_RDONLY | O_CLOEXEC);
+        if (gz_fd >= 0) {
+            auto gz_file = std::make_shared<FileHandle>(gz_fd);
+            struct stat gz_st;
+            // stale variant older than original is not served
+            if (::fstat(gz_fd, &gz_st) == 0 && S_ISREG(gz_st.st_mode) && gz_st.st_mtime >= st.st_mtime) {
+                entry->gz_file = gz_file;
+                entry->gz_size = static_cast<std::size_t>(gz_st.st_size);
+                entry->gz_etag = entry->etag.substr(0, entry->etag.size() - 1) + "-gz\"";
+            }
+        }
+    }
+
+    entry->validated = std::chrono::steady_clock::now();
+    return entry;
+}
+
+
+auto StaticFiles::lookup(State &state, const std::string &path) -> std::shared_ptr<FileEntry>
+{
+    auto now = std::chrono::steady_clock::now();
+    std::shared_ptr<FileEntry> cached;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        auto found = state.cache.get(path);
+        if (found && now - (*found)->validated < state.options.revalidate)
+            return *found;
+        if (found) cached = *found;
+    }
+
+    // stat and open run unlocked, requests racing on a stale path may each reload it
+    struct stat st;
+    if (::stat(path.c_str(), &st) < 0 || !S_ISREG(st.st_mode)) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.cache.erase(path);
+        return nullptr;
+    }
+
+    if (cached && cached->size == static_cast<std::size_t>(st.st_size) && cached->mtime == st.st_mtime) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        cached->validated = now;
+        return cached;
+    }
+
+    auto entry = load(path, state.options.precompressed);
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (entry)
+        state.cache.put(path, entry);
+    else
+        state.cache.erase(path);
+    return entry;
+}
+
+
+/** True if Accept-Encoding lists gzip (or *) without q=0 */
+static bool accepts_gzip(const std::string &accept_encoding)
+{
+    std::size_t begin = 0;
+    while (begin < accept_encoding.size()) {
+        std::size_t end = accept_encoding.find(',', begin);
+        if (end == std::string::npos) end = accept_encoding.size();
+        std::string coding = accept_encoding.substr(begin, end - begin);
+        begin = end + 1;
+
+        std::size_t semicolon = coding.find(';');
+        std::string params = (semicolon == std::string::npos) ? "" : coding.substr(semicolon);
+        coding = coding.substr(0, semicolon);
+        coding.erase(std::remove(coding.begin(), coding.end(), ' '), coding.end());
+
+        if (!iequals(coding, "gzip") && coding != "*") continue;
+        params.erase(std::remove(params.begin(), params.end(), ' '), params.end());
+        return params.compare(0, 4, ";q=0") != 0 || params.find_first_of("123456789", 4) != std::string::npos;
+    }
+    return false;
+}
+
+
+void StaticFiles::serve(State &state, Context &ctx)
+{
+    if (ctx.req.method != RequestMethod::GET && ctx.req.method != RequestMethod::HEAD)
+        return;
+
+    auto rest = ctx.param.find("*");
+    std::string path = resolve_path(state.root, rest != ctx.param.end() ? rest->second : "", state.options.index);
+
+    auto entry = path.empty() ? nullptr : lookup(state, path);
+    if (!entry) {
+        ctx.res.status_code = StatusCode::Not_Found;
+        return;
+    }
+
+    // representation is chosen first, validators and ranges below refer to it alone
+    bool gzip = entry->gz_file && accepts_gzip(ctx.req.FindHeader("Accept-Encoding"));
+    const std::string &etag = gzip ? entry->gz_etag : entry->etag;
+    FileBody::value_type body = gzip ? FileBody::value_type{entry->gz_file, 0, entry->gz_size}
+                                     : FileBody::value_type{entry->file, 0, entry->size};
+    std::size_t size = body.length;
+
+    auto &res = ctx.res;
+    res.SetHeader({"ETag", etag});
+    res.SetHeader({"Last-Modified", entry->last_modified});
+    res.SetHeader({"Accept-Ranges", "bytes"});
+    res.SetHeader({"Content-Type", entry->content_type});
+    if (!state.options.cache_control.empty())
+        res.SetHeader({"Cache-Control", state.options.cache_control});
+    if (entry->gz_file)
+        res.SetHeader({"Vary", "Accept-Encoding"});
+    if (gzip)
+        res.SetHeader({"Content-Encoding", "gzip"});
+
+    // conditional GET, If-None-Match takes precedence over If-Modified-Since
+    if (ETag::not_modified(ctx.req, etag, entry->last_modified)) {
+        res.status_code = StatusCode::Not_Modified;
+        return;
+    }
+
+    std::string range = ctx.req.FindHeader("Range");
+    std::string if_range = ctx.req.FindHeader("If-Range");
+    bool range_applies = !range.empty() &&
+        (if_range.empty() || if_range == etag || parse_http_date(if_range) == entry->mtime);
+
+    std::size_t first = 0, last = 0;
+    switch (range_applies ? parse_range(range, size, first, last) : -1) {
+        case 1: {
+            res.status_code = StatusCode::Partial_Content;
+            res.SetHeader({"Content-Range", "bytes " + std::to_string(first) + "-" + std::to_string(last) +
+                                            "/" + std::to_string(size)});
+            body.offset = static_cast<off_t>(first);
+            body.length = last - first + 1;
+            break;
+        }
+        case 0: {
+            res.status_code = StatusCode::Requested_Range_Not_Satisfiable;
+            res.SetHeader({"Content-Range", "bytes */" + std::to_string(size)});
+            res.SetBody<DefaultBody>("");
+            return;
+        }
+        default:
+            break;
+    }
+
+    if (ctx.req.method == RequestMethod::HEAD) {
+        res.SetHeader({"Content-Length", std::to_string(body.length)});
+        return;
+    }
+    res.SetBody<FileBody>(std::move(body));
+}
+
+} // namespace Theros
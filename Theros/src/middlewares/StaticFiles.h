@@ -0,0 +1,99 @@
+#ifndef __STATICFILES_H__
+#define __STATICFILES_H__
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "../Message.h"
+#include "../Router.h"
+#include "../utilities/LruCache.h"
+
+namespace Theros
+{
+
+struct StaticFilesOptions {
+    std::string index = "index.html";           // served for paths ending with /
+    std::size_t cache_entries = 1024;           // open files kept in cache
+    std::chrono::milliseconds revalidate{1000}; // cached stat is trusted for this long
+    bool precompressed = true;                  // look for .gz variants
+    std::string cache_control;                  // Cache-Control header, if not empty
+};
+
+/**
+ * @brief   Serves files under a root directory, mounted with Router::use
+ *
+ *          router.use("/static", StaticFiles("./public"));
+ *
+ *          GET /static/css/site.css  ->  ./public/css/site.css
+ *
+ *          -- path is resolved segment by segment, ".." never escapes root
+ *          -- body is a FileBody, sent with sendfile(2) on plain tcp
+ *          -- fd, stat and ETag of recently served files are kept in a LRU cache
+ *          -- single byte ranges with Range / If-Range, 206 and 416
+ *          -- If-None-Match / If-Modified-Since, 304
+ *          -- serves file.gz in place of file if client accepts gzip, under an ETag of its own,
+ *             so validators and ranges of one representation never apply to the other
+ *
+ *          curl --http1.1 -v -H "Range: bytes=0-99" '127.0.0.1:8888/static/index.html'
+ */
+class StaticFiles : public Handler
+{
+public:
+    using Options = StaticFilesOptions;
+
+    /** Cached metadata of a file, shared between requests */
+    struct FileEntry {
+        std::shared_ptr<FileHandle> file;
+        std::size_t                 size = 0;
+        std::time_t                 mtime = 0;
+        std::string                 etag;
+        std::string                 last_modified;
+        std::string                 content_type;
+        std::shared_ptr<FileHandle> gz_file;        // precompressed variant, if any
+        std::size_t                 gz_size = 0;
+        std::string                 gz_etag;        // etag of file with -gz appended
+        std::chrono::steady_clock::time_point validated;
+    };
+private:
+    struct State {
+        std::string root;
+        Options options;
+        std::mutex mutex;           // guards cache and validated of its entries, not held across syscalls
+        LruCache<std::string, std::shared_ptr<FileEntry>> cache;
+        State(const std::string &root, const Options &options)
+            : root(root), options(options), cache(options.cache_entries) { }
+    };
+    std::shared_ptr<State> state_;
+public:
+    explicit StaticFiles(const std::string &root, const Options &options = Options());
+
+    /**
+     * @brief   Maps a request path relative to mount point to a file path under root,
+     *          empty if path is malformed or tries to escape root
+     */
+    static std::string resolve_path(const std::string &root, const std::string &rel, const std::string &index);
+
+    /**
+     * @brief   Parses a single range "bytes=first-last", "bytes=first-" or "bytes=-suffix"
+     *            -- 1, satisfiable range in [first, last]
+     *            -- 0, unsatisfiable
+     *            -- -1, malformed or multiple ranges, range is to be ignored
+     */
+    static int parse_range(const std::string &range, std::size_t size, std::size_t &first, std::size_t &last);
+
+    /** Content-Type by file extension, application/octet-stream if unknown */
+    static std::string content_type(const std::string &path);
+
+private:
+    static void serve(State &state, Context &ctx);
+    static std::shared_ptr<FileEntry> lookup(State &state, const std::string &path);
+    static std::shared_ptr<FileEntry> load(const std::string &path, bool precompressed);
+};
+
+} // namespace Theros
+#endif // __STATICFILES_H__
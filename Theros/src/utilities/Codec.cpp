@@ -7,6 +7,7 @@
 #include <iomanip>  // stream manipulator 
 #include <iostream>
 #include <cassert>
+#include <cstring>  // memcpy
 
 namespace Theros
 {
@@ -91,33 +92,32 @@ std::pair<BYTE_STRING, bool> Base64Codec::decode(const BYTE_STRING input)
     if (input.size() % 4)
         return std::make_pair(decoded, false);
 
-    BYTE_STRING chunk4b;
-    chunk4b.reserve(4);
-    auto start = chunk4b.data();
+    // at most 2 trailing `=`, each stands for one byte less of output
+    std::size_t padding = 0;
+    while (padding < 2 && padding < input.size() && input[input.size() - 1 - padding] == base64_pad)
+        ++padding;
+
+    decoded.reserve(input.size() / 4 * 3);
+    BYTE chunk4b[4];
 
     auto ptr = input.begin();
     while (ptr < input.end())
     {
-        chunk4b[0] = decode_table[*ptr];
-        chunk4b[1] = decode_table[*(ptr + 1)];
-        chunk4b[2] = decode_table[*(ptr + 2)];
-        chunk4b[3] = decode_table[*(ptr + 3)];
+        for (int i = 0; i < 4; ++i)
+        {
+            chunk4b[i] = decode_table[*(ptr + i)];
+            if (chunk4b[i] == 64)
+                return std::make_pair(BYTE_STRING(), false);
+        }
 
-        decoded += dec1(start);
-        decoded += dec2(start);
-        decoded += dec3(start);
+        decoded += dec1(chunk4b);
+        decoded += dec2(chunk4b);
+        decoded += dec3(chunk4b);
 
         ptr += 4;
     }
 
-    // remove trailing whitespace
-    ptr = decoded.end();
-    while (*(ptr - 1) == 0)
-    {
-        --ptr;
-    }
-    decoded.erase(ptr, input.end());
-
+    decoded.resize(decoded.size() - padding);
     return std::make_pair(decoded, true);
 }
 
@@ -309,4 +309,90 @@ std::string SHA256Codec::get_hash()
         ss << std::setw(8) << std::setfill('0') << std::hex << hash_[i];
     return ss.str();
 }
-}
\ No newline at end of file
+
+// XXH64Codec
+
+// unaligned little endian reads, memcpy compiles to a plain load
+static inline uint64_t read64(const char *p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const char *p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint64_t XXH64Codec::digest(const std::string &message, uint64_t seed)
+{
+    return digest(message.data(), message.size(), seed);
+}
+
+uint64_t XXH64Codec::digest(const char *data, std::size_t size, uint64_t seed)
+{
+    const char *p = data;
+    const char *end = data + size;
+    uint64_t h;
+
+    if (size >= 32)
+    {
+        // 4 independent accumulators, one per 8 byte lane of a stripe
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        do
+        {
+            v1 = ROUND(v1, read64(p));
+            v2 = ROUND(v2, read64(p + 8));
+            v3 = ROUND(v3, read64(p + 16));
+            v4 = ROUND(v4, read64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+
+        h = ROTL(v1, 1) + ROTL(v2, 7) + ROTL(v3, 12) + ROTL(v4, 18);
+        h = MERGE(h, v1);
+        h = MERGE(h, v2);
+        h = MERGE(h, v3);
+        h = MERGE(h, v4);
+    }
+    else
+    {
+        h = seed + PRIME5;
+    }
+
+    h += size;
+
+    while (end - p >= 8)
+    {
+        h ^= ROUND(0, read64(p));
+        h = ROTL(h, 27) * PRIME1 + PRIME4;
+        p += 8;
+    }
+    if (end - p >= 4)
+    {
+        h ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+        h = ROTL(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    while (p < end)
+    {
+        h ^= static_cast<uint64_t>(static_cast<BYTE>(*p)) * PRIME5;
+        h = ROTL(h, 11) * PRIME1;
+        ++p;
+    }
+
+    // avalanche
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+}
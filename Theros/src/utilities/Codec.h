@@ -3,6 +3,7 @@
 
 // reference http://web.mit.edu/freebsd/head/contrib/wpa/src/utils/base64.c
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <utility>
@@ -96,5 +97,28 @@ private:
   static constexpr WORD SIGLOW1(WORD x) { return ROTR(x, 17) ^ ROTR(x, 19) ^ SHR(x, 10); }
 };
 
+// reference : https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+
+struct XXH64Codec
+{
+  /**
+   * @brief   64 bit non-cryptographic hash, consumes 32 byte stripes,
+   *          several times faster than SHA256Codec, e.g. for content fingerprints
+   */
+  static uint64_t digest(const char *data, std::size_t size, uint64_t seed = 0);
+  static uint64_t digest(const std::string &message, uint64_t seed = 0);
+
+private:
+  static constexpr uint64_t PRIME1 = 11400714785074694791ULL;
+  static constexpr uint64_t PRIME2 = 14029467366897019727ULL;
+  static constexpr uint64_t PRIME3 = 1609587929392839161ULL;
+  static constexpr uint64_t PRIME4 = 9650029242287828579ULL;
+  static constexpr uint64_t PRIME5 = 2870177450012600261ULL;
+
+  static constexpr uint64_t ROTL(uint64_t x, int n) { return (x << n) | (x >> (64 - n)); }
+  static constexpr uint64_t ROUND(uint64_t acc, uint64_t lane) { return ROTL(acc + lane * PRIME2, 31) * PRIME1; }
+  static constexpr uint64_t MERGE(uint64_t acc, uint64_t v) { return (acc ^ ROUND(0, v)) * PRIME1 + PRIME4; }
+};
+
 } // namespace Theros
 #endif // __CODEC_H__
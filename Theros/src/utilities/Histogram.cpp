@@ -0,0 +1,176 @@
+#include <algorithm>
+
+#include "Histogram.h"
+
+namespace Theros
+{
+
+const std::vector<double> &Histogram::latency_bounds()
+{
+  static const std::vector<double> bounds{
+      0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+      0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+  return bounds;
+}
+
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)),
+      counts_(new std::atomic<std::uint64_t>[bounds_.size() + 1])
+{
+  reset();
+}
+
+
+void Histogram::observe(double value)
+{
+  auto bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+  counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+  double sum = sum_.load(std::memory_order_relaxed);
+  while (!sum_.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) { }
+}
+
+
+auto Histogram::snapshot() const -> Snapshot
+{
+  Snapshot snapshot;
+  snapshot.bounds = bounds_;
+  snapshot.counts.reserve(bounds_.size() + 1);
+  for (std::size_t i = 0; i <= bounds_.size(); ++i) {
+    snapshot.counts.push_back(counts_[i].load(std::memory_order_relaxed));
+    snapshot.count += snapshot.counts.back();
+  }
+  snapshot.sum = sum_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+
+void Histogram::reset()
+{
+  for (std::size_t i = 0; i <= bounds_.size(); ++i)
+    counts_[i].store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+}
+
+
+double Histogram::Snapshot::quantile(double q) const
+{
+  if (count == 0) return 0;
+  double rank = std::max(0.0, std::min(1.0, q)) * count;
+
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < counts.size(); ++i) {
+    if (counts[i] == 0 || seen + counts[i] < rank) {
+      seen += counts[i];
+      continue;
+    }
+    // overflow bucket has no upper bound, last bound is best estimate
+    if (i == bounds.size()) return bounds.empty() ? 0 : bounds.back();
+    double lower = i == 0 ? 0 : bounds[i - 1];
+    double upper = bounds[i];
+    return lower + (upper - lower) * (rank - seen) / counts[i];
+  }
+  return bounds.empty() ? 0 : bounds.back();
+}
+
+
+
+HdrHistogram::HdrHistogram()
+    : counts_(new std::atomic<std::uint64_t>[bucket_count])
+{
+  for (std::size_t i = 0; i < bucket_count; ++i)
+    counts_[i].store(0, std::memory_order_relaxed);
+}
+
+
+std::size_t HdrHistogram::index(std::uint64_t value)
+{
+  // values below sub_buckets are exact
+  if (value < sub_buckets) return static_cast<std::size_t>(value);
+  int magnitude = 63 - __builtin_clzll(value);
+  int shift = magnitude - sub_bucket_bits;
+  auto sub = static_cast<std::size_t>(value >> shift) - sub_buckets;
+  return sub_buckets + static_cast<std::size_t>(shift) * sub_buckets + sub;
+}
+
+
+std::uint64_t HdrHistogram::lowest(std::size_t index)
+{
+  if (index < sub_buckets) return index;
+  auto shift = (index - sub_buckets) / sub_buckets;
+  auto sub = (index - sub_buckets) % sub_buckets;
+  return static_cast<std::uint64_t>(sub_buckets + sub) << shift;
+}
+
+
+std::uint64_t HdrHistogram::highest(std::size_t index)
+{
+  if (index < sub_buckets) return index;
+  auto shift = (index - sub_buckets) / sub_buckets;
+  return lowest(index) + ((std::uint64_t(1) << shift) - 1);
+}
+
+
+void HdrHistogram::record(std::uint64_t value)
+{
+  counts_[index(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  auto max = max_.load(std::memory_order_relaxed);
+  while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) { }
+}
+
+
+void HdrHistogram::add_to(Snapshot &snapshot) const
+{
+  for (std::size_t i = 0; i < bucket_count; ++i) {
+    auto n = counts_[i].load(std::memory_order_relaxed);
+    snapshot.counts[i] += n;
+    snapshot.count += n;
+  }
+  snapshot.sum += sum_.load(std::memory_order_relaxed);
+  snapshot.max = std::max(snapshot.max, max_.load(std::memory_order_relaxed));
+}
+
+
+auto HdrHistogram::snapshot() const -> Snapshot
+{
+  Snapshot snapshot;
+  add_to(snapshot);
+  return snapshot;
+}
+
+
+void HdrHistogram::Snapshot::merge(const Snapshot &other)
+{
+  for (std::size_t i = 0; i < bucket_count; ++i)
+    counts[i] += other.counts[i];
+  count += other.count;
+  sum += other.sum;
+  max = std::max(max, other.max);
+}
+
+
+std::uint64_t HdrHistogram::Snapshot::quantile(double q) const
+{
+  if (count == 0) return 0;
+  auto rank = static_cast<std::uint64_t>(std::max(0.0, std::min(1.0, q)) * count + 0.5);
+  rank = std::max<std::uint64_t>(rank, 1);
+
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < bucket_count; ++i) {
+    seen += counts[i];
+    if (seen >= rank) return std::min(highest(i), max);
+  }
+  return max;
+}
+
+
+std::uint64_t HdrHistogram::Snapshot::count_at_most(std::uint64_t value) const
+{
+  std::uint64_t n = 0;
+  for (std::size_t i = 0; i < bucket_count && highest(i) <= value; ++i)
+    n += counts[i];
+  return n;
+}
+
+} // namespace Theros
@@ -0,0 +1,96 @@
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Theros
+{
+
+/**
+ * @brief   Fixed bucket histogram, safe to observe from any thread
+ *
+ *          Buckets are given by ascending upper bounds, values over the last one go to an overflow bucket,
+ *          as with Prometheus histograms. Latencies are observed in seconds
+ */
+class Histogram
+{
+public:
+  struct Snapshot {
+    std::vector<double> bounds;
+    std::vector<std::uint64_t> counts;    // per bucket, one more than bounds for overflow
+    std::uint64_t count = 0;
+    double sum = 0;
+
+    /** Estimates q-quantile, 0 <= q <= 1, interpolating within bucket, 0 if empty */
+    double quantile(double q) const;
+  };
+
+  /** 100us to 10s, for latencies in seconds */
+  static const std::vector<double> &latency_bounds();
+
+  explicit Histogram(std::vector<double> bounds = latency_bounds());
+
+  void observe(double value);
+  Snapshot snapshot() const;
+  void reset();
+
+  const std::vector<double> &bounds() const { return bounds_; }
+
+private:
+  std::vector<double> bounds_;
+  std::unique_ptr<std::atomic<std::uint64_t>[]> counts_;
+  std::atomic<double> sum_{0};
+};
+
+
+
+/**
+ * @brief   Log-linear histogram of non-negative integers, in the manner of HdrHistogram,
+ *          safe to record from any thread
+ *
+ *          Each power of two is split into 16 linear sub-buckets, values are kept to within 1/16
+ *          of their magnitude over the whole range of std::uint64_t, recording is a couple of shifts
+ *          and one relaxed increment. Snapshots of several histograms merge by adding counts
+ */
+class HdrHistogram
+{
+public:
+  static constexpr int sub_bucket_bits = 4;
+  static constexpr std::size_t sub_buckets = std::size_t(1) << sub_bucket_bits;
+  static constexpr std::size_t bucket_count = sub_buckets + (64 - sub_bucket_bits) * sub_buckets;
+
+  struct Snapshot {
+    std::vector<std::uint64_t> counts = std::vector<std::uint64_t>(bucket_count);
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+
+    void merge(const Snapshot &other);
+    /** Highest value equivalent to q-quantile, 0 if empty */
+    std::uint64_t quantile(double q) const;
+    /** Number of values in buckets that lie at or below value */
+    std::uint64_t count_at_most(std::uint64_t value) const;
+  };
+
+  HdrHistogram();
+
+  void record(std::uint64_t value);
+  /** Adds counts to snapshot */
+  void add_to(Snapshot &snapshot) const;
+  Snapshot snapshot() const;
+
+  static std::size_t index(std::uint64_t value);
+  static std::uint64_t lowest(std::size_t index);
+  static std::uint64_t highest(std::size_t index);
+
+private:
+  std::unique_ptr<std::atomic<std::uint64_t>[]> counts_;
+  std::atomic<std::uint64_t> sum_{0};
+  std::atomic<std::uint64_t> max_{0};
+};
+
+} // namespace Theros
+#endif // __HISTOGRAM_H__
@@ -0,0 +1,107 @@
+#ifndef __LRUCACHE_H__
+#define __LRUCACHE_H__
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace Theros
+{
+
+/**
+ * @brief   Least recently used cache, bounded by total cost of entries
+ *
+ *          Cost is 1 per entry by default, i.e. capacity counts entries,
+ *          pass byte size as cost for a byte budget instead
+ *
+ * @note    Not thread safe
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache
+{
+public:
+    using KeyT          = Key;
+    using ValueT        = Value;
+    using EvictFunc     = std::function<void(const Key &, Value &)>;
+private:
+    struct Entry {
+        Key         key;
+        Value       value;
+        std::size_t cost;
+    };
+    using ListT         = std::list<Entry>;
+    using ListIterator  = typename ListT::iterator;
+
+    ListT                                       entries_;   // most recently used at front
+    std::unordered_map<Key, ListIterator, Hash> index_;
+    std::size_t                                 capacity_;
+    std::size_t                                 cost_ = 0;
+    EvictFunc                                   on_evict_;
+public:
+    explicit LruCache(std::size_t capacity) : capacity_(capacity) { }
+
+    /**
+     * @brief   Returns pointer to cached value and marks it most recently used,
+     *          nullptr if not found. Pointer is valid until next modification
+     */
+    Value *get(const Key &key)
+    {
+        auto found = index_.find(key);
+        if (found == index_.end()) return nullptr;
+        entries_.splice(entries_.begin(), entries_, found->second);
+        return &found->second->value;
+    }
+
+    /**
+     * @brief   Inserts or replaces value at key,
+     *          evicts least recently used entries until total cost fits capacity
+     */
+    Value *put(const Key &key, Value value, std::size_t cost = 1)
+    {
+        erase(key);
+        if (cost > capacity_) return nullptr;
+        entries_.push_front({key, std::move(value), cost});
+        index_[key] = entries_.begin();
+        cost_ += cost;
+        while (cost_ > capacity_) evict();
+        return &entries_.front().value;
+    }
+
+    /** Removes entry at key, no-op if not found */
+    void erase(const Key &key)
+    {
+        auto found = index_.find(key);
+        if (found == index_.end()) return;
+        cost_ -= found->second->cost;
+        entries_.erase(found->second);
+        index_.erase(found);
+    }
+
+    void clear()
+    {
+        entries_.clear();
+        index_.clear();
+        cost_ = 0;
+    }
+
+    /** Called with each entry evicted to make room, not on erase() */
+    void on_evict(EvictFunc f) { on_evict_ = std::move(f); }
+
+    std::size_t size() const { return entries_.size(); }
+    std::size_t cost() const { return cost_; }
+    std::size_t capacity() const { return capacity_; }
+private:
+    void evict()
+    {
+        Entry &last = entries_.back();
+        if (on_evict_) on_evict_(last.key, last.value);
+        cost_ -= last.cost;
+        index_.erase(last.key);
+        entries_.pop_back();
+    }
+};
+
+} // namespace Theros
+#endif // __LRUCACHE_H__
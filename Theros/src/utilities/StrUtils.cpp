@@ -1,5 +1,7 @@
-
+#include <algorithm>
 #include <cstring>
+#include <cctype>
+#include <cstdio>
 #include "StrUtils.h"
 
 
@@ -71,6 +73,44 @@ bool has_balanced_bracket(const char* s, int len)
     return stack.size() == 0;
 }
 
+bool iequals(const std::string& x, const std::string& y)
+{
+    return x.size() == y.size() &&
+        std::equal(x.begin(), x.end(), y.begin(), [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+}
+
+
+static constexpr const char* week_days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static constexpr const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                          "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+std::string format_http_date(std::time_t t)
+{
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+             week_days[tm.tm_wday], tm.tm_mday, months[tm.tm_mon], tm.tm_year + 1900,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+    return buf;
+}
+
+std::time_t parse_http_date(const std::string& s)
+{
+    struct tm tm = {};
+    char wday[4], month[4];
+    if (sscanf(s.c_str(), "%3s, %d %3s %d %d:%d:%d GMT", wday, &tm.tm_mday, month, &tm.tm_year,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 7)
+        return -1;
+    tm.tm_mon = -1;
+    for (int i = 0; i < 12; ++i)
+        if (strncmp(month, months[i], 3) == 0) tm.tm_mon = i;
+    if (tm.tm_mon < 0) return -1;
+    tm.tm_year -= 1900;
+    return timegm(&tm);
+}
+
+
 void find_route_prefix_unstrict(const char* x,
                                 const char* y,
                                 int&        x_prefix_len,
@@ -1,6 +1,7 @@
 #ifndef __STRUTILS_H__
 #define __STRUTILS_H__
 
+#include <ctime>
 #include <string>
 #include <utility>
 #include <vector>
@@ -20,6 +21,14 @@ auto split(std::string& s, char delim) -> std::pair<std::string, std::string>;
 // Check c string has balanced brackets <>, {}, []
 bool has_balanced_bracket(const char* s, int len);
 
+// Case insensitive comparison of ascii strings
+bool iequals(const std::string& x, const std::string& y);
+
+// HTTP-date in rfc1123 format, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string format_http_date(std::time_t t);
+// Parses a rfc1123 HTTP-date, -1 if malformed
+std::time_t parse_http_date(const std::string& s);
+
 
 /**
  *  Find common prefix of x, the route path, and y, the query path
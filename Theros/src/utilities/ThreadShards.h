@@ -0,0 +1,88 @@
+#ifndef __THREADSHARDS_H__
+#define __THREADSHARDS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Theros
+{
+
+/**
+ * @brief   A Shard per thread, written by its thread without contention, visited
+ *          together by readers, e.g. counters or queues of an io_service service
+ *
+ *          ThreadShards<Ring> rings_;
+ *          auto &ring = rings_.local(capacity);    // made from args on first use by a thread
+ *          rings_.for_each([](Ring &ring) { ... });
+ *
+ *          -- local() is a compare when a thread uses the same instance as last time,
+ *             a lookup in a thread_local map otherwise, keyed by an instance id which tells
+ *             shards of this apart from those of an earlier instance at same address
+ *          -- shards live as long as this, entries of thread maps are never erased
+ */
+template <typename Shard>
+class ThreadShards
+{
+private:
+    // shard of calling thread for the instance last used on it, and for every instance
+    struct ThreadCache {
+        std::uint64_t                               instance = 0;
+        Shard                                       *shard = nullptr;
+        std::unordered_map<std::uint64_t, Shard *>  shards;
+    };
+
+    std::uint64_t                       instance_;
+    mutable std::mutex                  mutex_;     // guards adding to shards_ against readers
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    static ThreadCache &thread_cache()
+    {
+        thread_local ThreadCache cache;
+        return cache;
+    }
+    static std::uint64_t next_instance()
+    {
+        static std::atomic<std::uint64_t> instances{0};
+        return ++instances;
+    }
+public:
+    ThreadShards() : instance_(next_instance()) { }
+    ThreadShards(const ThreadShards &) = delete;
+    ThreadShards &operator=(const ThreadShards &) = delete;
+
+    /** Shard of calling thread, constructed from args the first time it asks */
+    template <typename... Args>
+    Shard &local(Args &&... args)
+    {
+        auto &cache = thread_cache();
+        if (cache.instance == instance_)
+            return *cache.shard;
+
+        auto &shard = cache.shards[instance_];
+        if (!shard) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shards_.push_back(std::make_unique<Shard>(std::forward<Args>(args)...));
+            shard = shards_.back().get();
+        }
+        cache.instance = instance_;
+        cache.shard = shard;
+        return *shard;
+    }
+
+    /** Calls f with every shard, threads cannot add shards meanwhile */
+    template <typename Func>
+    void for_each(Func f) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &shard : shards_)
+            f(*shard);
+    }
+};
+
+} // namespace Theros
+#endif // __THREADSHARDS_H__
@@ -412,6 +412,10 @@ auto Trie<T, CharT, Compare, Allocator>::find(const KeyT& key, std::vector<std::
         auto range = cur_node->find_lmp_edges(kstr, kvs_tmp);
         const EdgesT& edges = cur_node->edges;
 
+        // No prefix match
+        if(range.first == edges.end())
+            return end();
+
         int edge_prefix_len = 0, query_prefix_len = 0;
         EdgesIterator& lower_bound = range.first;
         find_route_prefix_unstrict(lower_bound->prefix.c_str(), kstr, edge_prefix_len, query_prefix_len, kvs_final);
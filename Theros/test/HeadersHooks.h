@@ -0,0 +1,21 @@
+#ifndef __HEADERS_HOOKS_H__
+#define __HEADERS_HOOKS_H__
+
+#include <vector>
+
+#include "Router.h"
+
+/**
+ * @brief   Helper of tests driving middlewares without a Connection
+ */
+
+/** Runs and clears hooks registered with Context::on_headers, innermost first, as Connection does */
+inline void run_headers_hooks(Theros::Context &ctx)
+{
+    std::vector<Theros::Context::HookFunc> hooks;
+    hooks.swap(ctx.headers_hooks);
+    for (auto hook = hooks.rbegin(); hook != hooks.rend(); ++hook)
+        (*hook)(ctx);
+}
+
+#endif // __HEADERS_HOOKS_H__
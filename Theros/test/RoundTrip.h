@@ -0,0 +1,46 @@
+#ifndef __ROUND_TRIP_H__
+#define __ROUND_TRIP_H__
+
+#include "asio.hpp"
+
+#include <array>
+#include <memory>
+#include <string>
+
+#include "Connection.h"
+#include "MemorySocket.h"
+#include "Router.h"
+
+/**
+ * @brief   Helpers of tests driving a Connection over MemorySocket
+ */
+
+/** Reads from socket until eof or error, appending to out */
+inline void read_all(Theros::MemorySocket &socket, std::string &out,
+                     std::shared_ptr<std::array<char, 64>> buffer = std::make_shared<std::array<char, 64>>())
+{
+    socket.async_read_some(asio::buffer(*buffer), [&socket, &out, buffer](asio::error_code ec, std::size_t n) {
+        out.append(buffer->data(), n);
+        if (!ec) read_all(socket, out, buffer);
+    });
+}
+
+/** Sends request to a fresh Connection, returns all it wrote back before closing */
+inline std::string round_trip(Theros::Router &router, const std::string &request,
+                              const Theros::ConnectionOptions &options = Theros::ConnectionOptions())
+{
+    asio::io_service io_service;
+    auto conn = std::make_shared<Theros::Connection<Theros::MemorySocket>>(io_service, router, options);
+    Theros::MemorySocket client(io_service);
+    client.connect(conn->socket_);
+    conn->start();
+
+    std::string response;
+    asio::async_write(client, asio::buffer(request), [](asio::error_code, std::size_t) {});
+    read_all(client, response);
+    conn.reset();
+    io_service.run();
+    return response;
+}
+
+#endif // __ROUND_TRIP_H__
@@ -0,0 +1,157 @@
+#include "catch.hpp"
+#include "asio.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AccessLog.h"
+#include "Connection.h"
+#include "MemorySocket.h"
+#include "Router.h"
+
+using namespace std;
+using namespace Theros;
+
+namespace
+{
+const string log_path = "test_access.log";
+
+AccessRecord make_record(const string &path, const string &query = "")
+{
+    AccessRecord record;
+    record.time = 1792336502123000000;      // 2026-10-18T15:15:02.123Z
+    record.latency = 1500000;
+    record.bytes_in = 78;
+    record.bytes_out = 93;
+    record.status = 200;
+    record.method = RequestMethod::GET;
+    record.version = HttpVersion::one_one;
+    record.set_path(path, query);
+    record.set_peer("127.0.0.1");
+    return record;
+}
+
+vector<string> read_lines(const string &path)
+{
+    ifstream in(path);
+    vector<string> lines;
+    string line;
+    while (getline(in, line)) lines.push_back(line);
+    return lines;
+}
+}
+
+
+TEST_CASE("AccessLog formats", "[AccessLog]")
+{
+    string out;
+
+    SECTION("common")
+    {
+        AccessLog::format(out, make_record("/users/1", "tab=feed"), AccessLogFormat::common);
+        REQUIRE(out == "127.0.0.1 - - [18/Oct/2026:15:15:02 +0000] \"GET /users/1?tab=feed HTTP/1.1\" 200 93\n");
+    }
+
+    SECTION("common with latency")
+    {
+        AccessLog::format(out, make_record("/"), AccessLogFormat::common_latency);
+        REQUIRE(out == "127.0.0.1 - - [18/Oct/2026:15:15:02 +0000] \"GET / HTTP/1.1\" 200 93 0.001500\n");
+    }
+
+    SECTION("json, escaped")
+    {
+        AccessLog::format(out, make_record("/a\"b\x01"), AccessLogFormat::json);
+        REQUIRE(out == "{\"time\":\"2026-10-18T15:15:02.123Z\",\"peer\":\"127.0.0.1\",\"method\":\"GET\","
+                       "\"path\":\"/a\\\"b\\u0001\",\"status\":200,\"bytes_in\":78,\"bytes_out\":93,\"latency\":0.001500000}\n");
+        REQUIRE(JsonType::parse(out)["path"] == "/a\"b\x01");
+    }
+
+    SECTION("long path is cut")
+    {
+        auto record = make_record(string(300, 'x'));
+        REQUIRE(record.path_length == AccessRecord::path_bytes);
+    }
+}
+
+
+TEST_CASE("AccessLog", "[AccessLog]")
+{
+    asio::io_service io_service;
+    auto &log = asio::use_service<AccessLog>(io_service);
+    remove(log_path.c_str());
+
+    SECTION("records are written by close, in order")
+    {
+        REQUIRE(!log.enabled());
+        REQUIRE(log.open(log_path, AccessLogFormat::common));
+        REQUIRE(log.enabled());
+        for (int i = 0; i < 100; ++i)
+            REQUIRE(log.log(make_record("/users/" + to_string(i))));
+        log.close();
+
+        auto lines = read_lines(log_path);
+        REQUIRE(lines.size() == 100);
+        REQUIRE(lines[42].find("\"GET /users/42 HTTP/1.1\"") != string::npos);
+        REQUIRE(log.written() == 100);
+        REQUIRE(log.dropped() == 0);
+    }
+
+    SECTION("records of each thread")
+    {
+        REQUIRE(log.open(log_path, [](string &out, const AccessRecord &record) {
+            out.append(record.path, record.path_length);
+            out += '\n';
+        }));
+        vector<thread> threads;
+        for (int t = 0; t < 4; ++t)
+            threads.emplace_back([&log, t]() {
+                for (int i = 0; i < 50; ++i) log.log(make_record("/" + to_string(t)));
+            });
+        for (auto &t : threads) t.join();
+        log.close();
+        REQUIRE(read_lines(log_path).size() + log.dropped() == 200);
+    }
+
+    SECTION("full ring drops rather than blocks")
+    {
+        log.set_ring_records(3);    // rounded up to 4
+        for (int i = 0; i < 10; ++i) log.log(make_record("/"));
+        REQUIRE(log.dropped() == 6);
+
+        REQUIRE(log.open(log_path));
+        log.close();
+        REQUIRE(read_lines(log_path).size() == 4);
+    }
+
+    SECTION("Connection logs requests it routed")
+    {
+        Router router;
+        router.get("/users/<id>", [](Context &ctx) { ctx.res.SetBody<DefaultBody>("user " + ctx.param["id"]); });
+        REQUIRE(log.open(log_path, AccessLogFormat::json));
+
+        auto conn = make_shared<Connection<MemorySocket>>(io_service, router);
+        MemorySocket client(io_service);
+        client.connect(conn->socket_);
+        conn->start();
+        string request = "GET /users/42?x=1 HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        asio::async_write(client, asio::buffer(request), [](asio::error_code, size_t) {});
+        conn.reset();
+        io_service.run();
+        log.close();
+
+        auto lines = read_lines(log_path);
+        REQUIRE(lines.size() == 1);
+        auto entry = JsonType::parse(lines[0]);
+        REQUIRE(entry["path"] == "/users/42?x=1");
+        REQUIRE(entry["status"] == 200);
+        REQUIRE(entry["peer"] == "127.0.0.1");
+        REQUIRE(entry["bytes_in"] == request.size());
+    }
+
+    remove(log_path.c_str());
+}
@@ -0,0 +1,130 @@
+#include <chrono>
+#include <vector>
+#include "catch.hpp"
+
+#include "AdmissionControl.h"
+
+using namespace Theros;
+using namespace std::chrono_literals;
+
+TEST_CASE("AdmissionControl", "[AdmissionControl]")
+{
+    asio::io_service io_service;
+    auto &admission = asio::use_service<AdmissionControl>(io_service);
+    AdmissionOptions options;
+
+    SECTION("unlimited by default")
+    {
+        std::vector<AdmissionControl::Permit> permits;
+        for (int i = 0; i < 2000; ++i)
+            permits.push_back(admission.try_acquire());
+        REQUIRE(permits.back());
+        REQUIRE(admission.stats().in_flight == 2000);
+        REQUIRE(admission.stats().limit == 0);
+        permits.clear();
+        REQUIRE(admission.stats().in_flight == 0);
+    }
+
+    SECTION("connection caps")
+    {
+        options.max_connections = 3;
+        options.max_connections_per_ip = 2;
+        admission.configure(options);
+
+        auto a1 = admission.open_connection("10.0.0.1");
+        auto a2 = admission.open_connection("10.0.0.1");
+        auto a3 = admission.open_connection("10.0.0.1");
+        REQUIRE(!a1.over_limit());
+        REQUIRE(!a2.over_limit());
+        REQUIRE(a3.over_limit());
+        REQUIRE(admission.stats().rejected_connections == 1);
+        REQUIRE(!admission.accepting());
+
+        int resumed = 0;
+        admission.when_accepting([&]() { ++resumed; });
+        REQUIRE(admission.stats().accept_pauses == 1);
+
+        a3.release();
+        REQUIRE(admission.accepting());
+        io_service.poll();
+        REQUIRE(resumed == 1);
+
+        // a closed connection frees its address
+        a1.release();
+        auto b = admission.open_connection("10.0.0.1");
+        REQUIRE(!b.over_limit());
+        REQUIRE(admission.stats().connections == 2);
+    }
+
+    SECTION("fixed limit rejects requests over it")
+    {
+        options.limit = ConcurrencyLimit::fixed;
+        options.initial_limit = 2;
+        admission.configure(options);
+
+        auto p1 = admission.try_acquire();
+        auto p2 = admission.try_acquire();
+        auto p3 = admission.try_acquire();
+        REQUIRE(p1);
+        REQUIRE(p2);
+        REQUIRE(!p3);
+        REQUIRE(admission.stats().rejected_requests == 1);
+
+        p1.release(10s);
+        REQUIRE(admission.try_acquire());
+        REQUIRE(admission.stats().limit == 2);
+    }
+
+    SECTION("aimd backs off on slow responses and grows while busy")
+    {
+        options.limit = ConcurrencyLimit::aimd;
+        options.initial_limit = 10;
+        options.min_limit = 2;
+        options.aimd_latency_threshold = 100ms;
+        admission.configure(options);
+
+        for (int i = 0; i < 5; ++i)
+            admission.try_acquire().release(1s);
+        REQUIRE(admission.stats().limit == 5);      // 10 * 0.9^5 = 5.9
+
+        for (int i = 0; i < 50; ++i)
+            admission.try_acquire().release(1s);
+        REQUIRE(admission.stats().limit == 2);
+
+        // fast responses while at limit
+        for (int i = 0; i < 10; ++i) {
+            std::vector<AdmissionControl::Permit> permits;
+            while (auto permit = admission.try_acquire())
+                permits.push_back(std::move(permit));
+            permits.front().release(1ms);
+        }
+        REQUIRE(admission.stats().limit > 10);
+    }
+
+    SECTION("gradient shrinks as latency rises above long term average")
+    {
+        options.limit = ConcurrencyLimit::gradient;
+        options.initial_limit = 100;
+        options.min_limit = 4;
+        admission.configure(options);
+
+        auto saturate = [&](std::chrono::milliseconds latency) {
+            std::vector<AdmissionControl::Permit> permits;
+            while (auto permit = admission.try_acquire())
+                permits.push_back(std::move(permit));
+            permits.front().release(latency);
+        };
+
+        for (int i = 0; i < 20; ++i) saturate(10ms);
+        auto steady = admission.stats().limit;
+        REQUIRE(steady >= 100);
+
+        for (int i = 0; i < 20; ++i) saturate(100ms);
+        REQUIRE(admission.stats().limit < steady / 2);
+
+        // idle, samples leave limit alone
+        auto limit = admission.stats().limit;
+        admission.try_acquire().release(1s);
+        REQUIRE(admission.stats().limit == limit);
+    }
+}
@@ -0,0 +1,64 @@
+#include "catch.hpp"
+
+#include "AllocProfiler.h"
+
+using namespace Theros;
+
+TEST_CASE("AllocProfiler", "[AllocProfiler]")
+{
+    auto &profiler = AllocProfiler::instance();
+    profiler.clear();
+
+    SECTION("innermost scope gets allocations")
+    {
+        PhaseAllocs allocs;
+        auto before = AllocProfiler::thread_totals();
+        {
+            AllocScope handlers(allocs[static_cast<std::size_t>(AllocPhase::handlers)]);
+            AllocProfiler::count(100);
+            {
+                AllocScope serialize(allocs[static_cast<std::size_t>(AllocPhase::serialize)]);
+                AllocProfiler::count(40);
+                AllocProfiler::count(2);
+            }
+            AllocProfiler::count(8);
+        }
+        AllocProfiler::count(1000);
+
+        REQUIRE(allocs[static_cast<std::size_t>(AllocPhase::handlers)].allocations == 2);
+        REQUIRE(allocs[static_cast<std::size_t>(AllocPhase::handlers)].bytes == 108);
+        REQUIRE(allocs[static_cast<std::size_t>(AllocPhase::serialize)].allocations == 2);
+        REQUIRE(allocs[static_cast<std::size_t>(AllocPhase::serialize)].bytes == 42);
+        REQUIRE(allocs[static_cast<std::size_t>(AllocPhase::parse)].allocations == 0);
+
+        auto after = AllocProfiler::thread_totals();
+        REQUIRE(after.allocations - before.allocations >= 5);
+        REQUIRE(after.bytes - before.bytes >= 1150);
+    }
+
+    SECTION("summed per route")
+    {
+        PhaseAllocs allocs;
+        allocs[static_cast<std::size_t>(AllocPhase::parse)] = {3, 300};
+        allocs[static_cast<std::size_t>(AllocPhase::route)] = {1, 50};
+        profiler.record(RequestMethod::GET, "/users/<id>", allocs);
+        profiler.record(RequestMethod::GET, "/users/<id>", allocs);
+        profiler.record(RequestMethod::POST, "/users/<id>", allocs);
+
+        auto routes = profiler.snapshot();
+        REQUIRE(routes.size() == 2);
+        REQUIRE(routes[0].method == RequestMethod::GET);
+        REQUIRE(routes[0].requests == 2);
+        REQUIRE(routes[0].phases[static_cast<std::size_t>(AllocPhase::parse)].allocations == 6);
+        REQUIRE(routes[0].phases[static_cast<std::size_t>(AllocPhase::parse)].bytes == 600);
+        REQUIRE(routes[1].requests == 1);
+
+        auto report = profiler.report();
+        REQUIRE(report.find("GET /users/<id> (2 requests)") != std::string::npos);
+        REQUIRE(report.find("parse") != std::string::npos);
+        REQUIRE(report.find("3.00") != std::string::npos);
+        REQUIRE(report.find("300.0") != std::string::npos);
+        profiler.clear();
+        REQUIRE(profiler.snapshot().empty());
+    }
+}
@@ -0,0 +1,202 @@
+#include <iterator>
+#include <string>
+#include "catch.hpp"
+
+#include "BodyParser.h"
+#include "BodyReader.h"
+#include "Message.h"
+
+using namespace Theros;
+
+TEST_CASE("Framing", "[BodyParser]")
+{
+    BodyParser parser;
+    REQUIRE(parser.state_ == static_cast<BodyParserState>(1));
+
+    Request req;
+
+    SECTION("no body")
+    {
+        REQUIRE(parser.frame(req) == ParseStatus::accept);
+        REQUIRE(parser.framing_ == BodyFraming::none);
+        REQUIRE(parser.done());
+    }
+    SECTION("content length")
+    {
+        req.SetHeader({"Content-Length", "11"});
+        REQUIRE(parser.frame(req) == ParseStatus::in_progress);
+        REQUIRE(parser.framing_ == BodyFraming::content_length);
+        REQUIRE(parser.content_length() == 11);
+    }
+    SECTION("zero content length")
+    {
+        req.SetHeader({"Content-Length", "0"});
+        REQUIRE(parser.frame(req) == ParseStatus::accept);
+    }
+    SECTION("header names are case insensitive")
+    {
+        req.headers.push_back({"content-length", "11"});
+        REQUIRE(parser.frame(req) == ParseStatus::in_progress);
+        REQUIRE(parser.framing_ == BodyFraming::content_length);
+        REQUIRE(parser.content_length() == 11);
+
+        BodyParser chunked;
+        req.headers.push_back({"transfer-encoding", "chunked"});
+        REQUIRE(chunked.frame(req) == ParseStatus::in_progress);
+        REQUIRE(chunked.framing_ == BodyFraming::chunked);
+    }
+    SECTION("malformed content length")
+    {
+        req.SetHeader({"Content-Length", "1x"});
+        REQUIRE(parser.frame(req) == ParseStatus::reject);
+    }
+    SECTION("chunked takes precedence over content length")
+    {
+        req.SetHeader({"Content-Length", "11"});
+        req.SetHeader({"Transfer-Encoding", "Chunked"});
+        REQUIRE(parser.frame(req) == ParseStatus::in_progress);
+        REQUIRE(parser.framing_ == BodyFraming::chunked);
+    }
+    SECTION("unsupported transfer coding")
+    {
+        req.SetHeader({"Transfer-Encoding", "chunked, gzip"});
+        REQUIRE(parser.frame(req) == ParseStatus::reject);
+        REQUIRE(parser.unknown_coding_);
+    }
+    SECTION("coding applied before chunked is not decoded")
+    {
+        req.SetHeader({"Transfer-Encoding", "gzip, chunked"});
+        REQUIRE(parser.frame(req) == ParseStatus::reject);
+        REQUIRE(parser.unknown_coding_);
+    }
+    SECTION("coding names are matched whole")
+    {
+        for (auto coding : {"xchunked", "notchunked", "chunkedx"}) {
+            BodyParser p;
+            req.SetHeader({"Transfer-Encoding", coding});
+            REQUIRE(p.frame(req) == ParseStatus::reject);
+            REQUIRE(p.unknown_coding_);
+        }
+    }
+    SECTION("whitespace around chunked")
+    {
+        req.SetHeader({"Transfer-Encoding", " chunked\t"});
+        REQUIRE(parser.frame(req) == ParseStatus::in_progress);
+        REQUIRE(parser.framing_ == BodyFraming::chunked);
+    }
+    SECTION("malformed coding list")
+    {
+        for (auto coding : {"chunked, chunked", "chunked,", ", chunked", " , "}) {
+            BodyParser p;
+            req.SetHeader({"Transfer-Encoding", coding});
+            REQUIRE(p.frame(req) == ParseStatus::reject);
+            REQUIRE(!p.unknown_coding_);
+        }
+    }
+}
+
+TEST_CASE("Decoding", "[BodyParser]")
+{
+    BodyParser parser;
+    Request req;
+    std::string body;
+    std::string payload;
+    ParseStatus status;
+    std::string::iterator it;
+
+    SECTION("content length split across reads")
+    {
+        req.SetHeader({"Content-Length", "11"});
+        parser.frame(req);
+
+        payload = "hello ";
+        std::tie(it, status) = parser.parse(payload.begin(), payload.end(), body);
+        REQUIRE(status == ParseStatus::in_progress);
+        REQUIRE(it == payload.end());
+
+        payload = "worldGET / HTTP/1.1\r\n";
+        std::tie(it, status) = parser.parse(payload.begin(), payload.end(), body);
+        REQUIRE(status == ParseStatus::accept);
+        REQUIRE(body == "hello world");
+        // pipelined request is left untouched
+        REQUIRE(std::string(it, payload.end()) == "GET / HTTP/1.1\r\n");
+    }
+    SECTION("chunked")
+    {
+        req.SetHeader({"Transfer-Encoding", "chunked"});
+        parser.frame(req);
+
+        payload = "5;name=value\r\nhello\r\n"
+                  "6\r\n world\r\n"
+                  "0\r\n"
+                  "Expires: never\r\n"
+                  "\r\n";
+        std::tie(it, status) = parser.parse(payload.begin(), payload.end(), body);
+        REQUIRE(status == ParseStatus::accept);
+        REQUIRE(it == payload.end());
+        REQUIRE(body == "hello world");
+        REQUIRE(parser.decoded_ == 11);
+    }
+    SECTION("chunked byte by byte")
+    {
+        req.SetHeader({"Transfer-Encoding", "chunked"});
+        parser.frame(req);
+
+        payload = "A\r\n0123456789\r\n0\r\n\r\n";
+        for (auto b = payload.begin(); b != payload.end(); ++b)
+            std::tie(it, status) = parser.parse(b, b + 1, body);
+        REQUIRE(status == ParseStatus::accept);
+        REQUIRE(body == "0123456789");
+    }
+    SECTION("malformed chunk")
+    {
+        req.SetHeader({"Transfer-Encoding", "chunked"});
+        parser.frame(req);
+
+        payload = "5\r\nhello world\r\n";
+        std::tie(it, status) = parser.parse(payload.begin(), payload.end(), body);
+        REQUIRE(status == ParseStatus::reject);
+    }
+    SECTION("empty chunk size")
+    {
+        for (std::string size_line : {"\r\n", ";name=value\r\n", " \r\n"}) {
+            BodyParser chunked;
+            std::string decoded;
+            req.SetHeader({"Transfer-Encoding", "chunked"});
+            chunked.frame(req);
+
+            payload = "5\r\nhello\r\n" + size_line + "\r\n";
+            std::tie(it, status) = chunked.parse(payload.begin(), payload.end(), decoded);
+            REQUIRE(status == ParseStatus::reject);
+        }
+    }
+}
+
+TEST_CASE("BodyReader", "[BodyParser]")
+{
+    BodyReader reader;
+    int pulls = 0;
+    reader.on_pull([&pulls]() { ++pulls; });
+
+    std::string received;
+    bool last = false;
+    auto on_chunk = [&](const std::string& chunk, bool eof) { received += chunk; last = eof; };
+
+    reader.read(on_chunk);
+    REQUIRE(pulls == 1);
+    REQUIRE(reader.pending());
+
+    reader.deliver("abc", false);
+    REQUIRE_FALSE(reader.pending());
+    REQUIRE(received == "abc");
+
+    reader.read(on_chunk);
+    reader.deliver("def", true);
+    REQUIRE(received == "abcdef");
+    REQUIRE(last);
+    REQUIRE(reader.eof());
+
+    // reads past end complete immediately
+    reader.read(on_chunk);
+    REQUIRE(pulls == 2);
+}
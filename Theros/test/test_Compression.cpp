@@ -0,0 +1,176 @@
+#include <zlib.h>
+
+#ifdef THEROS_BROTLI
+#include <brotli/decode.h>
+#endif
+
+#include <stdexcept>
+#include <string>
+#include "catch.hpp"
+
+#include "Compression.h"
+#include "HeadersHooks.h"
+
+using namespace Theros;
+
+static std::string inflate_all(const std::string &in, bool gzip)
+{
+    z_stream zs{};
+    inflateInit2(&zs, gzip ? 15 + 16 : 15);
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+    zs.avail_in = in.size();
+
+    std::string out;
+    char buf[4096];
+    int ret;
+    do {
+        zs.next_out = reinterpret_cast<Bytef *>(buf);
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (ret == Z_OK);
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END ? out : "<corrupt>";
+}
+
+static std::string text(std::size_t size)
+{
+    std::string s;
+    while (s.size() < size) s += "{\"id\": " + std::to_string(s.size()) + ", \"name\": \"theros\"}, ";
+    return s.substr(0, size);
+}
+
+
+TEST_CASE("Compression", "[Compression]")
+{
+    SECTION("negotiate")
+    {
+        REQUIRE(Compression::negotiate("") == "");
+        REQUIRE(Compression::negotiate("identity") == "");
+        REQUIRE(Compression::negotiate("gzip") == "gzip");
+        REQUIRE(Compression::negotiate("deflate, gzip") == "gzip");
+        REQUIRE(Compression::negotiate("gzip;q=0.5, deflate") == "deflate");
+        REQUIRE(Compression::negotiate("gzip;q=0, deflate;q=0") == "");
+        REQUIRE(Compression::negotiate("*") != "");
+        REQUIRE(Compression::negotiate("*, gzip;q=0") != "gzip");
+#ifdef THEROS_BROTLI
+        REQUIRE(Compression::negotiate("gzip, deflate, br") == "br");
+#endif
+    }
+
+    SECTION("round trip")
+    {
+        std::string data = text(100000);
+        for (int level : {1, 6, 9}) {
+            std::string gz = Compression::compress("gzip", data, level);
+            REQUIRE(gz.size() < data.size() / 4);
+            REQUIRE(inflate_all(gz, true) == data);
+            REQUIRE(inflate_all(Compression::compress("deflate", data, level), false) == data);
+        }
+        // reused state starts a fresh stream
+        REQUIRE(inflate_all(Compression::compress("gzip", "abc", 6), true) == "abc");
+        REQUIRE(inflate_all(Compression::compress("gzip", "", 6), true) == "");
+
+#ifdef THEROS_BROTLI
+        std::string br = Compression::compress("br", data, 6);
+        std::string decoded(data.size(), '\0');
+        std::size_t decoded_size = decoded.size();
+        REQUIRE(BrotliDecoderDecompress(br.size(), reinterpret_cast<const uint8_t *>(br.data()), &decoded_size,
+                                        reinterpret_cast<uint8_t *>(&decoded[0])) == BROTLI_DECODER_RESULT_SUCCESS);
+        decoded.resize(decoded_size);
+        REQUIRE(decoded == data);
+#endif
+    }
+
+    SECTION("unsupported coding is an error, not an empty body")
+    {
+        REQUIRE_THROWS_AS(Compression::compress("identity", "abc", 6), std::invalid_argument);
+        REQUIRE_THROWS_AS(Compression::compress("gzp", "abc", 6), std::invalid_argument);
+#ifndef THEROS_BROTLI
+        REQUIRE_THROWS_AS(Compression::compress("br", "abc", 6), std::invalid_argument);
+#endif
+    }
+
+    SECTION("level stays within bounds")
+    {
+        CompressionOptions options;
+        int level = Compression::current_level(options);
+        REQUIRE(level >= options.min_level);
+        REQUIRE(level <= options.level);
+    }
+}
+
+
+TEST_CASE("Compression middleware", "[Compression]")
+{
+    Request req;
+    Response res;
+    Context ctx(req, res);
+    req.method = RequestMethod::GET;
+    req.SetHeader({"Accept-Encoding", "gzip"});
+
+    Compression compression;
+    auto run = [&]() {
+        compression(ctx);
+        run_headers_hooks(ctx);
+    };
+
+    SECTION("body above threshold")
+    {
+        res.SetHeader({"Content-Type", "application/json"});
+        res.SetBody<DefaultBody>(text(5000));
+        run();
+        REQUIRE(res.FindHeader("Content-Encoding") == "gzip");
+        REQUIRE(res.FindHeader("Vary") == "Accept-Encoding");
+        REQUIRE(res.FindHeader("Content-Length") == std::to_string(res.body.size()));
+        REQUIRE(inflate_all(res.body, true) == text(5000));
+    }
+
+    SECTION("small body")
+    {
+        res.body = "tiny";
+        run();
+        REQUIRE(res.FindHeader("Content-Encoding") == "");
+        REQUIRE(res.body == "tiny");
+    }
+
+    SECTION("binary content type")
+    {
+        res.SetHeader({"Content-Type", "image/png"});
+        res.body = text(5000);
+        run();
+        REQUIRE(res.FindHeader("Content-Encoding") == "");
+    }
+
+    SECTION("client without gzip still gets Vary")
+    {
+        req.SetHeader({"Accept-Encoding", "identity"});
+        res.body = text(5000);
+        run();
+        REQUIRE(res.FindHeader("Content-Encoding") == "");
+        REQUIRE(res.FindHeader("Vary") == "Accept-Encoding");
+    }
+
+    SECTION("shared buffer")
+    {
+        res.SetBody<SharedBufferBody>(SharedBufferBody::make(text(5000)));
+        run();
+        auto &buffer = std::get<SharedBufferBody::value_type>(res.content);
+        REQUIRE(inflate_all(*buffer, true) == text(5000));
+        REQUIRE(res.FindHeader("Content-Length") == std::to_string(buffer->size()));
+    }
+
+    SECTION("stream")
+    {
+        ctx.stream.begin();
+        run();
+        REQUIRE(res.FindHeader("Content-Encoding") == "gzip");
+
+        std::string compressed;
+        compressed += ctx.stream.filtered(text(3000), false);
+        REQUIRE(!compressed.empty());       // flushed per chunk
+        compressed += ctx.stream.filtered(text(3000), false);
+        compressed += ctx.stream.filtered("", true);
+        REQUIRE(inflate_all(compressed, true) == text(3000) + text(3000));
+    }
+}
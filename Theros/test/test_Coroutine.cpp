@@ -0,0 +1,154 @@
+#include "Coroutine.h"
+
+#ifdef THEROS_COROUTINES
+
+#include <coroutine>
+#include <stdexcept>
+#include <string>
+#include "catch.hpp"
+
+using namespace Theros;
+
+namespace
+{
+// suspends until test resumes it by hand
+struct Gate {
+    std::coroutine_handle<> waiting;
+    auto wait()
+    {
+        struct Awaiter {
+            Gate &gate;
+            bool await_ready() { return false; }
+            void await_suspend(std::coroutine_handle<> h) { gate.waiting = h; }
+            void await_resume() { }
+        };
+        return Awaiter{*this};
+    }
+    void open() { std::exchange(waiting, nullptr).resume(); }
+};
+
+// resumes waiting coroutine before await_suspend returns, as an awaitable completed
+// on another thread in the meantime would
+struct Racing {
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> h) { h.resume(); }
+    void await_resume() { }
+};
+
+Task<int> twice(Gate &gate, int n)
+{
+    co_await gate.wait();
+    co_return 2 * n;
+}
+}
+
+
+TEST_CASE("Coroutine", "[Coroutine]")
+{
+    Request req;
+    Response res;
+    Context ctx(req, res);
+
+    // stands in for connection, runs hook of resume as connection would
+    Context::HookFunc resumed;
+    bool parked = false;
+    ctx.attach_defer([&](std::chrono::steady_clock::duration, Context::HookFunc) {
+        parked = true;
+        return [&](Context::HookFunc f) { resumed = std::move(f); };
+    });
+
+    Gate gate;
+    std::string order;
+
+    SECTION("completing without suspending resumes at once")
+    {
+        Handler handler([&](Context &ctx) -> Task<> { order += "a"; co_return; },
+                        [&]() { order += "b"; });
+        handler(ctx);
+        REQUIRE(parked);
+        REQUIRE(resumed);
+        REQUIRE(order == "a");
+        resumed(ctx);
+        REQUIRE(order == "ab");
+    }
+
+    SECTION("completing before start returns is not lost")
+    {
+        Handler handler([&](Context &ctx) -> Task<> {
+                            co_await Racing{};
+                            ctx.res.SetBody<DefaultBody>("raced");
+                        },
+                        [&]() { order += "b"; });
+        handler(ctx);
+        REQUIRE(parked);
+        REQUIRE(resumed);
+        resumed(ctx);
+        REQUIRE(order == "b");
+        REQUIRE(res.body == "raced");
+    }
+
+    SECTION("exception before suspending is a 500")
+    {
+        Handler handler([&](Context &ctx) -> Task<> {
+                            throw std::runtime_error("failed");
+                            co_return;
+                        },
+                        [&]() { order += "x"; });
+        handler(ctx);
+        resumed(ctx);
+        REQUIRE(res.status_code == StatusCode::Internal_Server_Error);
+        REQUIRE(order == "");
+    }
+
+    SECTION("suspended handler parks response, rest of chain runs once it completes")
+    {
+        Handler handler([&](Context &ctx) -> Task<> {
+                            order += "a";
+                            int n = co_await twice(gate, 21);
+                            ctx.res.SetBody<DefaultBody>(std::to_string(n));
+                            order += "c";
+                        },
+                        [&]() { order += "d"; });
+        handler(ctx);
+        REQUIRE(order == "a");
+        REQUIRE(parked);
+        REQUIRE(ctx.ended());
+
+        gate.open();
+        REQUIRE(order == "ac");
+        REQUIRE(resumed);
+        resumed(ctx);
+        REQUIRE(order == "acd");
+        REQUIRE(res.body == "42");
+    }
+
+    SECTION("exception after suspending is a 500")
+    {
+        Handler handler([&](Context &ctx) -> Task<> {
+                            co_await gate.wait();
+                            throw std::runtime_error("failed");
+                        },
+                        [&]() { order += "x"; });
+        handler(ctx);
+        gate.open();
+        resumed(ctx);
+        REQUIRE(res.status_code == StatusCode::Internal_Server_Error);
+        REQUIRE(order == "");
+    }
+
+    SECTION("awaitables complete at once outside of a connection")
+    {
+        Handler handler([&](Context &ctx) -> Task<> {
+            auto ec = co_await sleep_for(ctx, std::chrono::seconds(1));
+            REQUIRE(ec == std::errc::not_supported);
+            int n = co_await offload(ctx, []() { return 7; });
+            ctx.res.SetBody<DefaultBody>(std::to_string(n));
+        });
+        handler(ctx);
+        // done before handler returns, already resumed
+        REQUIRE(resumed);
+        REQUIRE(res.body == "7");
+    }
+}
+
+#endif // THEROS_COROUTINES
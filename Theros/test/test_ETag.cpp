@@ -0,0 +1,88 @@
+#include <string>
+#include "catch.hpp"
+
+#include "ETag.h"
+#include "HeadersHooks.h"
+#include "StrUtils.h"
+
+using namespace Theros;
+
+TEST_CASE("ETag", "[ETag]")
+{
+    // handler chain of a route behind ETag, body set by handler
+    auto request = [](ETag &etag, RequestMethod method, const std::string &body,
+                      std::vector<Message<>::Header> req_headers,
+                      std::vector<Message<>::Header> res_headers = {}) {
+        Request req;
+        Response res;
+        Context ctx(req, res);
+        req.method = method;
+        for (auto &h : req_headers) req.SetHeader(h);
+
+        etag(ctx);
+        res.SetBody<DefaultBody>(body);
+        for (auto &h : res_headers) res.SetHeader(h);
+        run_headers_hooks(ctx);
+        return res;
+    };
+
+    ETag etag;
+
+    SECTION("compute")
+    {
+        REQUIRE(ETag::compute("abc") == "\"44bc2cf5ad770999\"");
+        REQUIRE(ETag::compute("1234567", ETagHash::sha256) ==
+                "\"8bb0cf6eb9b17d0f7d22b456f121257dc1254e1f01665370476383ea776df414\"");
+    }
+
+    SECTION("adds tag, 304 on match")
+    {
+        auto res = request(etag, RequestMethod::GET, "abc", {});
+        REQUIRE(res.status_code == StatusCode::OK);
+        std::string tag = res.FindHeader("ETag");
+        REQUIRE(tag == ETag::compute("abc"));
+
+        res = request(etag, RequestMethod::GET, "abc", {{"If-None-Match", "\"x\", W/" + tag}});
+        REQUIRE(res.status_code == StatusCode::Not_Modified);
+        REQUIRE(res.body.empty());
+        REQUIRE(res.FindHeader("Content-Length").empty());
+        REQUIRE(res.FindHeader("ETag") == tag);
+
+        res = request(etag, RequestMethod::GET, "abcd", {{"If-None-Match", tag}});
+        REQUIRE(res.status_code == StatusCode::OK);
+        REQUIRE(res.body == "abcd");
+
+        res = request(etag, RequestMethod::GET, "abc", {{"If-None-Match", "*"}});
+        REQUIRE(res.status_code == StatusCode::Not_Modified);
+    }
+
+    SECTION("If-Modified-Since")
+    {
+        std::vector<Message<>::Header> modified = {{"Last-Modified", format_http_date(1000)}};
+        auto res = request(etag, RequestMethod::GET, "abc", {{"If-Modified-Since", format_http_date(1000)}}, modified);
+        REQUIRE(res.status_code == StatusCode::Not_Modified);
+        res = request(etag, RequestMethod::GET, "abc", {{"If-Modified-Since", format_http_date(999)}}, modified);
+        REQUIRE(res.status_code == StatusCode::OK);
+        // If-None-Match takes precedence
+        res = request(etag, RequestMethod::GET, "abc",
+                      {{"If-Modified-Since", format_http_date(1000)}, {"If-None-Match", "\"x\""}}, modified);
+        REQUIRE(res.status_code == StatusCode::OK);
+    }
+
+    SECTION("tags set by handler are kept")
+    {
+        auto res = request(etag, RequestMethod::HEAD, "", {{"If-None-Match", "\"v2\""}}, {{"ETag", "\"v2\""}});
+        REQUIRE(res.status_code == StatusCode::Not_Modified);
+        res = request(etag, RequestMethod::HEAD, "", {});
+        REQUIRE(res.FindHeader("ETag").empty());
+    }
+
+    SECTION("large bodies and other methods are left alone")
+    {
+        ETagOptions options;
+        options.max_bytes = 2;
+        ETag small(options);
+        REQUIRE(request(small, RequestMethod::GET, "abc", {}).FindHeader("ETag").empty());
+        REQUIRE(request(etag, RequestMethod::POST, "abc", {{"If-None-Match", "*"}}).status_code == StatusCode::OK);
+    }
+}
@@ -0,0 +1,101 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+
+#include "FileReader.h"
+
+using namespace Theros;
+
+TEST_CASE("FileReader", "[FileReader]")
+{
+    std::string path = "/tmp/theros_test_FileReader.bin";
+    std::string content;
+    for (int i = 0; i < 100000; ++i) content += static_cast<char>('a' + i % 26);
+    std::ofstream(path, std::ios::binary) << content;
+
+    auto file = std::make_shared<FileHandle>(::open(path.c_str(), O_RDONLY));
+    REQUIRE(file->fd() >= 0);
+
+    auto read_all = [&](FileIoBackend backend) {
+        asio::io_service io_service;
+        auto &reader = asio::use_service<FileReader>(io_service);
+        if (!reader.use_backend(backend)) return;      // io_uring not supported by kernel
+        REQUIRE(reader.backend() == backend);
+
+        // many reads issued at once, completed out of order
+        constexpr std::size_t block = 4096;
+        std::vector<std::vector<char>> blocks(content.size() / block + 1, std::vector<char>(block));
+        std::vector<std::size_t> lengths(blocks.size(), 0);
+        std::size_t completed = 0;
+
+        for (std::size_t i = 0; i < blocks.size(); ++i) {
+            reader.async_read(file, i * block, blocks[i].data(), block,
+                [&, i](std::error_code ec, std::size_t n) {
+                    REQUIRE(!ec);
+                    lengths[i] = n;
+                    ++completed;
+                });
+        }
+        REQUIRE(completed == 0);    // never inline
+        io_service.run();
+        REQUIRE(completed == blocks.size());
+
+        std::string result;
+        for (std::size_t i = 0; i < blocks.size(); ++i)
+            result.append(blocks[i].data(), lengths[i]);
+        REQUIRE(result == content);
+
+        // end of file
+        char c;
+        std::size_t eof_n = 1;
+        io_service.reset();
+        reader.async_read(file, content.size(), &c, 1, [&](std::error_code ec, std::size_t n) { eof_n = n; });
+        io_service.run();
+        REQUIRE(eof_n == 0);
+
+        REQUIRE(reader.use_backend(backend));
+    };
+
+    SECTION("io_uring") { read_all(FileIoBackend::io_uring); }
+    SECTION("thread pool") { read_all(FileIoBackend::thread_pool); }
+
+    SECTION("shutdown with reads in flight")
+    {
+        asio::io_service io_service;
+        auto &reader = asio::use_service<FileReader>(io_service);
+        if (!reader.use_backend(FileIoBackend::io_uring)) return;
+
+        std::vector<char> buffer(content.size());
+        std::size_t completed = 0;
+        for (std::size_t offset = 0; offset < content.size(); offset += 4096)
+            reader.async_read(file, offset, buffer.data() + offset, 4096, [&](std::error_code, std::size_t) { ++completed; });
+        // submits, handlers are not run yet
+        io_service.poll_one();
+        reader.shutdown();
+        // buffer is no longer written to once shutdown returns, handlers are dropped
+        buffer.assign(buffer.size(), 0);
+        io_service.run();
+        REQUIRE(completed == 0);
+        REQUIRE(std::count(buffer.begin(), buffer.end(), 0) == static_cast<long>(buffer.size()));
+    }
+
+    SECTION("read error")
+    {
+        asio::io_service io_service;
+        auto &reader = asio::use_service<FileReader>(io_service);
+        auto bad = std::make_shared<FileHandle>(::open("/tmp", O_RDONLY));   // directory
+        char c;
+        std::error_code result;
+        reader.async_read(bad, 0, &c, 1, [&](std::error_code ec, std::size_t) { result = ec; });
+        io_service.run();
+        REQUIRE(result);
+    }
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+
+#include "LoopMonitor.h"
+
+using namespace Theros;
+using namespace std::chrono_literals;
+
+TEST_CASE("LoopMonitor", "[LoopMonitor]")
+{
+    asio::io_service io_service;
+    auto &monitor = asio::use_service<LoopMonitor>(io_service);
+
+    std::mutex mutex;
+    std::vector<SlowHandler> reports;
+    LoopMonitorOptions options;
+    options.interval = 10ms;
+    options.slow_handler = 20ms;
+    options.on_slow = [&](const SlowHandler &slow) {
+        std::lock_guard<std::mutex> lock(mutex);
+        reports.push_back(slow);
+    };
+
+    Request req;
+    req.method = RequestMethod::GET;
+    req.uri.abs_path = "/report";
+
+    SECTION("inert until started")
+    {
+        {
+            auto watch = monitor.watch(req);
+            std::this_thread::sleep_for(30ms);
+        }
+        REQUIRE(monitor.slow_handlers() == 0);
+        REQUIRE(monitor.lag().snapshot().count == 0);
+    }
+
+    SECTION("lag of a blocked loop and the handler blocking it")
+    {
+        REQUIRE(monitor.configure(options));
+        monitor.start();
+        REQUIRE_FALSE(monitor.configure(options));
+
+        // a handler holding up loop for 100ms, while a probe is due
+        io_service.post([&]() {
+            auto watch = monitor.watch(req);
+            std::this_thread::sleep_for(100ms);
+        });
+        io_service.post([&]() {
+            auto fast = monitor.watch(req);
+        });
+        asio::basic_waitable_timer<std::chrono::steady_clock> stop(io_service, 200ms);
+        stop.async_wait([&](std::error_code) { io_service.stop(); });
+        io_service.run();
+
+        auto lag = monitor.lag().snapshot();
+        REQUIRE(lag.count > 0);
+        REQUIRE(lag.quantile(1) >= 0.05);
+
+        REQUIRE(monitor.slow_handlers() == 1);
+        std::lock_guard<std::mutex> lock(mutex);
+        REQUIRE(reports.size() == 2);
+        // watchdog sees it while still running, then it is reported with its total
+        REQUIRE(reports[0].running);
+        REQUIRE(!reports[1].running);
+        REQUIRE(reports[1].method == "GET");
+        REQUIRE(reports[1].path == "/report");
+        REQUIRE(reports[1].elapsed >= 100ms);
+    }
+}
@@ -0,0 +1,242 @@
+#include "catch.hpp"
+#include "asio.hpp"
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Connection.h"
+#include "MemorySocket.h"
+#include "ResponseCache.h"
+#include "Router.h"
+#include "RoundTrip.h"
+
+using namespace std;
+using namespace Theros;
+
+
+TEST_CASE("MemorySocket", "[MemorySocket]")
+{
+    asio::io_service io_service;
+    MemorySocket a(io_service), b(io_service);
+
+    SECTION("unconnected")
+    {
+        asio::error_code ec;
+        a.remote_endpoint(ec);
+        REQUIRE(ec);
+        REQUIRE(!a.is_open());
+    }
+
+    a.connect(b);
+
+    SECTION("bytes flow both ways, handlers run from io_service")
+    {
+        string at_b, at_a;
+        bool written = false;
+        asio::async_write(a, asio::buffer(string("hello")), [&](asio::error_code ec, size_t n) {
+            REQUIRE(!ec);
+            REQUIRE(n == 5);
+            written = true;
+        });
+        asio::async_write(b, asio::buffer(string("world")), [](asio::error_code, size_t) {});
+        REQUIRE(!written);
+
+        read_all(b, at_b);
+        read_all(a, at_a);
+        io_service.poll();
+        REQUIRE(written);
+        REQUIRE(at_b == "hello");
+        REQUIRE(at_a == "world");
+
+        // close gives eof to peer, after bytes buffered before it
+        asio::async_write(a, asio::buffer(string(", again")), [](asio::error_code, size_t) {});
+        a.close();
+        io_service.reset();
+        io_service.run();
+        REQUIRE(at_b == "hello, again");
+    }
+
+    SECTION("gather write of several buffers")
+    {
+        string at_b;
+        size_t written = 0;
+        string head = "5\r\n", data = "hello", tail = "\r\n";
+        vector<asio::const_buffer> buffers{asio::buffer(head), asio::buffer(data), asio::buffer(tail)};
+        asio::async_write(a, buffers, [&](asio::error_code ec, size_t n) { written = n; });
+        a.close();
+        read_all(b, at_b);
+        io_service.run();
+        REQUIRE(written == 10);
+        REQUIRE(at_b == "5\r\nhello\r\n");
+    }
+
+    SECTION("read parks until peer writes")
+    {
+        array<char, 4> buffer;
+        size_t got = 0;
+        asio::async_read(b, asio::buffer(buffer), [&](asio::error_code ec, size_t n) { got = n; });
+        asio::async_write(a, asio::buffer(string("ab")), [](asio::error_code, size_t) {});
+        io_service.poll();
+        REQUIRE(got == 0);
+        asio::async_write(a, asio::buffer(string("cd")), [](asio::error_code, size_t) {});
+        io_service.reset();
+        io_service.run();
+        REQUIRE(got == 4);
+        REQUIRE(string(buffer.data(), 4) == "abcd");
+    }
+
+    SECTION("write to closed peer fails")
+    {
+        b.close();
+        asio::error_code result;
+        asio::async_write(a, asio::buffer(string("x")), [&](asio::error_code ec, size_t) { result = ec; });
+        io_service.run();
+        REQUIRE(result == asio::error::broken_pipe);
+    }
+
+    SECTION("close aborts parked read")
+    {
+        array<char, 4> buffer;
+        asio::error_code result;
+        b.async_read_some(asio::buffer(buffer), [&](asio::error_code ec, size_t) { result = ec; });
+        b.close();
+        io_service.run();
+        REQUIRE(result == asio::error::operation_aborted);
+    }
+}
+
+
+TEST_CASE("Connection over MemorySocket", "[MemorySocket]")
+{
+    Router router;
+    router.get("/users/<id>", [](Context &ctx) { ctx.res.SetBody<DefaultBody>("user " + ctx.param["id"]); });
+    router.post("/echo", [](Context &ctx) { ctx.res.SetBody<DefaultBody>("echo " + ctx.req.body); });
+
+    SECTION("request is routed and answered")
+    {
+        auto response = round_trip(router, "GET /users/42 HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        REQUIRE(response.find("HTTP/1.1 200 OK\r\n") == 0);
+        REQUIRE(response.substr(response.size() - 7) == "user 42");
+    }
+
+    SECTION("malformed request gets 400")
+    {
+        auto response = round_trip(router, "GET /users/42 HTTP/1.1\r\nHost localhost\r\n\r\n");
+        REQUIRE(response.find("400") != string::npos);
+    }
+
+    SECTION("lowercase framing headers are honored")
+    {
+        auto response = round_trip(router, "POST /echo HTTP/1.1\r\ncontent-length: 5\r\nConnection: close\r\n\r\nhello");
+        REQUIRE(response.find("HTTP/1.1 200 OK\r\n") == 0);
+        REQUIRE(response.substr(response.size() - 10) == "echo hello");
+
+        response = round_trip(router, "POST /echo HTTP/1.1\r\ntransfer-encoding: chunked\r\nConnection: close\r\n\r\n"
+                                      "5\r\nhello\r\n0\r\n\r\n");
+        REQUIRE(response.substr(response.size() - 10) == "echo hello");
+    }
+
+    SECTION("cache hit is written with status line of request")
+    {
+        router.use("/cached", ResponseCache());
+        router.get("/cached", [](Context &ctx) { ctx.res.SetBody<DefaultBody>("cached"); });
+        round_trip(router, "GET /cached HTTP/1.1\r\nConnection: close\r\n\r\n");
+        auto response = round_trip(router, "GET /cached HTTP/1.0\r\n\r\n");
+        REQUIRE(response.find("HTTP/1.0 200 OK\r\n") == 0);
+        REQUIRE(response.substr(response.size() - 6) == "cached");
+    }
+
+    SECTION("empty chunk size gets 400")
+    {
+        auto response = round_trip(router, "POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                                           "5\r\nhello\r\n\r\n\r\n");
+        REQUIRE(response.find("HTTP/1.1 400") == 0);
+    }
+}
+
+
+TEST_CASE("Streamed response over MemorySocket", "[MemorySocket]")
+{
+    asio::io_service io_service;
+    Router router;
+    router.get("/chunks", [](Context &ctx) {
+        ctx.stream.write("hello");
+        ctx.stream.write(", world");
+        ctx.stream.end();
+    });
+    router.get("/empty", [](Context &ctx) { ctx.stream.end(); });
+    router.get("/late-header", [](Context &ctx) {
+        ctx.stream.write("hello");
+        ctx.res.SetHeader({"X-Late", "1"});
+        ctx.stream.end();
+    });
+    router.get("/unended", [](Context &ctx) { ctx.stream.write("hello"); });
+
+    ConnectionOptions options;
+    options.stream_timeout = chrono::milliseconds(20);
+    auto conn = make_shared<Connection<MemorySocket>>(io_service, router, options);
+    weak_ptr<Connection<MemorySocket>> released = conn;
+    MemorySocket client(io_service);
+    client.connect(conn->socket_);
+    conn->start();
+    conn.reset();
+
+    auto send = [&](const string &path) {
+        string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        asio::async_write(client, asio::buffer(request), [](asio::error_code, size_t) {});
+    };
+    string response;
+
+    SECTION("chunked framing on the wire")
+    {
+        send("/chunks");
+        read_all(client, response);
+        io_service.run();
+        REQUIRE(response.find("HTTP/1.1 200 OK\r\n") == 0);
+        REQUIRE(response.find("Transfer-Encoding: chunked\r\n") != string::npos);
+        REQUIRE(response.find("Content-Length") == string::npos);
+        REQUIRE(response.substr(response.find("\r\n\r\n") + 4) == "5\r\nhello\r\n7\r\n, world\r\n0\r\n\r\n");
+    }
+
+    SECTION("end with no writes")
+    {
+        send("/empty");
+        read_all(client, response);
+        io_service.run();
+        REQUIRE(response.find("Transfer-Encoding: chunked\r\n") != string::npos);
+        REQUIRE(response.substr(response.find("\r\n\r\n") + 4) == "0\r\n\r\n");
+    }
+
+    SECTION("headers set after first write are sent")
+    {
+        send("/late-header");
+        read_all(client, response);
+        io_service.run();
+        auto body_at = response.find("\r\n\r\n");
+        REQUIRE(response.find("X-Late: 1\r\n") < body_at);
+        REQUIRE(response.substr(body_at + 4) == "5\r\nhello\r\n0\r\n\r\n");
+    }
+
+    SECTION("stream never ended is cut short after stream_timeout")
+    {
+        send("/unended");
+        read_all(client, response);
+        io_service.run();
+        REQUIRE(response.substr(response.find("\r\n\r\n") + 4) == "5\r\nhello\r\n");
+    }
+
+    SECTION("peer closes mid-stream with nothing queued")
+    {
+        send("/unended");
+        array<char, 16> buffer;
+        client.async_read_some(asio::buffer(buffer), [&](asio::error_code, size_t) { client.close(); });
+        io_service.run();
+        REQUIRE(!client.is_open());
+    }
+
+    // io_service ran out of work, so connection is not held on to by itself
+    REQUIRE(released.expired());
+}
@@ -60,6 +60,13 @@ TEST_CASE("Message")
 
             test_find_header(msg, { {"egg", "tomato"}, {"quill", "ink"} },
                 { {"oak", "maple"}, {"beaver", "canada"} });
+
+            // names are case insensitive
+            msg.headers.push_back({"content-length", "5"});
+            REQUIRE(msg.FindHeader("Content-Length") == "5");
+            msg.SetHeader({"CONTENT-LENGTH", "6"});
+            REQUIRE(msg.headers.size() == 1);
+            REQUIRE(msg.FindHeader("content-length") == "6");
         }
 
         SECTION("SetHeader")
@@ -158,5 +165,32 @@ TEST_CASE("Message")
             test_conversions(StatusCode::Not_Found, 404, "Not Found");
         }
 
+        SECTION("Body types")
+        {
+            auto shared = SharedBufferBody::make("shared payload");
+            res.SetBody<SharedBufferBody>(shared);
+            REQUIRE(res.FindHeader("Content-Length") == "14");
+            REQUIRE(std::holds_alternative<SharedBufferBody::value_type>(res.content));
+            REQUIRE(std::get<SharedBufferBody::value_type>(res.content).get() == shared.get());
+
+            res.SetBody<GeneratorBody>([](string& chunk) { chunk = "x"; return false; });
+            REQUIRE(res.FindHeader("Content-Length") == "");
+
+            res.SetBody<DefaultBody>("plain");
+            REQUIRE(res.FindHeader("Content-Length") == "5");
+            REQUIRE(std::holds_alternative<std::monostate>(res.content));
+
+            std::error_code ec;
+            FileBody::open("/nonexistent/theros", ec);
+            REQUIRE(ec);
+        }
+
+        SECTION("Chunked")
+        {
+            REQUIRE(chunk_size_line(0) == "0\r\n");
+            REQUIRE(chunk_size_line(10) == "a\r\n");
+            REQUIRE(chunk_size_line(4096) == "1000\r\n");
+        }
+
     }
 }
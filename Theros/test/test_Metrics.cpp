@@ -0,0 +1,98 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include "catch.hpp"
+
+#include "Metrics.h"
+
+using namespace Theros;
+using namespace std::chrono_literals;
+
+TEST_CASE("HdrHistogram", "[Metrics]")
+{
+    SECTION("buckets keep values within 1/16")
+    {
+        for (std::uint64_t v : {0ull, 1ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, ~0ull}) {
+            auto i = HdrHistogram::index(v);
+            REQUIRE(i < HdrHistogram::bucket_count);
+            REQUIRE(HdrHistogram::lowest(i) <= v);
+            REQUIRE(v <= HdrHistogram::highest(i));
+            REQUIRE(HdrHistogram::highest(i) - HdrHistogram::lowest(i) <= v / 16);
+        }
+        REQUIRE(HdrHistogram::index(~0ull) == HdrHistogram::bucket_count - 1);
+    }
+
+    SECTION("quantiles, merged")
+    {
+        HdrHistogram a, b;
+        for (std::uint64_t v = 1; v <= 500; ++v) a.record(v * 1000);
+        for (std::uint64_t v = 501; v <= 1000; ++v) b.record(v * 1000);
+
+        auto s = a.snapshot();
+        s.merge(b.snapshot());
+        REQUIRE(s.count == 1000);
+        REQUIRE(s.sum == 500500000);
+        REQUIRE(s.max == 1000000);
+        REQUIRE(s.quantile(0.5) == Approx(500000).epsilon(1.0 / 16));
+        REQUIRE(s.quantile(0.99) == Approx(990000).epsilon(1.0 / 16));
+        REQUIRE(s.quantile(1) == 1000000);
+        REQUIRE(s.count_at_most(1000000) <= 1000);
+        REQUIRE(s.count_at_most(~0ull) == 1000);
+    }
+}
+
+
+TEST_CASE("Metrics", "[Metrics]")
+{
+    asio::io_service io_service;
+    auto &metrics = asio::use_service<Metrics>(io_service);
+
+    SECTION("routes are merged over threads")
+    {
+        metrics.record(RequestMethod::GET, "/users/<id>", 200, 2ms, 100, 1000);
+        std::thread other([&]() {
+            metrics.record(RequestMethod::GET, "/users/<id>", 200, 4ms, 100, 1000);
+            metrics.record(RequestMethod::GET, "/users/<id>", 404, 1ms, 100, 10);
+            metrics.record(RequestMethod::POST, "/users/<id>", 201, 1ms, 500, 10);
+        });
+        other.join();
+
+        auto routes = metrics.snapshot();
+        REQUIRE(routes.size() == 2);
+        auto &get = routes[0];
+        REQUIRE(get.method == RequestMethod::GET);
+        REQUIRE(get.route == "/users/<id>");
+        REQUIRE(get.requests == 3);
+        REQUIRE(get.statuses == std::vector<std::pair<int, std::uint64_t>>{{200, 2}, {404, 1}});
+        REQUIRE(get.bytes_in == 300);
+        REQUIRE(get.bytes_out == 2010);
+        REQUIRE(get.latency.count == 3);
+        REQUIRE(get.latency.max == 4000000);
+        REQUIRE(routes[1].method == RequestMethod::POST);
+    }
+
+    SECTION("prometheus text")
+    {
+        metrics.record(RequestMethod::GET, "/a\"b", 200, 3ms, 10, 20);
+        auto text = metrics.prometheus();
+        REQUIRE(text.find("# TYPE theros_requests_total counter") != std::string::npos);
+        REQUIRE(text.find("theros_requests_total{method=\"GET\",route=\"/a\\\"b\",code=\"200\"} 1\n") != std::string::npos);
+        REQUIRE(text.find("theros_response_bytes_total{method=\"GET\",route=\"/a\\\"b\"} 20\n") != std::string::npos);
+        REQUIRE(text.find("theros_request_duration_seconds_bucket{method=\"GET\",route=\"/a\\\"b\",le=\"0.0025\"} 0\n") != std::string::npos);
+        REQUIRE(text.find("theros_request_duration_seconds_bucket{method=\"GET\",route=\"/a\\\"b\",le=\"0.005\"} 1\n") != std::string::npos);
+        REQUIRE(text.find("theros_request_duration_seconds_count{method=\"GET\",route=\"/a\\\"b\"} 1\n") != std::string::npos);
+    }
+
+    SECTION("endpoint enables recording")
+    {
+        REQUIRE(!metrics.enabled());
+        Handler endpoint = metrics.endpoint();
+        REQUIRE(metrics.enabled());
+
+        Request req;
+        Response res;
+        Context ctx(req, res);
+        endpoint(ctx);
+        REQUIRE(res.body.find("# TYPE theros_request_duration_seconds histogram") != std::string::npos);
+    }
+}
@@ -0,0 +1,133 @@
+#include <string>
+#include <thread>
+#include "catch.hpp"
+
+#include "HeadersHooks.h"
+#include "ResponseCache.h"
+
+using namespace Theros;
+
+TEST_CASE("ResponseCache", "[ResponseCache]")
+{
+    ResponseCacheOptions options;
+    options.ttl = std::chrono::milliseconds(50);
+    ResponseCache cache(options);
+    int executed = 0;
+
+    // handler chain of a route behind cache, returns payload if served from cache
+    auto request = [&](const std::string &path, const std::string &query,
+                       std::vector<Message<>::Header> headers = {},
+                       HttpVersion version = HttpVersion::one_one) -> std::string {
+        Request req;
+        Response res;
+        Context ctx(req, res);
+        req.method = RequestMethod::GET;
+        req.version = version;
+        res.version = version;
+        req.uri.abs_path = path;
+        req.uri.query = query;
+        for (auto &h : headers) req.SetHeader(h);
+
+        cache(ctx);
+        if (ctx.ended()) {
+            auto &serialized = std::get<SerializedBody::value_type>(res.content);
+            return serialized.status_line + *serialized.payload;
+        }
+
+        ++executed;
+        res.SetHeader({"Vary", "Accept-Language"});
+        res.SetBody<DefaultBody>("content of " + path);
+        if (path == "/private") res.SetHeader({"Cache-Control", "private"});
+        if (path == "/tagged") res.SetHeader({"ETag", "\"v1\""});
+        run_headers_hooks(ctx);
+        return "";
+    };
+
+    SECTION("normalize query")
+    {
+        REQUIRE(ResponseCache::normalize_query("b=2&a=1") == "a=1&b=2");
+        REQUIRE(ResponseCache::normalize_query("a=1&&b=2&") == "a=1&b=2");
+        REQUIRE(ResponseCache::normalize_query("") == "");
+    }
+
+    SECTION("hit skips handlers")
+    {
+        REQUIRE(request("/a", "x=1&y=2") == "");
+        std::string payload = request("/a", "y=2&x=1");
+        REQUIRE(executed == 1);
+        REQUIRE(payload.find("HTTP/1.1 200 OK\r\n") == 0);
+        REQUIRE(payload.find("\r\n\r\ncontent of /a") != std::string::npos);
+
+        auto stats = cache.stats();
+        REQUIRE(stats.hits == 1);
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.entries == 1);
+    }
+
+    SECTION("different path or query misses")
+    {
+        request("/a", "x=1");
+        request("/b", "x=1");
+        request("/a", "x=2");
+        REQUIRE(executed == 3);
+    }
+
+    SECTION("expires after ttl")
+    {
+        request("/a", "");
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        request("/a", "");
+        REQUIRE(executed == 2);
+    }
+
+    SECTION("vary")
+    {
+        request("/a", "", {{"Accept-Language", "en"}});
+        REQUIRE(request("/a", "", {{"Accept-Language", "en"}}) != "");
+        REQUIRE(request("/a", "", {{"Accept-Language", "fr"}}) == "");
+        REQUIRE(executed == 2);
+    }
+
+    SECTION("conditional hit is 304")
+    {
+        request("/tagged", "");
+        std::string payload = request("/tagged", "", {{"If-None-Match", "\"v1\""}});
+        REQUIRE(payload.find("HTTP/1.1 304 Not Modified\r\n") == 0);
+        REQUIRE(payload.find("ETag: \"v1\"\r\n") != std::string::npos);
+        REQUIRE(payload.find("Content-Length") == std::string::npos);
+        REQUIRE(request("/tagged", "", {{"If-None-Match", "\"v0\""}}).find("HTTP/1.1 200 OK") == 0);
+        REQUIRE(executed == 1);
+    }
+
+    SECTION("not stored")
+    {
+        request("/private", "");
+        request("/private", "");
+        request("/a", "", {{"Authorization", "Basic Zm9vOmJhcg=="}});
+        request("/a", "", {{"Authorization", "Basic Zm9vOmJhcg=="}});
+        REQUIRE(executed == 4);
+        REQUIRE(cache.stats().entries == 0);
+    }
+
+    SECTION("credentials in any case bypass cache")
+    {
+        for (std::string name : {"authorization", "AUTHORIZATION", "Cookie", "cookie"}) {
+            request("/a", "", {{name, "secret"}});
+            REQUIRE(cache.stats().entries == 0);
+        }
+        request("/a", "");
+        REQUIRE(request("/a", "", {{"cookie", "session=1"}}) == "");
+        REQUIRE(request("/a", "", {{"authorization", "Basic Zm9vOmJhcg=="}}) == "");
+        REQUIRE(executed == 7);
+    }
+
+    SECTION("status line follows version of request")
+    {
+        request("/tagged", "");
+        REQUIRE(request("/tagged", "", {}, HttpVersion::one_zero).find("HTTP/1.0 200 OK\r\n") == 0);
+        REQUIRE(request("/tagged", "", {{"If-None-Match", "\"v1\""}}, HttpVersion::one_zero)
+                    .find("HTTP/1.0 304 Not Modified\r\n") == 0);
+        REQUIRE(request("/tagged", "").find("HTTP/1.1 200 OK\r\n") == 0);
+        REQUIRE(executed == 1);
+    }
+}
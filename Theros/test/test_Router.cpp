@@ -50,8 +50,12 @@ TEST_CASE("Router")
 
         SECTION("resolve")
         {
-            auto test_resolve = [&r](RequestMethod method, const string& path, vector<int> expected_ids)
+            // handler ids are global, count from id of first handler registered here
+            int first = r.resolve(GET, "/home").front().id();
+            auto test_resolve = [&r, first](RequestMethod method, const string& path, vector<int> expected_ids)
             {
+                for (auto& id : expected_ids)
+                    id += first - 1;
                 auto handles = r.resolve(method, path);
 
                 vector<int> handles_ids;
@@ -65,6 +69,7 @@ TEST_CASE("Router")
             test_resolve(GET, "/home", {1});
             test_resolve(GET, "/home/index.html", {1, 2});
             test_resolve(GET, "/hello", {3});
+            REQUIRE(r.resolve(GET, "/home/index.html").back().pattern() == "/home/index.html");
 
             // bad paths
             test_resolve(GET, "", {});
@@ -120,5 +125,78 @@ TEST_CASE("Router")
         test_resolve(GET, "/user/foo/info", {1, 3}, {{"id", "foo"}});
     }
 
+
+    SECTION("handlers registered on same path run in order")
+    {
+        Router r;
+        string order;
+        r.get("/a", [&order](){ order += "1"; });
+        r.get("/a", [&order](){ order += "2"; }, [&order](){ order += "3"; });
+
+        Request req;
+        Response res;
+        Context ctx(req, res);
+        auto route = r.resolve(GET, "/a");
+        REQUIRE(route.size() == 1);
+        for (auto& handler : route) handler(ctx);
+        REQUIRE(order == "123");
+    }
+
+
+    SECTION("next and end")
+    {
+        Request req;
+        Response res;
+        Context ctx(req, res);
+        string order;
+
+        // onion, handler resumes after rest of chain is done
+        Handler outer([&order](Context &ctx){ order += "("; ctx.next(); order += ")"; });
+        Handler chain(outer, [&order](){ order += "a"; }, [&order](){ order += "b"; });
+        chain(ctx);
+        REQUIRE(order == "(ab)");
+
+        // end skips the rest, also of spliced handlers
+        order.clear();
+        Handler stop([&order](Context &ctx){ order += "s"; ctx.end(); });
+        Handler ended(outer, stop, [&order](){ order += "x"; });
+        REQUIRE(ended.functions().size() == 3);
+        ended(ctx);
+        REQUIRE(order == "(s)");
+        REQUIRE(ctx.ended());
+    }
+
+
+    SECTION("mount point matches remaining path")
+    {
+        Router r;
+
+        r.use("/static", [](){ cout << "handler 1" << endl; });
+        r.get("/static/exact", [](){ cout << "handler 2" << endl; });
+
+        REQUIRE(r.find_mount_point("/static/css/site.css") == "/static");
+        REQUIRE(r.find_mount_point("/static") == "/static");
+        REQUIRE(r.find_mount_point("/staticfoo") == "");
+        REQUIRE(r.find_mount_point("/other") == "");
+
+        // use() registers a handler for each method, compare number of handlers instead of ids
+        auto test_resolve = [&r](const string& path, size_t expected_count, vector<pair<string, string>> expected_kvs)
+        {
+            auto req = Request();
+            req.method = GET;
+            req.uri.abs_path = path;
+
+            vector<pair<string, string>> kvs;
+            auto handles = r.resolve(req, kvs);
+
+            REQUIRE(handles.size() == expected_count);
+            REQUIRE(kvs == expected_kvs);
+        };
+
+        test_resolve("/static/exact", 2, {});
+        test_resolve("/static/css/site.css", 1, {{"*", "css/site.css"}});
+        test_resolve("/staticfoo", 0, {});
+    }
+
 }
 
@@ -1,10 +1,12 @@
 #include "catch.hpp"
 #include "asio.hpp"
+#include <string>
 #include <utility>
 #include <stdexcept>
 
 #include "Constants.h"
 #include "Server.h"
+#include "ServerConfig.h"
 #include "Router.h"
 
 using namespace std;
@@ -64,4 +66,35 @@ TEST_CASE("Construct routes", "[Server]")
 
         // app->run();
     }
-}
\ No newline at end of file
+}
+
+
+TEST_CASE("Files of ServerConfig", "[Server]")
+{
+    // Theros/, wherever tests are run from
+    const string theros_dir = string(__FILE__).substr(0, string(__FILE__).rfind('/') + 1) + "../";
+
+    SECTION("sample config next to main.cpp holds the defaults")
+    {
+        auto sample = ServerConfig::load(theros_dir + "config.json");
+        REQUIRE(sample.to_json() == ServerConfig().to_json());
+    }
+
+    ServerConfig config;
+    config.tls.private_key = theros_dir + "ssl/key.pem";
+    config.tls.certificate_chain = theros_dir + "ssl/cert.pem";
+    config.tls.dh_params = theros_dir + "ssl/dh2048.pem";
+    config.tls.passphrase = theros_dir + "ssl/passphrase";
+
+    SECTION("TLS files shipped in Theros/ssl load")
+    {
+        REQUIRE(ServerConfig().tls.private_key == "Theros/ssl/key.pem");
+        REQUIRE_NOTHROW(HttpsServer(config));
+    }
+
+    SECTION("TLS file that cannot be loaded is named")
+    {
+        config.tls.certificate_chain = "missing/cert.pem";
+        REQUIRE_THROWS_WITH(HttpsServer(config), Catch::Contains("tls.certificate_chain: cannot load missing/cert.pem"));
+    }
+}
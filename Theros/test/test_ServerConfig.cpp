@@ -0,0 +1,119 @@
+#include "catch.hpp"
+#include "asio.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "Connection.h"
+#include "MemorySocket.h"
+#include "Router.h"
+#include "ServerConfig.h"
+#include "RoundTrip.h"
+
+using namespace std;
+using namespace Theros;
+
+namespace
+{
+string error_of(const string &json)
+{
+    try {
+        ServerConfig::from_json(JsonType::parse(json));
+    } catch (const runtime_error &e) {
+        return e.what();
+    }
+    return "";
+}
+}
+
+
+TEST_CASE("ServerConfig", "[ServerConfig]")
+{
+    SECTION("empty object keeps defaults")
+    {
+        auto config = ServerConfig::from_json(JsonType::object());
+        REQUIRE(config.host == "127.0.0.1");
+        REQUIRE(config.port == 8888);
+        REQUIRE(config.connection.read_buffer_bytes == 4096);
+        REQUIRE(config.connection.read_timeout == chrono::seconds(2));
+        REQUIRE(config.tls.private_key == "Theros/ssl/key.pem");
+    }
+
+    SECTION("nested values")
+    {
+        auto config = ServerConfig::from_json(JsonType::parse(R"({
+            "host": "0.0.0.0", "port": 9000, "backlog": 16, "no_delay": false,
+            "connection": { "read_buffer_bytes": 16384, "read_timeout_ms": 250 },
+            "admission": { "max_connections": 100, "limit": "gradient", "retry_after_s": 3 },
+            "work_pool": { "threads": 2 },
+            "tls": { "private_key": "ssl/key.pem" }
+        })"));
+        REQUIRE(config.host == "0.0.0.0");
+        REQUIRE(config.port == 9000);
+        REQUIRE(config.backlog == 16);
+        REQUIRE(!config.no_delay);
+        REQUIRE(config.connection.read_buffer_bytes == 16384);
+        REQUIRE(config.connection.read_timeout == chrono::milliseconds(250));
+        REQUIRE(config.connection.max_body_bytes == 1 << 20);
+        REQUIRE(config.admission.max_connections == 100);
+        REQUIRE(config.admission.limit == ConcurrencyLimit::gradient);
+        REQUIRE(config.admission.retry_after == chrono::seconds(3));
+        REQUIRE(config.work_pool.threads == 2);
+        REQUIRE(config.tls.private_key == "ssl/key.pem");
+        REQUIRE(config.tls.certificate_chain == "Theros/ssl/cert.pem");
+
+        REQUIRE(ServerConfig::from_json(config.to_json()).to_json() == config.to_json());
+    }
+
+    SECTION("mistakes are named")
+    {
+        REQUIRE(error_of(R"({"conection": {}})") == "server config: conection: unknown key");
+        REQUIRE(error_of(R"({"connection": {"read_timeout": 5}})") == "server config: connection.read_timeout: unknown key");
+        REQUIRE(error_of(R"({"port": "80"})") == "server config: port: expected an integer");
+        REQUIRE(error_of(R"({"work_pool": {"threads": -1}})") == "server config: work_pool.threads: expected a non-negative integer");
+        REQUIRE(error_of(R"({"admission": {"limit": "fast"}})").find("admission.limit") != string::npos);
+        REQUIRE(error_of(R"({"port": 70000})") == "server config: port: expected 0 to 65535");
+        REQUIRE(error_of(R"([1, 2])") == "server config: top level: expected an object");
+    }
+
+    SECTION("load")
+    {
+        const string path = "test_server_config.json";
+        ofstream(path) << R"({"port": 8443})";
+        REQUIRE(ServerConfig::load(path).port == 8443);
+        ofstream(path) << R"({"port": )";
+        REQUIRE_THROWS_AS(ServerConfig::load(path), runtime_error);
+        remove(path.c_str());
+        REQUIRE_THROWS_AS(ServerConfig::load(path), runtime_error);
+    }
+}
+
+
+TEST_CASE("Connection options", "[ServerConfig]")
+{
+    Router router;
+    router.get("/users/<id>", [](Context &ctx) { ctx.res.SetBody<DefaultBody>("user " + ctx.param["id"]); });
+    const string request = "GET /users/42 HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n";
+
+    SECTION("small read buffer")
+    {
+        ConnectionOptions options;
+        options.read_buffer_bytes = 7;
+        auto response = round_trip(router, request, options);
+        REQUIRE(response.find("HTTP/1.1 200 OK\r\n") == 0);
+        REQUIRE(response.substr(response.size() - 7) == "user 42");
+    }
+
+    SECTION("headers past max_header_bytes")
+    {
+        ConnectionOptions options;
+        options.read_buffer_bytes = 16;
+        options.max_header_bytes = 32;
+        auto response = round_trip(router, request, options);
+        REQUIRE(response.find("400 Bad Request") != string::npos);
+        REQUIRE(response.find("user 42") == string::npos);
+    }
+}
@@ -0,0 +1,213 @@
+#include <functional>
+#include <memory>
+#include <string>
+#include "catch.hpp"
+
+#include "HeadersHooks.h"
+#include "SingleFlight.h"
+
+using namespace Theros;
+
+TEST_CASE("SingleFlight", "[SingleFlight]")
+{
+    // request parked by defer, answered once resume is called, or on_timeout is
+    struct Exchange {
+        Request req;
+        Response res;
+        Context ctx{req, res};
+        Context::HookFunc on_resume;
+        Context::HookFunc on_timeout;
+        bool deferred = false;
+        bool answered = false;
+
+        Exchange(const std::string &path, const std::string &query)
+        {
+            req.method = RequestMethod::GET;
+            req.uri.abs_path = path;
+            req.uri.query = query;
+            ctx.attach_defer([this](std::chrono::steady_clock::duration, Context::HookFunc timeout) {
+                deferred = true;
+                on_timeout = std::move(timeout);
+                return [this](Context::HookFunc f) { on_resume = std::move(f); };
+            });
+        }
+        void resume()
+        {
+            if (on_resume) on_resume(ctx);
+            answered = true;
+        }
+        void run_hooks()
+        {
+            run_headers_hooks(ctx);
+        }
+    };
+
+    SingleFlight single_flight;
+    auto exchange = [](const std::string &path, const std::string &query = "") {
+        return std::make_unique<Exchange>(path, query);
+    };
+
+    SECTION("duplicates wait for leader")
+    {
+        auto leader = exchange("/a", "x=1&y=2");
+        auto duplicate = exchange("/a", "y=2&x=1");
+        auto other = exchange("/b");
+
+        single_flight(leader->ctx);
+        single_flight(duplicate->ctx);
+        single_flight(other->ctx);
+        REQUIRE(!leader->deferred);
+        REQUIRE(duplicate->deferred);
+        REQUIRE(duplicate->ctx.ended());
+        REQUIRE(!other->deferred);
+        REQUIRE(single_flight.stats().in_flight == 2);
+
+        leader->res.SetHeader({"X-Leader", "1"});
+        leader->res.SetBody<DefaultBody>("expensive");
+        leader->run_hooks();
+        duplicate->resume();
+
+        REQUIRE(duplicate->res.FindHeader("X-Leader") == "1");
+        auto &body = std::get<SharedBufferBody::value_type>(duplicate->res.content);
+        REQUIRE(*body == "expensive");
+        // leader and waiter share one body
+        REQUIRE(body == std::get<SharedBufferBody::value_type>(leader->res.content));
+
+        auto stats = single_flight.stats();
+        REQUIRE(stats.leaders == 2);
+        REQUIRE(stats.coalesced == 1);
+        REQUIRE(stats.in_flight == 1);
+    }
+
+    SECTION("next request after leader is done leads again")
+    {
+        auto first = exchange("/a");
+        single_flight(first->ctx);
+        first->run_hooks();
+
+        auto second = exchange("/a");
+        single_flight(second->ctx);
+        REQUIRE(!second->deferred);
+    }
+
+    SECTION("timeout answers 503")
+    {
+        auto leader = exchange("/a");
+        auto duplicate = exchange("/a");
+        single_flight(leader->ctx);
+        single_flight(duplicate->ctx);
+
+        duplicate->on_timeout(duplicate->ctx);
+        REQUIRE(duplicate->res.status_code == StatusCode::Service_Unavailable);
+        REQUIRE(duplicate->res.FindHeader("Retry-After") == "1");
+        REQUIRE(single_flight.stats().timeouts == 1);
+    }
+
+    // chain of a route behind single_flight, counts runs of route's own handler
+    int executed = 0;
+    auto chain = single_flight.functions();
+    chain.push_back([&executed](Context &ctx) {
+        ++executed;
+        ctx.res.SetBody<DefaultBody>("own");
+    });
+
+    SECTION("leader gone or streamed lets waiters run handlers")
+    {
+        auto leader = exchange("/a");
+        auto duplicate = exchange("/a");
+        single_flight(leader->ctx);
+        duplicate->ctx.run(chain);
+        REQUIRE(duplicate->deferred);
+        REQUIRE(executed == 0);
+
+        leader->ctx.stream.begin();
+        leader->run_hooks();
+        duplicate->resume();
+        REQUIRE(executed == 1);
+        REQUIRE(duplicate->res.status_code == StatusCode::OK);
+        REQUIRE(duplicate->res.body == "own");
+
+        auto next = exchange("/a");
+        auto next_duplicate = exchange("/a");
+        single_flight(next->ctx);
+        next_duplicate->ctx.run(chain);
+        next.reset();
+        next_duplicate->resume();
+        REQUIRE(executed == 2);
+        REQUIRE(next_duplicate->res.body == "own");
+        REQUIRE(single_flight.stats().in_flight == 0);
+    }
+
+    SECTION("responses of leader only are not shared")
+    {
+        auto unshared = [&](std::function<void(Response &)> respond) {
+            auto leader = exchange("/a");
+            auto duplicate = exchange("/a");
+            single_flight(leader->ctx);
+            duplicate->ctx.run(chain);
+            REQUIRE(duplicate->deferred);
+
+            leader->res.SetBody<DefaultBody>("leader's");
+            respond(leader->res);
+            leader->run_hooks();
+            duplicate->resume();
+            return duplicate->res.body == "own";
+        };
+
+        REQUIRE(unshared([](Response &res) { res.status_code = StatusCode::Partial_Content; }));
+        REQUIRE(unshared([](Response &res) { res.status_code = StatusCode::Not_Modified; }));
+        REQUIRE(unshared([](Response &res) { res.SetHeader({"Set-Cookie", "session=1"}); }));
+        REQUIRE(unshared([](Response &res) { res.SetHeader({"set-cookie", "session=1"}); }));
+        REQUIRE(unshared([](Response &res) { res.SetHeader({"Cache-Control", "max-age=60, private"}); }));
+        REQUIRE(unshared([](Response &res) { res.SetHeader({"Cache-Control", "No-Store"}); }));
+        REQUIRE(!unshared([](Response &res) { res.SetHeader({"Cache-Control", "public, max-age=60"}); }));
+        REQUIRE(executed == 6);
+    }
+
+    SECTION("requests with credentials, ranges or validators are not coalesced")
+    {
+        for (std::string name : {"Authorization", "authorization", "Cookie", "COOKIE", "Range", "range",
+                                 "If-None-Match", "if-none-match", "If-Modified-Since", "if-modified-since",
+                                 "If-Range", "if-range"}) {
+            auto leader = exchange("/a");
+            auto request = exchange("/a");
+            request->req.SetHeader({name, "x"});
+            REQUIRE(SingleFlight::by_url()(request->ctx) == "");
+
+            single_flight(leader->ctx);
+            single_flight(request->ctx);
+            REQUIRE(!request->deferred);
+            leader->run_hooks();
+        }
+    }
+
+    SECTION("key functions")
+    {
+        SingleFlightOptions options;
+        options.key = SingleFlight::by_url_and_headers({"Accept-Language"});
+        options.max_waiters = 1;
+        SingleFlight by_language(options);
+
+        auto en = exchange("/a");
+        auto fr = exchange("/a");
+        auto en_again = exchange("/a");
+        auto en_third = exchange("/a");
+        en->req.SetHeader({"Accept-Language", "en"});
+        fr->req.SetHeader({"Accept-Language", "fr"});
+        en_again->req.SetHeader({"Accept-Language", "en"});
+        en_third->req.SetHeader({"Accept-Language", "en"});
+
+        by_language(en->ctx);
+        by_language(fr->ctx);
+        by_language(en_again->ctx);
+        by_language(en_third->ctx);
+        REQUIRE(!fr->deferred);
+        REQUIRE(en_again->deferred);
+        // over max_waiters, runs handlers itself
+        REQUIRE(!en_third->deferred);
+
+        auto post = exchange("/a");
+        post->req.method = RequestMethod::POST;
+        REQUIRE(SingleFlight::by_url()(post->ctx) == "");
+    }
+}
@@ -0,0 +1,173 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "LruCache.h"
+#include "StaticFiles.h"
+
+using namespace std;
+using namespace Theros;
+
+
+TEST_CASE("LruCache", "[StaticFiles]")
+{
+    SECTION("evicts least recently used")
+    {
+        LruCache<string, int> cache(2);
+        vector<string> evicted;
+        cache.on_evict([&evicted](const string& key, int&) { evicted.push_back(key); });
+
+        cache.put("a", 1);
+        cache.put("b", 2);
+        REQUIRE(*cache.get("a") == 1);      // b is now least recently used
+        cache.put("c", 3);
+
+        REQUIRE(cache.size() == 2);
+        REQUIRE(cache.get("b") == nullptr);
+        REQUIRE(*cache.get("c") == 3);
+        REQUIRE(evicted == vector<string>{"b"});
+
+        cache.erase("a");
+        REQUIRE(cache.size() == 1);
+        REQUIRE(evicted.size() == 1);
+    }
+
+    SECTION("bounded by cost")
+    {
+        LruCache<string, string> cache(10);
+        cache.put("a", "aaaa", 4);
+        cache.put("b", "bbbb", 4);
+        cache.put("c", "cccc", 4);
+        REQUIRE(cache.cost() == 8);
+        REQUIRE(cache.get("a") == nullptr);
+
+        REQUIRE(cache.put("huge", "", 11) == nullptr);
+        REQUIRE(cache.cost() == 8);
+    }
+}
+
+
+TEST_CASE("StaticFiles", "[StaticFiles]")
+{
+    SECTION("resolve_path")
+    {
+        REQUIRE(StaticFiles::resolve_path("/www", "css/site.css", "index.html") == "/www/css/site.css");
+        REQUIRE(StaticFiles::resolve_path("/www", "a//./b", "index.html") == "/www/a/b");
+        REQUIRE(StaticFiles::resolve_path("/www", "", "index.html") == "/www/index.html");
+        REQUIRE(StaticFiles::resolve_path("/www", "docs/", "index.html") == "/www/docs/index.html");
+        REQUIRE(StaticFiles::resolve_path("/www", "../etc/passwd", "index.html") == "");
+        REQUIRE(StaticFiles::resolve_path("/www", "a/../../b", "index.html") == "");
+    }
+
+    SECTION("parse_range")
+    {
+        size_t first = 0, last = 0;
+        auto check = [&](const string& range, int expected, size_t f = 0, size_t l = 0) {
+            REQUIRE(StaticFiles::parse_range(range, 100, first, last) == expected);
+            if (expected == 1) {
+                REQUIRE(first == f);
+                REQUIRE(last == l);
+            }
+        };
+
+        check("bytes=0-9", 1, 0, 9);
+        check("bytes=90-", 1, 90, 99);
+        check("bytes=95-200", 1, 95, 99);
+        check("bytes=-10", 1, 90, 99);
+        check("bytes=-200", 1, 0, 99);
+        check("bytes=100-", 0);
+        check("bytes=-0", 0);
+        check("bytes=9-0", -1);
+        check("bytes=0-1,5-6", -1);
+        check("items=0-9", -1);
+        check("bytes=a-b", -1);
+    }
+
+    SECTION("content_type")
+    {
+        REQUIRE(StaticFiles::content_type("/www/index.HTML") == "text/html; charset=utf-8");
+        REQUIRE(StaticFiles::content_type("/www/logo.png") == "image/png");
+        REQUIRE(StaticFiles::content_type("/www/v1.2/README") == "application/octet-stream");
+    }
+}
+
+
+TEST_CASE("StaticFiles precompressed variant", "[StaticFiles]")
+{
+    const string root = "test_static_files";
+    mkdir(root.c_str(), 0755);
+    ofstream(root + "/a.txt") << "identity bytes of a";
+    ofstream(root + "/a.txt.gz") << "gzip of a";
+
+    StaticFiles files(root);
+    auto request = [&](vector<Message<>::Header> headers) {
+        Request req;
+        Response res;
+        Context ctx(req, res);
+        req.method = RequestMethod::GET;
+        req.uri_param["*"] = "a.txt";
+        for (auto &h : headers) req.SetHeader(h);
+        files(ctx);
+        return res;
+    };
+    auto length = [](const Response &res) { return get<FileBody::value_type>(res.content).length; };
+
+    auto identity = request({});
+    auto gzip = request({{"Accept-Encoding", "gzip, br"}});
+    string identity_tag = identity.FindHeader("ETag");
+    string gzip_tag = gzip.FindHeader("ETag");
+
+    SECTION("each representation has its own tag")
+    {
+        REQUIRE(identity.FindHeader("Content-Encoding").empty());
+        REQUIRE(length(identity) == 19);
+        REQUIRE(gzip.FindHeader("Content-Encoding") == "gzip");
+        REQUIRE(length(gzip) == 9);
+        REQUIRE(gzip.FindHeader("Vary") == "Accept-Encoding");
+        REQUIRE(gzip_tag == identity_tag.substr(0, identity_tag.size() - 1) + "-gz\"");
+    }
+
+    SECTION("If-None-Match is checked against selected representation")
+    {
+        REQUIRE(request({{"Accept-Encoding", "gzip"}, {"If-None-Match", gzip_tag}}).status_code == StatusCode::Not_Modified);
+        REQUIRE(request({{"Accept-Encoding", "gzip"}, {"If-None-Match", identity_tag}}).status_code == StatusCode::OK);
+        REQUIRE(request({{"If-None-Match", gzip_tag}}).status_code == StatusCode::OK);
+    }
+
+    SECTION("Range is served from selected representation")
+    {
+        auto res = request({{"Accept-Encoding", "gzip"}, {"Range", "bytes=0-3"}, {"If-Range", gzip_tag}});
+        REQUIRE(res.status_code == StatusCode::Partial_Content);
+        REQUIRE(res.FindHeader("Content-Encoding") == "gzip");
+        REQUIRE(res.FindHeader("Content-Range") == "bytes 0-3/9");
+
+        res = request({{"Range", "bytes=0-3"}, {"If-Range", identity_tag}});
+        REQUIRE(res.status_code == StatusCode::Partial_Content);
+        REQUIRE(res.FindHeader("Content-Range") == "bytes 0-3/19");
+
+        res = request({{"Accept-Encoding", "gzip"}, {"Range", "bytes=10-"}});
+        REQUIRE(res.status_code == StatusCode::Requested_Range_Not_Satisfiable);
+        REQUIRE(res.FindHeader("Content-Range") == "bytes */9");
+    }
+
+    SECTION("If-Range of other representation gets whole body")
+    {
+        // cache holding gzip body under its tag must not get identity bytes spliced in
+        auto res = request({{"Range", "bytes=0-3"}, {"If-Range", gzip_tag}});
+        REQUIRE(res.status_code == StatusCode::OK);
+        REQUIRE(length(res) == 19);
+
+        res = request({{"Accept-Encoding", "gzip"}, {"Range", "bytes=0-3"}, {"If-Range", identity_tag}});
+        REQUIRE(res.status_code == StatusCode::OK);
+        REQUIRE(res.FindHeader("Content-Encoding") == "gzip");
+        REQUIRE(length(res) == 9);
+    }
+
+    remove((root + "/a.txt.gz").c_str());
+    remove((root + "/a.txt").c_str());
+    rmdir(root.c_str());
+}
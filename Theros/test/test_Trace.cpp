@@ -0,0 +1,77 @@
+#include <thread>
+#include "catch.hpp"
+
+#include "Trace.h"
+
+using namespace Theros;
+
+TEST_CASE("Tracer", "[Trace]")
+{
+    auto &tracer = Tracer::instance();
+    tracer.clear();
+
+    auto id = tracer.next_request();
+    REQUIRE(tracer.next_request() == id + 1);
+
+    SECTION("spans of all threads, oldest first")
+    {
+        tracer.record("route", id, 300, 400);
+        tracer.record("accept", id, 100, 100);
+        std::thread([&]() { tracer.record("handler", id, 200, 250, 0); }).join();
+
+        auto spans = tracer.spans();
+        REQUIRE(spans.size() == 3);
+        REQUIRE(std::string(spans[0].name) == "accept");
+        REQUIRE(std::string(spans[1].name) == "handler");
+        REQUIRE(spans[1].arg == 0);
+        REQUIRE(std::string(spans[2].name) == "route");
+        REQUIRE(spans[1].thread != spans[2].thread);
+
+        tracer.clear();
+        REQUIRE(tracer.spans().empty());
+    }
+
+    SECTION("ring keeps newest spans")
+    {
+        for (std::size_t i = 0; i < Tracer::ring_size + 10; ++i)
+            tracer.record("handler", id, i + 1, i + 2);
+        auto spans = tracer.spans();
+        REQUIRE(spans.size() == Tracer::ring_size);
+        REQUIRE(spans.front().begin == 11);
+        REQUIRE(spans.back().begin == static_cast<std::int64_t>(Tracer::ring_size + 10));
+        tracer.clear();
+    }
+
+    SECTION("chrome trace events")
+    {
+        tracer.record("accept", id, 1000, 1000);
+        tracer.record("handler", id, 2000, 5000, 1);
+
+        auto trace = JsonType::parse(tracer.chrome_json());
+        auto &events = trace["traceEvents"];
+        REQUIRE(events.size() == 3);
+
+        REQUIRE(events[0]["ph"] == "n");
+        REQUIRE(events[0]["name"] == "accept");
+        REQUIRE(events[0]["id"] == id);
+
+        REQUIRE(events[1]["ph"] == "b");
+        REQUIRE(events[2]["ph"] == "e");
+        REQUIRE(events[1]["ts"] == 2.0);
+        REQUIRE(events[2]["ts"] == 5.0);
+        REQUIRE(events[1]["args"]["index"] == 1);
+        tracer.clear();
+    }
+
+    SECTION("TraceScope records its lifetime")
+    {
+        {
+            TraceScope scope("handler", id, 2);
+        }
+        auto spans = tracer.spans();
+        REQUIRE(spans.size() == 1);
+        REQUIRE(spans[0].request == id);
+        REQUIRE(spans[0].end >= spans[0].begin);
+        tracer.clear();
+    }
+}
@@ -0,0 +1,189 @@
+#include "catch.hpp"
+#include "asio.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "Connection.h"
+#include "MemorySocket.h"
+#include "Router.h"
+#include "TrafficRecorder.h"
+
+using namespace std;
+using namespace Theros;
+
+namespace
+{
+const string log_path = "test_traffic.log";
+
+vector<TrafficRecord> read_log(const string &path)
+{
+    TrafficReader reader(path);
+    REQUIRE(reader.good());
+    vector<TrafficRecord> records;
+    TrafficRecord record;
+    while (reader.next(record)) records.push_back(record);
+    return records;
+}
+
+// request sent in parts, each read separately by connection
+void serve(asio::io_service &io_service, Router &router, const vector<string> &parts)
+{
+    auto conn = make_shared<Connection<MemorySocket>>(io_service, router);
+    auto client = make_shared<MemorySocket>(io_service);
+    client->connect(conn->socket_);
+    conn->start();
+    for (auto &part : parts) {
+        asio::async_write(*client, asio::buffer(part), [](asio::error_code, size_t) {});
+        io_service.poll();
+    }
+    auto buffer = make_shared<array<char, 512>>();
+    client->async_read_some(asio::buffer(*buffer), [client, buffer](asio::error_code, size_t) {});
+    conn.reset();
+    io_service.run();
+    io_service.reset();
+}
+}
+
+
+TEST_CASE("TrafficRecorder", "[TrafficRecorder]")
+{
+    asio::io_service io_service;
+    auto &recorder = asio::use_service<TrafficRecorder>(io_service);
+
+    SECTION("nothing is recorded until opened")
+    {
+        REQUIRE(!recorder.recording());
+        REQUIRE(recorder.opened() == 0);
+    }
+
+    SECTION("records and reads back")
+    {
+        REQUIRE(recorder.open(log_path));
+        auto a = recorder.opened();
+        auto b = recorder.opened();
+        REQUIRE(a == 1);
+        REQUIRE(b == 2);
+        string large(100000, 'x');
+        recorder.received(b, "GET / HTTP/1.1\r\n", 16);
+        recorder.received(a, large.data(), large.size());
+        recorder.closed(a);
+        recorder.close();
+        REQUIRE(recorder.opened() == 0);
+
+        auto records = read_log(log_path);
+        REQUIRE(records.size() == 5);
+        REQUIRE(records[0].kind == TrafficRecord::Kind::open);
+        REQUIRE(records[0].connection == 1);
+        REQUIRE(records[1].connection == 2);
+        REQUIRE(records[2].kind == TrafficRecord::Kind::data);
+        REQUIRE(records[2].data == "GET / HTTP/1.1\r\n");
+        REQUIRE(records[3].data == large);
+        REQUIRE(records[4].kind == TrafficRecord::Kind::close);
+        for (size_t i = 1; i < records.size(); ++i)
+            REQUIRE(records[i].at >= records[i - 1].at);
+
+        SECTION("a log cut short ends at last whole record")
+        {
+            ifstream in(log_path, ios::binary);
+            string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            in.close();
+            ofstream(log_path, ios::binary | ios::trunc).write(bytes.data(), bytes.size() - 1000);
+            auto cut = read_log(log_path);
+            REQUIRE(cut.size() == 3);
+        }
+    }
+
+    SECTION("connections are recorded as read, from accept to close")
+    {
+        Router router;
+        router.get("/users/<id>", [](Context &ctx) { ctx.res.SetBody<DefaultBody>("user " + ctx.param["id"]); });
+
+        REQUIRE(recorder.open(log_path));
+        serve(io_service, router, {"GET /users/1 HTTP/1.1\r\n", "Host: localhost\r\n\r\n"});
+        serve(io_service, router, {"GET /users/2 HTTP/1.1\r\nHost: localhost\r\n\r\n"});
+        recorder.close();
+
+        auto records = read_log(log_path);
+        REQUIRE(records.size() == 7);
+        REQUIRE(records[0].kind == TrafficRecord::Kind::open);
+        REQUIRE(records[1].data == "GET /users/1 HTTP/1.1\r\n");
+        REQUIRE(records[2].data == "Host: localhost\r\n\r\n");
+        REQUIRE(records[3].kind == TrafficRecord::Kind::close);
+        REQUIRE(records[3].connection == 1);
+        REQUIRE(records[4].connection == 2);
+        REQUIRE(records[5].data == "GET /users/2 HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        REQUIRE(records[6].kind == TrafficRecord::Kind::close);
+    }
+
+    SECTION("log is readable by owner only")
+    {
+        ofstream(log_path, ios::binary | ios::trunc) << "older log";
+        REQUIRE(chmod(log_path.c_str(), 0644) == 0);
+        REQUIRE(recorder.open(log_path));
+        recorder.close();
+
+        struct stat st;
+        REQUIRE(stat(log_path.c_str(), &st) == 0);
+        REQUIRE((st.st_mode & 0777) == 0600);
+    }
+
+    SECTION("credentials are masked, however reads split them")
+    {
+        const string body = "Cookie: in body a=1\r\n";
+        const string request_head = "GET / HTTP/1.1\r\nAuthorization:";
+        const string requests = request_head + " Bearer secret\r\nHost: localhost\r\ncookie: a=1;\r\n b=2\r\n\r\n"
+                                "POST /form HTTP/1.1\r\ncontent-length: 21\r\n\r\n" + body +
+                                "POST /chunks HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n15\r\n" + body + "\r\n0\r\n\r\n"
+                                "GET / HTTP/1.1\r\nProxy-Authorization: Basic dXNlcg==\r\n\r\n";
+        const string masked = request_head + string(14, '*') + "\r\nHost: localhost\r\ncookie:" + string(5, '*') + "\r\n" + string(4, '*') + "\r\n\r\n"
+                              "POST /form HTTP/1.1\r\ncontent-length: 21\r\n\r\n" + body +
+                              "POST /chunks HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n15\r\n" + body + "\r\n0\r\n\r\n"
+                              "GET / HTTP/1.1\r\nProxy-Authorization:" + string(15, '*') + "\r\n\r\n";
+
+        for (size_t step : {size_t(1), size_t(5), requests.size()}) {
+            REQUIRE(recorder.open(log_path));
+            auto connection = recorder.opened();
+            for (size_t i = 0; i < requests.size(); i += step)
+                recorder.received(connection, requests.data() + i, min(step, requests.size() - i));
+            recorder.closed(connection);
+            recorder.close();
+
+            string recorded;
+            for (auto &record : read_log(log_path)) recorded += record.data;
+            REQUIRE(recorded == masked);
+        }
+    }
+
+    SECTION("masking can be turned off")
+    {
+        TrafficRecorderOptions options;
+        options.redacted_headers.clear();
+        const string request = "GET / HTTP/1.1\r\nAuthorization: Bearer secret\r\nCookie: a=1\r\n\r\n";
+
+        REQUIRE(recorder.open(log_path, options));
+        auto connection = recorder.opened();
+        recorder.received(connection, request.data(), request.size());
+        recorder.close();
+
+        auto records = read_log(log_path);
+        REQUIRE(records.size() == 2);
+        REQUIRE(records[1].data == request);
+    }
+
+    SECTION("not a log")
+    {
+        ofstream(log_path, ios::binary | ios::trunc) << "GET / HTTP/1.1\r\n";
+        TrafficReader reader(log_path);
+        REQUIRE(!reader.good());
+        TrafficRecord record;
+        REQUIRE(!reader.next(record));
+    }
+
+    remove(log_path.c_str());
+}
@@ -5,6 +5,7 @@
 
 #include "Utils.h"
 #include "Codec.h"
+#include "Histogram.h"
 #include "StrUtils.h"
 #include "Url.h"
 #include "Router.h"
@@ -323,6 +324,23 @@ TEST_CASE("StrUtils")
                                         "<a>", "1",
                                         {{"a", "1"}});
     }
+
+
+    SECTION("http date")
+    {
+        REQUIRE(format_http_date(784111777) == "Sun, 06 Nov 1994 08:49:37 GMT");
+        REQUIRE(parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT") == 784111777);
+        REQUIRE(parse_http_date(format_http_date(0)) == 0);
+        REQUIRE(parse_http_date("") == -1);
+        REQUIRE(parse_http_date("yesterday") == -1);
+    }
+
+
+    SECTION("iequals")
+    {
+        REQUIRE(iequals("gzip", "GZip"));
+        REQUIRE_FALSE(iequals("gzip", "gzip2"));
+    }
 }
 
 
@@ -361,6 +379,9 @@ TEST_CASE("Codec") {
     test_base64({"easure.", "ZWFzdXJlLg=="});
     test_base64({"asure.", "YXN1cmUu"});
     test_base64({"sure.", "c3VyZS4="});
+
+    REQUIRE(Base64Codec::decode(BYTE_STRING((const BYTE *)"c3VyZS4", 7)).second == false);
+    REQUIRE(Base64Codec::decode(BYTE_STRING((const BYTE *)"c3V!ZS4=", 8)).second == false);
   }
 
 
@@ -398,6 +419,37 @@ TEST_CASE("Codec") {
          "cfcc61b181e8c87e765f8a17913258394088eab1976b110f9bf0bb5388e4304b"});
   }
 
+
+  SECTION("xxh64") {
+    REQUIRE(XXH64Codec::digest("") == 0xef46db3751d8e999ULL);
+    REQUIRE(XXH64Codec::digest("abc") == 0x44bc2cf5ad770999ULL);
+    REQUIRE(XXH64Codec::digest("Nobody inspects the spammish repetition") == 0xfbcea83c8a378bf1ULL);
+    REQUIRE(XXH64Codec::digest(std::string(100, 'a'), 1) == 0x65af8ded6639a61aULL);
+  }
+
 }
 
 
+
+
+TEST_CASE("Histogram") {
+
+  Histogram h({1, 2, 4});
+  REQUIRE(h.snapshot().quantile(0.5) == 0);
+
+  for (double v : {0.5, 1.0, 1.5, 3.0, 3.0, 8.0})
+    h.observe(v);
+
+  auto s = h.snapshot();
+  REQUIRE(s.counts == std::vector<std::uint64_t>{2, 1, 2, 1});
+  REQUIRE(s.count == 6);
+  REQUIRE(s.sum == Approx(17.0));
+  // 3rd of 6 is only value in (1, 2]
+  REQUIRE(s.quantile(0.5) == Approx(2.0));
+  REQUIRE(s.quantile(0.25) == Approx(0.75));
+  // overflow is capped at last bound
+  REQUIRE(s.quantile(1) == Approx(4.0));
+
+  h.reset();
+  REQUIRE(h.snapshot().count == 0);
+}
@@ -0,0 +1,193 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "catch.hpp"
+
+#include "Router.h"
+#include "WorkPool.h"
+
+using namespace Theros;
+
+TEST_CASE("WorkPool", "[WorkPool]")
+{
+    asio::io_service io_service;
+    auto &pool = asio::use_service<WorkPool>(io_service);
+
+    std::mutex mutex;
+    std::condition_variable done;
+    auto wait_for = [&](std::atomic<int> &counter, int n) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return done.wait_for(lock, std::chrono::seconds(5), [&]() { return counter >= n; });
+    };
+
+    SECTION("runs tasks off calling thread")
+    {
+        WorkPoolOptions options;
+        options.threads = 4;
+        std::atomic<int> observed{0};
+        options.on_queue_time = [&observed](WorkPool::Clock::duration) { ++observed; };
+        REQUIRE(pool.configure(options));
+
+        std::atomic<int> ran{0};
+        std::atomic<int> on_caller{0};
+        auto caller = std::this_thread::get_id();
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(pool.submit([&]() {
+                if (std::this_thread::get_id() == caller || !pool.in_worker()) ++on_caller;
+                ++ran;
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }));
+        }
+        REQUIRE(wait_for(ran, 100));
+        REQUIRE(on_caller == 0);
+        REQUIRE(!pool.in_worker());
+        REQUIRE(pool.threads() == 4);
+        REQUIRE_FALSE(pool.configure(options));
+
+        auto stats = pool.stats();
+        REQUIRE(stats.queued == 0);
+        REQUIRE(observed == 100);
+        REQUIRE(stats.queue_time_max <= stats.queue_time_total);
+    }
+
+    SECTION("idle workers steal tasks submitted from a worker")
+    {
+        WorkPoolOptions options;
+        options.threads = 4;
+        pool.configure(options);
+
+        std::atomic<int> ran{0};
+        pool.submit([&]() {
+            // all land on this worker's deque, others have to steal them
+            for (int i = 0; i < 64; ++i) {
+                pool.submit([&]() {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    ++ran;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done.notify_all();
+                });
+            }
+        });
+        REQUIRE(wait_for(ran, 64));
+        REQUIRE(pool.stats().stolen > 0);
+    }
+
+    SECTION("rejects over max_queued")
+    {
+        WorkPoolOptions options;
+        options.threads = 1;
+        options.max_queued = 2;
+        pool.configure(options);
+
+        std::mutex gate;
+        std::unique_lock<std::mutex> closed(gate);
+        std::atomic<int> ran{0};
+        auto task = [&]() {
+            std::lock_guard<std::mutex> wait(gate);
+            ++ran;
+            std::lock_guard<std::mutex> lock(mutex);
+            done.notify_all();
+        };
+
+        // first one is taken by worker and blocks on gate, 2 more fill queue
+        REQUIRE(pool.submit(task));
+        while (pool.stats().queued != 0) std::this_thread::yield();
+        REQUIRE(pool.submit(task));
+        REQUIRE(pool.submit(task));
+        REQUIRE_FALSE(pool.submit(task));
+        REQUIRE(pool.stats().rejected == 1);
+
+        closed.unlock();
+        REQUIRE(wait_for(ran, 3));
+    }
+}
+
+
+TEST_CASE("Context::parallel", "[WorkPool]")
+{
+    asio::io_service io_service;
+    WorkPoolOptions options;
+    options.threads = 4;
+    asio::use_service<WorkPool>(io_service).configure(options);
+
+    Request req;
+    Response res;
+    Context ctx(req, res);
+
+    // stands in for connection, hands hook of resume, called from a worker, to this thread
+    std::mutex mutex;
+    std::condition_variable resumed_cv;
+    Context::HookFunc resumed;
+    ctx.attach_defer([&](std::chrono::steady_clock::duration, Context::HookFunc) {
+        return [&](Context::HookFunc f) {
+            std::lock_guard<std::mutex> lock(mutex);
+            resumed = std::move(f);
+            resumed_cv.notify_all();
+        };
+    });
+    auto wait_resumed = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return resumed_cv.wait_for(lock, std::chrono::seconds(5), [&]() { return bool(resumed); });
+    };
+
+    std::string order;
+    std::vector<std::function<int()>> tasks;
+    for (int i = 0; i < 16; ++i)
+        tasks.push_back([i]() { std::this_thread::sleep_for(std::chrono::milliseconds(1)); return i * i; });
+
+    SECTION("outside of a connection tasks run inline")
+    {
+        int sum = 0;
+        ctx.parallel<int>(tasks, [&](Context &, std::vector<int> &results) {
+            for (auto r : results) sum += r;
+        });
+        REQUIRE(sum == 1240);
+        REQUIRE(!ctx.ended());
+    }
+
+    ctx.io_service = &io_service;
+
+    SECTION("results are merged in order, then rest of chain runs")
+    {
+        std::vector<int> merged;
+        Handler handler([&](Context &ctx) {
+                            order += "a";
+                            ctx.parallel<int>(tasks, [&](Context &ctx, std::vector<int> &results) {
+                                merged = results;
+                                order += "m";
+                            });
+                        },
+                        [&]() { order += "b"; });
+        handler(ctx);
+        REQUIRE(order == "a");
+        REQUIRE(ctx.ended());
+
+        REQUIRE(wait_resumed());
+        resumed(ctx);
+        REQUIRE(order == "amb");
+        REQUIRE(merged.size() == 16);
+        for (int i = 0; i < 16; ++i)
+            REQUIRE(merged[i] == i * i);
+    }
+
+    SECTION("task that throws is a 500")
+    {
+        tasks[3] = []() -> int { throw std::runtime_error("failed"); };
+        bool merged = false;
+        Handler handler([&](Context &ctx) {
+                            ctx.parallel<int>(tasks, [&](Context &, std::vector<int> &) { merged = true; });
+                        },
+                        [&]() { order += "b"; });
+        handler(ctx);
+        REQUIRE(wait_resumed());
+        resumed(ctx);
+        REQUIRE(!merged);
+        REQUIRE(order == "");
+        REQUIRE(res.status_code == StatusCode::Internal_Server_Error);
+    }
+}
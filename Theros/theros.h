@@ -8,17 +8,35 @@
 #include "src/utilities/StrUtils.h"
 #include "src/utilities/Url.h"
 #include "src/utilities/Trie.h"
+#include "src/utilities/Histogram.h"
 
 #include "src/Defines.h"
 #include "src/Constants.h"
 #include "src/Message.h"
 #include "src/RequestParser.h"
 #include "src/Router.h"
+#include "src/WorkPool.h"
+#include "src/AdmissionControl.h"
+#include "src/LoopMonitor.h"
+#include "src/Metrics.h"
+#include "src/Trace.h"
+#include "src/AllocProfiler.h"
+#include "src/TrafficRecorder.h"
+#include "src/AccessLog.h"
+#include "src/MemorySocket.h"
+#include "src/Task.h"
+#include "src/Coroutine.h"
 #include "src/Connection.h"
+#include "src/ServerConfig.h"
 #include "src/Server.h"
 
 #include "src/middlewares/Cors.h"
 #include "src/middlewares/QueryParser.h"
+#include "src/middlewares/StaticFiles.h"
+#include "src/middlewares/Compression.h"
+#include "src/middlewares/ResponseCache.h"
+#include "src/middlewares/ETag.h"
+#include "src/middlewares/SingleFlight.h"
 
 
 
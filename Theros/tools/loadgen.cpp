@@ -0,0 +1,655 @@
+/**
+ * HTTP load generator, drives an HttpServer or HttpsServer over loopback, or any address
+ *
+ *      ./bin/loadgen --port=8888 --connections=32 --duration=10 \
+ *          --request='GET /users/1' --request='3*GET /home?tab=feed' --request='POST /orders {"item":1}'
+ *
+ *      --host=127.0.0.1, --port=8888, --tls
+ *      --connections=16    kept open, split over threads
+ *      --threads=1         each runs an io_service of its own
+ *      --depth=1           requests pipelined on a connection
+ *      --no-keep-alive     one request per connection, sent with Connection: close
+ *      --duration=10       seconds
+ *      --rate=0            requests per second over all connections, open loop, 0 for closed loop
+ *      --request=<spec>    [weight*]METHOD target [body], repeatable, picked at random by weight
+ *      --json              report as JSON
+ *
+ * In closed loop mode a connection sends as soon as responses come back. In open loop mode requests
+ * are due on a fixed schedule, and latency counts from when a request was due rather than from when
+ * it was sent, so a server that stalls cannot hold back the requests that would have measured the
+ * stall (coordinated omission)
+ */
+#include "theros.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace Theros;
+
+using Clock = chrono::steady_clock;
+using Timer = asio::basic_waitable_timer<Clock>;
+
+namespace
+{
+
+struct Options {
+    string host = "127.0.0.1";
+    int port = 8888;
+    bool tls = false;
+    size_t connections = 16;
+    size_t threads = 1;
+    size_t depth = 1;
+    bool keep_alive = true;
+    double duration = 10;
+    double rate = 0;
+    bool json = false;
+    vector<string> requests;
+};
+
+struct RequestSpec {
+    Request request;
+    string payload;         // serialized request
+    unsigned weight;
+};
+
+/** Request line, headers and body, as sent by a client */
+string serialize(const Request &req)
+{
+    string s = request_method_as_string(req.method) + " " + req.uri.abs_path;
+    if (!req.uri.query.empty()) s += "?" + req.uri.query;
+    s += " " + version_as_string(req.version) + CRLF;
+    for (auto &header : req.headers)
+        s += header.name + ": " + header.value + CRLF;
+    return s + CRLF + req.body;
+}
+
+/** Parses "[weight*]METHOD target [body]" */
+RequestSpec make_spec(const string &text, const Options &options)
+{
+    RequestSpec spec{};
+    spec.weight = 1;
+
+    string rest = text;
+    auto star = rest.find('*');
+    if (star != string::npos && star < rest.find(' ')) {
+        spec.weight = static_cast<unsigned>(stoul(rest.substr(0, star)));
+        rest = rest.substr(star + 1);
+    }
+    auto space = rest.find(' ');
+    string method = rest.substr(0, space);
+    string target = space == string::npos ? "/" : rest.substr(space + 1);
+    string body;
+    space = target.find(' ');
+    if (space != string::npos) {
+        body = target.substr(space + 1);
+        target = target.substr(0, space);
+    }
+
+    auto &req = spec.request;
+    req.method = request_method_from_cstr(method.c_str());
+    if (req.method == RequestMethod::UNDETERMINED)
+        throw invalid_argument("unknown method: " + text);
+    req.version = HttpVersion::one_one;
+    auto question = target.find('?');
+    req.uri.abs_path = target.substr(0, question);
+    if (question != string::npos) req.uri.query = target.substr(question + 1);
+    req.SetHeader({"Host", options.host + ":" + to_string(options.port)});
+    req.SetHeader({"User-Agent", "theros-loadgen"});
+    if (!body.empty()) {
+        req.body = body;
+        req.ContentLength(static_cast<int>(body.size()));
+    }
+    if (!options.keep_alive) req.SetHeader({"Connection", "close"});
+    spec.payload = serialize(req);
+
+    // checked with the parser of the server, a typo fails here rather than as a run of 400s
+    RequestParser parser;
+    Request parsed;
+    auto status = get<1>(parser.parse(parsed, spec.payload.begin(), spec.payload.end()));
+    if (status != ParseStatus::accept)
+        throw invalid_argument("malformed request: " + text);
+    return spec;
+}
+
+
+/**
+ * @brief   Splits bytes read off a connection into responses, by Content-Length, chunked encoding,
+ *          or connection close. Responses to HEAD have no body, interim 1xx responses are skipped
+ */
+class ResponseReader
+{
+public:
+    /** Method of next request sent, responses are matched to requests in order */
+    void expect(RequestMethod method) { head_requests_.push_back(method == RequestMethod::HEAD); }
+
+    /** Consumes data, calls on_response(status) once per complete response, false if malformed */
+    template <typename F>
+    bool feed(const char *data, size_t size, F &&on_response)
+    {
+        buffer_.append(data, size);
+        while (true) {
+            switch (state_) {
+            case State::head: {
+                auto end = buffer_.find("\r\n\r\n");
+                if (end == string::npos) return buffer_.size() < ConnectionOptions().max_header_bytes;
+                if (!parse_head(buffer_.substr(0, end + 2))) return false;
+                buffer_.erase(0, end + 4);
+                // interim response, final one to same request follows
+                if (status_ >= 100 && status_ < 200 && status_ != 101) break;
+                if (state_ == State::head) on_response(status_);
+                break;
+            }
+            case State::body:
+            case State::chunk_data: {
+                auto n = min<size_t>(remaining_, buffer_.size());
+                buffer_.erase(0, n);
+                remaining_ -= n;
+                if (remaining_) return true;
+                if (state_ == State::chunk_data) {
+                    state_ = State::chunk_size;
+                    break;
+                }
+                state_ = State::head;
+                on_response(status_);
+                break;
+            }
+            case State::chunk_size: {
+                auto end = buffer_.find(CRLF);
+                if (end == string::npos) return true;
+                auto size = strtoull(buffer_.c_str(), nullptr, 16);
+                buffer_.erase(0, end + 2);
+                state_ = size ? State::chunk_data : State::chunk_trailer;
+                remaining_ = size + 2;      // chunk data is followed by CRLF
+                break;
+            }
+            case State::chunk_trailer: {
+                auto end = buffer_.find(CRLF);
+                if (end == string::npos) return true;
+                buffer_.erase(0, end + 2);
+                if (end == 0) {
+                    state_ = State::head;
+                    on_response(status_);
+                }
+                break;
+            }
+            case State::until_close:
+                buffer_.clear();
+                return true;
+            }
+            if (buffer_.empty()) return true;
+        }
+    }
+
+    /** Connection was closed, completes a response delimited by close */
+    template <typename F>
+    void close(F &&on_response)
+    {
+        if (state_ == State::until_close) on_response(status_);
+        reset();
+    }
+
+    void reset()
+    {
+        state_ = State::head;
+        buffer_.clear();
+        remaining_ = 0;
+        head_requests_.clear();
+    }
+
+private:
+    enum class State { head, body, chunk_size, chunk_data, chunk_trailer, until_close };
+
+    State state_ = State::head;
+    string buffer_;
+    uint64_t remaining_ = 0;
+    int status_ = 0;
+    deque<bool> head_requests_;     // of requests not answered yet, true if HEAD
+
+    static bool iequals(const string &a, const char *b)
+    {
+        return equal(a.begin(), a.end(), b, b + strlen(b),
+                     [](char x, char y) { return tolower(x) == tolower(y); });
+    }
+
+    bool parse_head(const string &head)
+    {
+        auto space = head.find(' ');
+        if (head.compare(0, 5, "HTTP/") != 0 || space == string::npos) return false;
+        status_ = atoi(head.c_str() + space + 1);
+
+        bool chunked = false;
+        bool has_length = false;
+        uint64_t length = 0;
+        size_t at = head.find(CRLF) + 2;
+        while (at < head.size()) {
+            auto end = head.find(CRLF, at);
+            auto colon = head.find(':', at);
+            if (colon != string::npos && colon < end) {
+                string name = head.substr(at, colon - at);
+                string value = head.substr(colon + 1, end - colon - 1);
+                value.erase(0, value.find_first_not_of(' '));
+                if (iequals(name, "Content-Length")) {
+                    has_length = true;
+                    length = strtoull(value.c_str(), nullptr, 10);
+                } else if (iequals(name, "Transfer-Encoding")) {
+                    chunked = value.find("chunked") != string::npos;
+                }
+            }
+            at = end + 2;
+        }
+
+        if (status_ < 200) {
+            state_ = State::head;
+            return true;
+        }
+        bool head_request = !head_requests_.empty() && head_requests_.front();
+        if (!head_requests_.empty()) head_requests_.pop_front();
+
+        // Content-Length of a response to HEAD is that of body it would have had
+        if (head_request || status_ == 204 || status_ == 304) {
+            state_ = State::head;
+        } else if (chunked) {
+            state_ = State::chunk_size;
+        } else if (has_length) {
+            remaining_ = length;
+            state_ = length ? State::body : State::head;
+        } else {
+            state_ = State::until_close;
+        }
+        return true;
+    }
+};
+
+
+struct Stats {
+    HdrHistogram::Snapshot latency;     // nanoseconds
+    uint64_t completed = 0;
+    uint64_t errors = 0;
+    uint64_t bytes = 0;
+    uint64_t connects = 0;
+    uint64_t backlog = 0;               // due or sent but not answered once run ended
+    map<int, uint64_t> statuses;
+
+    void merge(const Stats &other)
+    {
+        latency.merge(other.latency);
+        completed += other.completed;
+        errors += other.errors;
+        bytes += other.bytes;
+        connects += other.connects;
+        backlog += other.backlog;
+        for (auto &status : other.statuses) statuses[status.first] += status.second;
+    }
+};
+
+
+/**
+ * @brief   Connections of one thread, on an io_service of its own
+ */
+template <typename Stream>
+class Worker
+{
+public:
+    Worker(const Options &options, const vector<RequestSpec> &specs, size_t connections, size_t seed)
+        : options_(options), specs_(specs), ssl_context_(asio::ssl::context::sslv23), random_(seed)
+    {
+        ssl_context_.set_verify_mode(asio::ssl::verify_none);
+        for (auto &spec : specs_) weights_.push_back((weights_.empty() ? 0 : weights_.back()) + spec.weight);
+        for (size_t i = 0; i < connections; ++i)
+            clients_.push_back(make_shared<Client>(*this));
+    }
+
+    void run(Clock::time_point start, Clock::time_point end)
+    {
+        Timer deadline(io_service_);
+        deadline.expires_at(end);
+        deadline.async_wait([this](error_code) { io_service_.stop(); });
+
+        // open loop, connection i is due every interval, offset so connections do not send in bursts
+        auto interval = chrono::duration_cast<Clock::duration>(
+            chrono::duration<double>(options_.rate > 0 ? options_.connections / options_.rate : 0));
+        for (size_t i = 0; i < clients_.size(); ++i)
+            clients_[i]->start(start + interval * i / clients_.size(), interval);
+        io_service_.run();
+
+        for (auto &client : clients_) stats_.backlog += client->backlog();
+        stats_.latency = latency_.snapshot();
+    }
+
+    const Stats &stats() const { return stats_; }
+
+private:
+    class Client : public enable_shared_from_this<Client>
+    {
+    public:
+        explicit Client(Worker &worker) : worker_(worker), schedule_(worker.io_service_), retry_(worker.io_service_) {}
+
+        void start(Clock::time_point first_due, Clock::duration interval)
+        {
+            interval_ = interval;
+            next_due_ = first_due;
+            if (open_loop()) schedule();
+            connect();
+        }
+
+        size_t backlog() const { return due_.size() + outstanding_.size(); }
+
+    private:
+        Worker &worker_;
+        unique_ptr<Stream> stream_;
+        Timer schedule_;
+        Timer retry_;
+        Clock::duration interval_;
+        Clock::time_point next_due_;
+        deque<Clock::time_point> due_;          // not yet sent, by when they were due
+        deque<Clock::time_point> outstanding_;  // sent, in order of their responses
+        ResponseReader reader_;
+        string write_buffer_;
+        array<char, 1 << 14> read_buffer_;
+        bool connected_ = false;
+        bool writing_ = false;
+        size_t sent_ = 0;           // on current connection
+        size_t answered_ = 0;       // on current connection
+
+        const Options &options() const { return worker_.options_; }
+        bool open_loop() const { return options().rate > 0; }
+
+        void schedule()
+        {
+            schedule_.expires_at(next_due_);
+            schedule_.async_wait([this, self = this->shared_from_this()](error_code ec) {
+                if (ec) return;
+                // loop may run late, every request due by now is queued
+                for (auto now = Clock::now(); next_due_ <= now; next_due_ += interval_)
+                    due_.push_back(next_due_);
+                pump();
+                schedule();
+            });
+        }
+
+        void connect()
+        {
+            connected_ = false;
+            sent_ = answered_ = 0;
+            reader_.reset();
+            stream_ = make_stream();
+
+            asio::ip::tcp::endpoint endpoint(asio::ip::address::from_string(options().host), options().port);
+            stream_->lowest_layer().async_connect(endpoint, [this, self = this->shared_from_this()](error_code ec) {
+                if (ec) {
+                    fail();
+                    return;
+                }
+                asio::error_code ignored;
+                stream_->lowest_layer().set_option(asio::ip::tcp::no_delay(true), ignored);
+                handshake([this, self]() {
+                    ++worker_.stats_.connects;
+                    connected_ = true;
+                    read();
+                    pump();
+                });
+            });
+        }
+
+        unique_ptr<Stream> make_stream()
+        {
+            if constexpr (is_same_v<Stream, SslSocket>)
+                return make_unique<Stream>(worker_.io_service_, worker_.ssl_context_);
+            else
+                return make_unique<Stream>(worker_.io_service_);
+        }
+
+        template <typename F>
+        void handshake(F &&f)
+        {
+            if constexpr (is_same_v<Stream, SslSocket>) {
+                stream_->async_handshake(asio::ssl::stream_base::client,
+                    [this, self = this->shared_from_this(), f](error_code ec) {
+                        if (ec) {
+                            fail();
+                            return;
+                        }
+                        f();
+                    });
+            } else {
+                f();
+            }
+        }
+
+        void pump()
+        {
+            if (!connected_ || writing_) return;
+
+            auto limit = options().keep_alive ? options().depth : 1;
+            if (!open_loop())
+                while (due_.size() + outstanding_.size() < limit) due_.push_back(Clock::now());
+
+            write_buffer_.clear();
+            while (!due_.empty() && outstanding_.size() < limit && (options().keep_alive || sent_ == 0)) {
+                auto &spec = worker_.pick();
+                write_buffer_ += spec.payload;
+                reader_.expect(spec.request.method);
+                outstanding_.push_back(due_.front());
+                due_.pop_front();
+                ++sent_;
+            }
+            if (write_buffer_.empty()) return;
+
+            writing_ = true;
+            asio::async_write(*stream_, asio::buffer(write_buffer_),
+                [this, self = this->shared_from_this()](error_code ec, size_t) {
+                    writing_ = false;
+                    if (ec) {
+                        reconnect();
+                        return;
+                    }
+                    pump();
+                });
+        }
+
+        void read()
+        {
+            stream_->async_read_some(asio::buffer(read_buffer_),
+                [this, self = this->shared_from_this()](error_code ec, size_t n) {
+                    auto on_response = [this](int status) { complete(status); };
+                    if (ec) {
+                        reader_.close(on_response);
+                        reconnect();
+                        return;
+                    }
+                    worker_.stats_.bytes += n;
+                    if (!reader_.feed(read_buffer_.data(), n, on_response)) {
+                        ++worker_.stats_.errors;
+                        outstanding_.clear();
+                        reconnect();
+                        return;
+                    }
+                    if (!options().keep_alive && answered_ == sent_ && sent_) {
+                        reconnect();
+                        return;
+                    }
+                    pump();
+                    read();
+                });
+        }
+
+        void complete(int status)
+        {
+            if (outstanding_.empty()) return;
+            auto latency = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - outstanding_.front()).count();
+            outstanding_.pop_front();
+            ++answered_;
+            ++worker_.stats_.completed;
+            ++worker_.stats_.statuses[status];
+            worker_.latency_.record(static_cast<uint64_t>(max<decltype(latency)>(latency, 0)));
+        }
+
+        // requests without a response are sent again on a new connection, due when they were
+        void reconnect()
+        {
+            if (!connected_) return;
+            connected_ = false;
+            if (answered_ == 0 && !outstanding_.empty()) {
+                // closed before answering anything, drop one so a refusing server does not spin us
+                ++worker_.stats_.errors;
+                outstanding_.pop_front();
+            }
+            due_.insert(due_.begin(), outstanding_.begin(), outstanding_.end());
+            outstanding_.clear();
+            asio::error_code ignored;
+            stream_->lowest_layer().close(ignored);
+            connect();
+        }
+
+        void fail()
+        {
+            ++worker_.stats_.errors;
+            retry_.expires_from_now(chrono::milliseconds(100));
+            retry_.async_wait([this, self = this->shared_from_this()](error_code ec) {
+                if (!ec) connect();
+            });
+        }
+    };
+
+    const Options &options_;
+    const vector<RequestSpec> &specs_;
+    asio::io_service io_service_;
+    asio::ssl::context ssl_context_;
+    vector<shared_ptr<Client>> clients_;
+    vector<unsigned> weights_;      // cumulative
+    mt19937_64 random_;
+    HdrHistogram latency_;          // nanoseconds
+    Stats stats_;
+
+    const RequestSpec &pick()
+    {
+        auto r = random_() % weights_.back();
+        return specs_[upper_bound(weights_.begin(), weights_.end(), r) - weights_.begin()];
+    }
+};
+
+template <typename Stream>
+Stats run(const Options &options, const vector<RequestSpec> &specs)
+{
+    vector<unique_ptr<Worker<Stream>>> workers;
+    for (size_t t = 0; t < options.threads; ++t) {
+        auto connections = options.connections * (t + 1) / options.threads - options.connections * t / options.threads;
+        workers.push_back(make_unique<Worker<Stream>>(options, specs, connections, t + 1));
+    }
+
+    auto start = Clock::now();
+    auto end = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.duration));
+    vector<thread> threads;
+    for (auto &worker : workers)
+        threads.emplace_back([&worker, start, end]() { worker->run(start, end); });
+    for (auto &t : threads) t.join();
+
+    Stats stats;
+    for (auto &worker : workers) stats.merge(worker->stats());
+    return stats;
+}
+
+double ms(uint64_t ns) { return ns / 1e6; }
+
+void report(const Options &options, const Stats &stats)
+{
+    const vector<pair<string, double>> quantiles = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p99.9", 0.999}};
+    double mean = stats.latency.count ? static_cast<double>(stats.latency.sum) / stats.latency.count : 0;
+
+    if (options.json) {
+        JsonType latency = {{"mean", ms(mean)}, {"max", ms(stats.latency.max)}};
+        for (auto &q : quantiles) latency[q.first] = ms(stats.latency.quantile(q.second));
+        JsonType statuses = JsonType::object();
+        for (auto &status : stats.statuses) statuses[to_string(status.first)] = status.second;
+        JsonType result = {
+            {"connections", options.connections},
+            {"depth", options.depth},
+            {"keep_alive", options.keep_alive},
+            {"rate", options.rate},
+            {"duration", options.duration},
+            {"completed", stats.completed},
+            {"errors", stats.errors},
+            {"backlog", stats.backlog},
+            {"connects", stats.connects},
+            {"requests_per_second", stats.completed / options.duration},
+            {"bytes_per_second", stats.bytes / options.duration},
+            {"latency_ms", latency},
+            {"statuses", statuses},
+        };
+        cout << result.dump(2) << eol;
+        return;
+    }
+
+    printf("%zu connections, depth %zu, %s, %s, %.1fs\n", options.connections, options.depth,
+           options.keep_alive ? "keep-alive" : "no keep-alive",
+           options.rate > 0 ? ("open loop at " + to_string(static_cast<long>(options.rate)) + " req/s").c_str() : "closed loop",
+           options.duration);
+    printf("  requests    %llu completed, %llu errors, %llu backlog, %llu connects\n",
+           (unsigned long long)stats.completed, (unsigned long long)stats.errors,
+           (unsigned long long)stats.backlog, (unsigned long long)stats.connects);
+    printf("  throughput  %.1f req/s, %.2f MiB/s\n", stats.completed / options.duration,
+           stats.bytes / options.duration / (1 << 20));
+    printf("  latency     mean %.3fms", ms(mean));
+    for (auto &q : quantiles) printf("  %s %.3fms", q.first.c_str(), ms(stats.latency.quantile(q.second)));
+    printf("  max %.3fms\n", ms(stats.latency.max));
+    printf("  status     ");
+    for (auto &status : stats.statuses) printf(" %d: %llu", status.first, (unsigned long long)status.second);
+    printf("\n");
+}
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        auto value = arg.substr(arg.find('=') + 1);
+        if (arg.rfind("--host=", 0) == 0) options.host = value;
+        else if (arg.rfind("--port=", 0) == 0) options.port = atoi(value.c_str());
+        else if (arg == "--tls") options.tls = true;
+        else if (arg.rfind("--connections=", 0) == 0) options.connections = max(1, atoi(value.c_str()));
+        else if (arg.rfind("--threads=", 0) == 0) options.threads = max(1, atoi(value.c_str()));
+        else if (arg.rfind("--depth=", 0) == 0) options.depth = max(1, atoi(value.c_str()));
+        else if (arg == "--no-keep-alive") options.keep_alive = false;
+        else if (arg.rfind("--duration=", 0) == 0) options.duration = atof(value.c_str());
+        else if (arg.rfind("--rate=", 0) == 0) options.rate = atof(value.c_str());
+        else if (arg.rfind("--request=", 0) == 0) options.requests.push_back(value);
+        else if (arg == "--json") options.json = true;
+        else {
+            fprintf(stderr, "usage: %s [--host=] [--port=] [--tls] [--connections=] [--threads=] [--depth=] "
+                            "[--no-keep-alive] [--duration=] [--rate=] [--request='[weight*]METHOD target [body]']... [--json]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (options.requests.empty()) options.requests.push_back("GET /");
+    options.threads = min(options.threads, options.connections);
+
+    try {
+        vector<RequestSpec> specs;
+        for (auto &text : options.requests) specs.push_back(make_spec(text, options));
+        auto stats = options.tls ? run<SslSocket>(options, specs) : run<TcpSocket>(options, specs);
+        report(options, stats);
+    } catch (const exception &e) {
+        cerr << e.what() << eol;
+        return 1;
+    }
+    return 0;
+}
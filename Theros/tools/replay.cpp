@@ -0,0 +1,346 @@
+/**
+ * Replays a traffic log written by TrafficRecorder against a server, reproducing its connections,
+ * the bytes sent on each and where the reads split them, at recorded pace or as fast as possible
+ *
+ *      app.recorder().open("traffic.log");         // on the recorded server, before run()
+ *      ./bin/replay traffic.log --port=8888
+ *      ./bin/replay traffic.log --port=8888 --fast --connections=64
+ *
+ *      --host=127.0.0.1, --port=8888
+ *      --speed=1           pace of replay relative to recording, 2 for twice as fast
+ *      --fast              as fast as possible, ignoring timestamps
+ *      --connections=64    open at once with --fast
+ *      --linger=5          seconds a connection may stay open after its recorded close
+ *      --json              report as JSON
+ *
+ * Connections open in recorded order. At recorded pace each one opens, and each of its chunks is sent,
+ * when due relative to start of replay, and the report says how far behind schedule sends fell.
+ * TLS traffic is recorded decrypted, so it is replayed over plain TCP, to an HttpServer
+ */
+#include "theros.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace Theros;
+
+using Clock = chrono::steady_clock;
+using Timer = asio::basic_waitable_timer<Clock>;
+
+namespace
+{
+
+struct Options {
+    string log;
+    string host = "127.0.0.1";
+    int port = 8888;
+    double speed = 1;
+    bool fast = false;
+    size_t connections = 64;
+    double linger = 5;
+    bool json = false;
+};
+
+/** Inbound side of a recorded connection */
+struct Conversation {
+    chrono::microseconds opened{0};
+    chrono::microseconds closed{0};
+    vector<pair<chrono::microseconds, string>> chunks;      // as read by server, at when
+};
+
+struct Stats {
+    size_t connections = 0;
+    size_t errors = 0;          // failed to connect, send or receive
+    size_t timed_out = 0;       // still open after linger
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_received = 0;
+    map<int, size_t> statuses;  // of first response on a connection, 0 if there was none
+    Clock::duration max_lag{0}; // of a send behind schedule
+    Clock::duration elapsed{0};
+};
+
+vector<Conversation> load(const string &path)
+{
+    TrafficReader reader(path);
+    if (!reader.good()) throw runtime_error("not a traffic log: " + path);
+
+    vector<Conversation> conversations;
+    unordered_map<uint64_t, size_t> index;
+    TrafficRecord record;
+    while (reader.next(record)) {
+        if (record.kind == TrafficRecord::Kind::open) {
+            index[record.connection] = conversations.size();
+            conversations.emplace_back();
+            conversations.back().opened = conversations.back().closed = record.at;
+            continue;
+        }
+        auto it = index.find(record.connection);
+        if (it == index.end()) continue;
+        auto &conversation = conversations[it->second];
+        conversation.closed = record.at;
+        if (record.kind == TrafficRecord::Kind::data)
+            conversation.chunks.emplace_back(record.at, move(record.data));
+        else
+            index.erase(it);
+    }
+    return conversations;
+}
+
+class Replayer
+{
+public:
+    Replayer(const Options &options, const vector<Conversation> &conversations)
+        : options_(options), conversations_(conversations), launcher_(io_service_)
+    {
+        asio::ip::tcp::resolver resolver(io_service_);
+        endpoint_ = *resolver.resolve({options.host, to_string(options.port)});
+    }
+
+    Stats run()
+    {
+        started_ = Clock::now();
+        if (options_.fast) {
+            for (size_t i = 0; i < options_.connections; ++i) launch_next();
+        } else {
+            schedule_next();
+        }
+        io_service_.run();
+        stats_.elapsed = Clock::now() - started_;
+        return stats_;
+    }
+
+private:
+    class Session : public enable_shared_from_this<Session>
+    {
+    public:
+        Session(Replayer &replayer, const Conversation &conversation)
+            : replayer_(replayer), conversation_(conversation),
+              socket_(replayer.io_service_), pacer_(replayer.io_service_), linger_(replayer.io_service_) {}
+
+        void start()
+        {
+            ++replayer_.stats_.connections;
+            socket_.async_connect(replayer_.endpoint_, [this, self = shared_from_this()](asio::error_code ec) {
+                if (ec) return fail();
+                socket_.set_option(asio::ip::tcp::no_delay(true));
+                receive();
+                send_next();
+            });
+        }
+
+        ~Session()
+        {
+            replayer_.stats_.statuses[status()]++;
+            replayer_.finished();
+        }
+
+    private:
+        Replayer &replayer_;
+        const Conversation &conversation_;
+        TcpSocket socket_;
+        Timer pacer_;
+        Timer linger_;
+        size_t next_ = 0;
+        string head_;               // first bytes received, for status line
+        array<char, 4096> buffer_;
+        bool done_ = false;
+
+        void send_next()
+        {
+            if (done_) return;
+            if (next_ == conversation_.chunks.size()) return wait_for_close();
+
+            if (replayer_.options_.fast) return send();
+            auto due = replayer_.due(conversation_.chunks[next_].first);
+            pacer_.expires_at(due);
+            pacer_.async_wait([this, self = shared_from_this(), due](asio::error_code ec) {
+                if (ec || done_) return;
+                replayer_.stats_.max_lag = max(replayer_.stats_.max_lag, Clock::now() - due);
+                send();
+            });
+        }
+
+        void send()
+        {
+            auto &chunk = conversation_.chunks[next_].second;
+            asio::async_write(socket_, asio::buffer(chunk), [this, self = shared_from_this()](asio::error_code ec, size_t n) {
+                if (ec) return fail();
+                replayer_.stats_.bytes_sent += n;
+                ++next_;
+                send_next();
+            });
+        }
+
+        void receive()
+        {
+            socket_.async_read_some(asio::buffer(buffer_), [this, self = shared_from_this()](asio::error_code ec, size_t n) {
+                if (head_.size() < 16) head_.append(buffer_.data(), min<size_t>(n, 16 - head_.size()));
+                replayer_.stats_.bytes_received += n;
+                if (!ec) return receive();
+                if (ec != asio::error::eof && !done_) ++replayer_.stats_.errors;
+                finish();
+            });
+        }
+
+        // server closes once it responded, a connection it keeps open is given up after linger
+        void wait_for_close()
+        {
+            auto due = replayer_.options_.fast ? Clock::now() : max(Clock::now(), replayer_.due(conversation_.closed));
+            linger_.expires_at(due + chrono::duration_cast<Clock::duration>(chrono::duration<double>(replayer_.options_.linger)));
+            linger_.async_wait([this, self = shared_from_this()](asio::error_code ec) {
+                if (ec || done_) return;
+                ++replayer_.stats_.timed_out;
+                finish();
+            });
+        }
+
+        void fail()
+        {
+            if (!done_) ++replayer_.stats_.errors;
+            finish();
+        }
+
+        void finish()
+        {
+            if (done_) return;
+            done_ = true;
+            asio::error_code ec;
+            socket_.close(ec);
+            pacer_.cancel(ec);
+            linger_.cancel(ec);
+        }
+
+        int status() const
+        {
+            // HTTP/1.1 200
+            if (head_.size() < 12 || head_.compare(0, 5, "HTTP/") != 0) return 0;
+            return atoi(head_.c_str() + 9);
+        }
+    };
+
+    const Options &options_;
+    const vector<Conversation> &conversations_;
+    asio::io_service io_service_;
+    asio::ip::tcp::endpoint endpoint_;
+    Timer launcher_;
+    size_t next_ = 0;           // conversation to open next
+    Clock::time_point started_;
+    Stats stats_;
+
+    Clock::time_point due(chrono::microseconds at) const
+    {
+        return started_ + chrono::duration_cast<Clock::duration>(at / options_.speed);
+    }
+
+    // recorded pace, conversations open when due
+    void schedule_next()
+    {
+        if (next_ == conversations_.size()) return;
+        launcher_.expires_at(due(conversations_[next_].opened));
+        launcher_.async_wait([this](asio::error_code ec) {
+            if (ec) return;
+            launch_next();
+            schedule_next();
+        });
+    }
+
+    void launch_next()
+    {
+        if (next_ == conversations_.size()) return;
+        make_shared<Session>(*this, conversations_[next_++])->start();
+    }
+
+    // as fast as possible, a finished conversation makes room for next
+    void finished()
+    {
+        if (options_.fast) io_service_.post([this]() { launch_next(); });
+    }
+};
+
+void report(const Options &options, const Stats &stats)
+{
+    auto seconds = chrono::duration<double>(stats.elapsed).count();
+    auto lag_ms = chrono::duration<double, milli>(stats.max_lag).count();
+
+    if (options.json) {
+        JsonType statuses = JsonType::object();
+        for (auto &s : stats.statuses) statuses[to_string(s.first)] = s.second;
+        JsonType out = {
+            {"log", options.log},
+            {"mode", options.fast ? "fast" : "paced"},
+            {"speed", options.speed},
+            {"connections", stats.connections},
+            {"errors", stats.errors},
+            {"timed_out", stats.timed_out},
+            {"bytes_sent", stats.bytes_sent},
+            {"bytes_received", stats.bytes_received},
+            {"statuses", statuses},
+            {"elapsed_seconds", seconds},
+            {"connections_per_second", seconds > 0 ? stats.connections / seconds : 0},
+            {"max_lag_ms", lag_ms},
+        };
+        cout << out.dump(2) << eol;
+        return;
+    }
+
+    printf("replayed %s %s", options.log.c_str(), options.fast ? "as fast as possible" : "at recorded pace");
+    if (!options.fast && options.speed != 1) printf(" x%g", options.speed);
+    printf("\n  %zu connections in %.3fs, %.1f/s\n", stats.connections, seconds,
+           seconds > 0 ? stats.connections / seconds : 0);
+    printf("  %llu bytes sent, %llu bytes received\n",
+           (unsigned long long)stats.bytes_sent, (unsigned long long)stats.bytes_received);
+    printf("  %zu errors, %zu timed out\n", stats.errors, stats.timed_out);
+    if (!options.fast) printf("  sends up to %.3fms behind schedule\n", lag_ms);
+    printf("  status");
+    for (auto &s : stats.statuses) printf("  %s: %zu", s.first ? to_string(s.first).c_str() : "none", s.second);
+    printf("\n");
+}
+
+}
+
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    bool usage = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        auto value = arg.substr(arg.find('=') + 1);
+        if (arg.rfind("--host=", 0) == 0) options.host = value;
+        else if (arg.rfind("--port=", 0) == 0) options.port = atoi(value.c_str());
+        else if (arg.rfind("--speed=", 0) == 0) options.speed = atof(value.c_str());
+        else if (arg == "--fast") options.fast = true;
+        else if (arg.rfind("--connections=", 0) == 0) options.connections = max(1, atoi(value.c_str()));
+        else if (arg.rfind("--linger=", 0) == 0) options.linger = atof(value.c_str());
+        else if (arg == "--json") options.json = true;
+        else if (arg.rfind("--", 0) != 0 && options.log.empty()) options.log = arg;
+        else usage = true;
+    }
+    if (usage || options.log.empty() || options.speed <= 0) {
+        fprintf(stderr, "usage: %s <traffic log> [--host=] [--port=] [--speed=] [--fast] [--connections=] "
+                        "[--linger=] [--json]\n", argv[0]);
+        return 1;
+    }
+
+    try {
+        auto conversations = load(options.log);
+        Replayer replayer(options, conversations);
+        report(options, replayer.run());
+    } catch (const exception &e) {
+        cerr << e.what() << eol;
+        return 1;
+    }
+    return 0;
+}